@@ -0,0 +1,647 @@
+/// Benchmark.cpp
+/// Micro and end-to-end benchmarks for the capture, playback and serialisation hot paths.
+/// Usage: FESDBench [--out results.json] [--iterations n] [--warmup n] [--sessions n] [--frames n] [--width w] [--height h] [--filter name]
+#include <algorithm>
+#include <iostream>
+#include <fstream>
+#include <filesystem>
+#include <random>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include <opencv2/core.hpp>
+#include <glm/gtc/matrix_transform.hpp>
+#include <json/json.h>
+
+#include "Benchmark.h"
+
+#include "cameras/NuiPlaybackCamera.h"
+#include "obj/Logger.h"
+#include "obj/Point.h"
+#include "obj/BackgroundModel.h"
+#include "obj/DepthFilter.h"
+#include "obj/DepthStatistics.h"
+#include "obj/PointCloud.h"
+#include "obj/PreRollBuffer.h"
+#include "obj/SkeletonDetectorNuitrack.h"
+#include "obj/SkeletonFusion.h"
+#include "obj/VoxelGrid.h"
+#include "utilities/ConvertRecordings.h"
+#include "utilities/FrameIO.h"
+#include "utilities/FramePacking.h"
+#include "utilities/FramePool.h"
+#include "utilities/FrameWriter.h"
+#include "utilities/Recordings.h"
+#include "utilities/Utils.h"
+
+struct BenchParameters
+{
+    std::filesystem::path Out{ "bench_results.json" };
+    std::filesystem::path Directory{ std::filesystem::temp_directory_path() / "FESDBench" };
+    std::string Filter{ };
+    int Iterations{ 20 };
+    int Warmup{ 2 };
+    int Sessions{ 20 };
+    int Frames{ 30 };
+    int Width{ 640 };
+    int Height{ 480 };
+};
+
+static BenchParameters parseArguments(int argc, char** argv)
+{
+    BenchParameters params;
+
+    for (int i = 1; i + 1 < argc; i += 2) {
+        std::string arg = argv[i];
+        std::string val = argv[i + 1];
+
+        if (arg == "--out")             params.Out = val;
+        else if (arg == "--dir")        params.Directory = val;
+        else if (arg == "--filter")     params.Filter = val;
+        else if (arg == "--iterations") params.Iterations = std::stoi(val);
+        else if (arg == "--warmup")     params.Warmup = std::stoi(val);
+        else if (arg == "--sessions")   params.Sessions = std::stoi(val);
+        else if (arg == "--frames")     params.Frames = std::stoi(val);
+        else if (arg == "--width")      params.Width = std::stoi(val);
+        else if (arg == "--height")     params.Height = std::stoi(val);
+        else std::cout << "Unknown argument '" << arg << "'" << std::endl;
+    }
+
+    return params;
+}
+
+///
+/// Synthetic data
+///
+
+/// Frame as stored by SkeletonDetectorNuitrack: normalised rgb and depth in meters as FP16
+static cv::Mat makeFrame(int width, int height, int type = CV_16FC4)
+{
+    cv::Mat frame(height, width, CV_32FC4);
+    cv::randu(frame, cv::Scalar::all(0.0f), cv::Scalar(1.0f, 1.0f, 1.0f, 4.0f));
+    frame.convertTo(frame, CV_MAT_DEPTH(type));
+    return frame;
+}
+
+static Json::Value makeSkeletons(int frames)
+{
+    std::mt19937 rng{ 42 };
+    std::uniform_real_distribution<float> dist{ 0.0f, 1.0f };
+
+    Json::Value skeletons;
+    for (int frame = 0; frame < frames; frame++) {
+        Json::Value people;
+        Json::Value person;
+        Json::Value skeleton;
+        person["id"] = 1;
+        person["error"] = 0;
+
+        for (int joint_i = 0; joint_i < 25; joint_i++) {
+            Json::Value joint;
+            joint["error"] = 0;
+            joint["i"] = joint_i;
+            joint["u"] = dist(rng) * 640.0f;
+            joint["v"] = dist(rng) * 480.0f;
+            joint["d"] = dist(rng) * 4.0f;
+            joint["x"] = dist(rng);
+            joint["y"] = dist(rng);
+            joint["z"] = dist(rng) * 4.0f;
+            joint["score"] = dist(rng);
+            skeleton.append(joint);
+        }
+
+        person["Skeleton"] = skeleton;
+        people.append(person);
+        skeletons.append(people);
+    }
+
+    return skeletons;
+}
+
+static void writeJson(const std::filesystem::path& path, const Json::Value& val)
+{
+    std::fstream configJson(path, std::ios::out | std::ios::trunc);
+    Json::StreamWriterBuilder builder;
+    configJson << Json::writeString(builder, val);
+}
+
+/// Create a session with the same layout as a Nuitrack recording and return its config
+static Json::Value makeSession(const BenchParameters& params, int session_i, int frameType = CV_16FC4)
+{
+    auto sessionName = getFileSafeSessionName("Session Bench " + std::to_string(session_i));
+    auto framePath = params.Directory / sessionName / "Frames";
+    std::filesystem::create_directories(framePath);
+
+    auto frame = makeFrame(params.Width, params.Height, frameType);
+    for (int i = 0; i < params.Frames; i++) {
+        // Playback only reads every 10th frame
+        FrameIO::writeFrame(framePath / (SkeletonDetectorNuitrack::getFrameName(i * 10) + ".bin"), frame);
+    }
+    writeJson(params.Directory / sessionName / "SkeletonNui.json", makeSkeletons(params.Frames));
+
+    Json::Value camera;
+    camera["Name"] = "NuiPlayback";
+    camera["Type"] = "NuiPlayback";
+    camera["Fx"] = 525.0f;
+    camera["Fy"] = 525.0f;
+    camera["Cx"] = params.Width / 2.0f;
+    camera["Cy"] = params.Height / 2.0f;
+    camera["MetersPerUnit"] = 1;
+    camera["FileName"] = sessionName + "/Frames";
+
+    Json::Value root;
+    root["Name"] = "Session Bench " + std::to_string(session_i);
+    root["Duration"] = params.Frames / 30.0;
+    root["Frames"] = params.Frames;
+    root["Cameras"].append(camera);
+    root["Skeleton"] = sessionName + "/SkeletonNui.json";
+    root["Session Parameters"]["Exercise"] = "E-0.00";
+
+    writeJson(params.Directory / (sessionName + ".json"), root);
+
+    return root;
+}
+
+///
+/// Benchmarks
+///
+
+static void benchDepthConversion(Bench::Runner& runner, const BenchParameters& params)
+{
+    const int width = params.Width;
+    const int height = params.Height;
+
+    std::vector<Point> points(width * height);
+    for (int h = 0; h < height; h++) {
+        for (int w = 0; w < width; w++) {
+            points[h * width + w].PositionFunction = Point::getPositionFunction(w, h, 525.0f, 525.0f, width / 2.0f, height / 2.0f);
+        }
+    }
+
+    std::vector<int16_t> depth(width * height);
+    std::mt19937 rng{ 42 };
+    std::uniform_int_distribution<int> dist{ 0, 4000 };
+    for (auto& d : depth)
+        d = (int16_t)dist(rng);
+
+    runner.run("DepthConversion", 1, depth.size() * sizeof(int16_t), [&]() {
+        GLObject::PointCloud::streamDepth(points.data(), width, height, depth.data(), 0.001f, 0);
+    });
+}
+
+static void benchDepthFilter(Bench::Runner& runner, const BenchParameters& params)
+{
+    const int width = params.Width;
+    const int height = params.Height;
+    constexpr int Cameras{ 4 };
+
+    // Two planes with sensor noise and dropouts
+    std::mt19937 rng{ 42 };
+    std::normal_distribution<float> noise{ 0.0f, 6.0f };
+    std::vector<std::vector<uint16_t>> frames(8, std::vector<uint16_t>(width * height));
+    for (auto& frame : frames) {
+        for (int i = 0; i < width * height; i++) {
+            float depth = (i % width < width / 2 ? 1500.0f : 2500.0f) + noise(rng);
+            frame[i] = rng() % 50 == 0 ? 0 : (uint16_t)depth;
+        }
+    }
+
+    std::vector<DepthFilter> filters(Cameras);
+    for (auto& filter : filters)
+        filter.getParameters().Enabled = true;
+
+    int frame_i = 0;
+    runner.run("DepthFilter/4Cameras", Cameras, (double)Cameras * width * height * sizeof(uint16_t), [&]() {
+        const auto& frame = frames[frame_i++ % frames.size()];
+        for (auto& filter : filters)
+            filter.apply(frame.data(), width, height, 0.001f);
+    });
+}
+
+static void benchBackgroundSegmentation(Bench::Runner& runner, const BenchParameters& params)
+{
+    const int width = params.Width;
+    const int height = params.Height;
+
+    // A wall behind a box standing in for the subject
+    std::vector<uint16_t> background(width * height, 3000), frame(width * height, 3000);
+    for (int h = height / 4; h < height; h++) {
+        for (int w = width * 2 / 5; w < width * 3 / 5; w++)
+            frame[h * width + w] = 2000;
+    }
+
+    BackgroundModel model;
+    model.startLearning();
+    for (int i = 0; i < 10; i++)
+        model.learn(background.data(), width, height, 0.001f);
+    model.finishLearning();
+
+    runner.run("BackgroundModel/Segment", 1, (double)width * height * sizeof(uint16_t), [&]() {
+        model.segment(frame.data(), width, height, 0.001f);
+    });
+}
+
+static void benchDepthStatistics(Bench::Runner& runner, const BenchParameters& params)
+{
+    const int width = params.Width;
+    const int height = params.Height;
+
+    std::vector<Point> points(width * height);
+    std::mt19937 rng{ 42 };
+    std::uniform_real_distribution<float> dist{ 0.5f, 4.0f };
+    for (int h = 0; h < height; h++) {
+        for (int w = 0; w < width; w++) {
+            auto& point = points[h * width + w];
+            point.PositionFunction = { ((float)w - width / 2.0f) / 525.0f, ((float)h - height / 2.0f) / 525.0f };
+            point.Depth = rng() % 20 == 0 ? 0.0f : dist(rng);
+        }
+    }
+
+    DepthStatistics statistics;
+    runner.run("DepthStatistics", 1, (double)width * height * sizeof(Point), [&]() {
+        statistics.compute(points.data(), width, height);
+    });
+}
+
+static void benchIndexCompaction(Bench::Runner& runner, const BenchParameters& params)
+{
+    const int width = params.Width;
+    const int height = params.Height;
+
+    // Every tenth column and a block in the centre without depth
+    std::vector<Point> points(width * height);
+    for (int h = 0; h < height; h++) {
+        for (int w = 0; w < width; w++) {
+            bool hole = w % 10 == 0 || (std::abs(w - width / 2) < width / 8 && std::abs(h - height / 2) < height / 8);
+            points[h * width + w].Depth = hole ? 0.0f : 1.5f;
+        }
+    }
+
+    std::vector<unsigned int> indices(points.size());
+    for (int stride : { 1, 2 }) {
+        runner.run("IndexCompaction/Stride" + std::to_string(stride), 1, points.size() * sizeof(Point), [&]() {
+            GLObject::PointCloud::compactIndices(points.data(), width, height, stride, 0, indices.data());
+        });
+    }
+}
+
+static void benchVoxelGrid(Bench::Runner& runner, const BenchParameters& params)
+{
+    const int width = params.Width;
+    const int height = params.Height;
+    const glm::mat3 intrinsics{ 525.0f, 0.0f, width / 2.0f,
+                                  0.0f, 525.0f, height / 2.0f,
+                                  0.0f, 0.0f, 1.0f };
+
+    // Two cameras looking at a slanted wall with some noise and invalid pixels
+    std::mt19937 rng{ 42 };
+    std::uniform_int_distribution<int> noise{ -3, 3 };
+    std::vector<std::vector<uint16_t>> depths(2, std::vector<uint16_t>(width * height));
+    for (auto& depth : depths) {
+        for (int v = 0; v < height; v++) {
+            for (int u = 0; u < width; u++) {
+                depth[v * width + u] = (u % 37 == 0) ? 0 : (uint16_t)(1500 + u + v / 2 + noise(rng));
+            }
+        }
+    }
+
+    VoxelGrid voxelGrid{ 0.01f };
+    runner.run("VoxelGrid", (double)depths.size(), (double)depths.size() * width * height * sizeof(uint16_t), [&]() {
+        for (const auto& depth : depths)
+            voxelGrid.filter(depth.data(), width, height, 0.001f, intrinsics);
+    });
+}
+
+static void benchFrameWriter(Bench::Runner& runner, const BenchParameters& params)
+{
+    auto dir = params.Directory / "FrameWriter";
+    std::filesystem::create_directories(dir);
+
+    auto frame = makeFrame(params.Width, params.Height);
+    double frameBytes = (double)frame.total() * frame.elemSize();
+
+    runner.run("FrameWrite", 1, frameBytes, [&]() {
+        FrameIO::writeFrame(dir / "frame_0.bin", frame);
+    });
+
+    runner.run("FrameRead", 1, frameBytes, [&]() {
+        auto read = FrameIO::readFrame(dir / "frame_0.bin");
+    });
+
+    // Planar layout SkeletonDetectorNuitrack stores, depth in mm and colour in 8 bit
+    cv::Mat color(params.Height, params.Width, CV_8UC3), depth(params.Height, params.Width, CV_16UC1);
+    cv::randu(color, 0, 256);
+    cv::randu(depth, 0, 5000);
+    const std::vector<FrameIO::Plane> planes{ { FrameIO::PlaneId::Depth, depth, 0.001f }, { FrameIO::PlaneId::Color, color, 1.0f / 255.0f } };
+    const double planarBytes = (double)color.total() * (color.elemSize() + depth.elemSize());
+
+    runner.run("FrameWrite/Planar", 1, planarBytes, [&]() {
+        FrameIO::writePlanes(dir / "frame_planar.bin", planes);
+    });
+
+    runner.run("FrameRead/Planar", 1, planarBytes, [&]() {
+        auto read = FrameIO::readPlanes(dir / "frame_planar.bin", { FrameIO::PlaneId::Depth, FrameIO::PlaneId::Color });
+    });
+
+    runner.run("FrameRead/DepthPlane", 1, (double)depth.total() * depth.elemSize(), [&]() {
+        auto read = FrameIO::readPlanes(dir / "frame_planar.bin", { FrameIO::PlaneId::Depth });
+    });
+
+    // Equivalent to SkeletonDetectorNuitrack::stopRecording storing a whole session
+    std::vector<cv::Mat> frames(params.Frames, frame);
+    runner.run("RecordSession", params.Frames, frameBytes * params.Frames, [&]() {
+        for (int i = 0; i < frames.size(); i++) {
+            FrameIO::writeFrame(dir / (SkeletonDetectorNuitrack::getFrameName(i) + ".bin"), frames[i]);
+        }
+    });
+
+    // Default recording policy, the full frame every 10th frame and the depth downscaled by 4 in between
+    cv::Mat lowResDepth(params.Height / 4, params.Width / 4, CV_16UC1, cv::Scalar(1500));
+    const int keyframes = (params.Frames + 9) / 10;
+    const double policyBytes = planarBytes * keyframes + (double)lowResDepth.total() * lowResDepth.elemSize() * (params.Frames - keyframes);
+    const std::vector<FrameIO::Plane> lowResPlanes{ { FrameIO::PlaneId::Depth, lowResDepth, 0.001f } };
+    runner.run("RecordSession/Keyframes", params.Frames, policyBytes, [&]() {
+        for (int i = 0; i < frames.size(); i++) {
+            if (i % 10 == 0)
+                FrameIO::writePlanes(dir / (SkeletonDetectorNuitrack::getFrameName(i) + ".bin"), planes);
+            else
+                FrameIO::writePlanes(dir / (SkeletonDetectorNuitrack::getDepthFrameName(i) + ".bin"), lowResPlanes);
+        }
+    });
+
+    // Same session through the writer SkeletonDetectorNuitrack records with, the time includes draining the queue
+    FrameWriter writer;
+    writer.reserve(FrameIO::getPlanarSize(planes), 8);
+    runner.run("RecordSession/Keyframes/FrameWriter", params.Frames, policyBytes, [&]() {
+        writer.start();
+        for (int i = 0; i < frames.size(); i++) {
+            if (i % 10 == 0)
+                writer.write(dir / (SkeletonDetectorNuitrack::getFrameName(i) + ".bin"), planes);
+            else
+                writer.write(dir / (SkeletonDetectorNuitrack::getDepthFrameName(i) + ".bin"), lowResPlanes);
+        }
+        writer.stop();
+    });
+}
+
+static void benchFramePool(Bench::Runner& runner, const BenchParameters& params)
+{
+    cv::Mat depth(params.Height, params.Width, CV_16UC1, cv::Scalar(1500));
+    const double bytes = (double)depth.total() * depth.elemSize();
+
+    // A new frame per stage as before the pool, every frame is a heap allocation and its pages are touched anew
+    runner.run("FramePool/Heap", 1, bytes, [&]() {
+        cv::Mat frame(depth.rows, depth.cols, CV_16UC1);
+        depth.copyTo(frame);
+    });
+
+    // The same frame from the pool, the buffer returns when the frame is released
+    FramePool pool;
+    runner.run("FramePool/Acquire", 1, bytes, [&]() {
+        cv::Mat frame = pool.acquire(depth.rows, depth.cols, CV_16UC1);
+        depth.copyTo(frame);
+    });
+
+    // Several frames in flight between the stages of capture, recording and playback
+    std::vector<cv::Mat> inFlight(4);
+    runner.run("FramePool/InFlight4", 1, bytes, [&]() {
+        std::rotate(inFlight.begin(), inFlight.begin() + 1, inFlight.end());
+        inFlight.back() = pool.acquire(depth.rows, depth.cols, CV_16UC1);
+        depth.copyTo(inFlight.back());
+    });
+    inFlight.clear();
+
+    auto stats = pool.getStatistics();
+    std::cout << "FramePool: " << stats.Allocated << " buffers allocated, high-water " << stats.HighWaterBuffers << ", exhausted " << stats.Exhausted << std::endl;
+}
+
+static void benchRGBDPacking(Bench::Runner& runner, const BenchParameters& params)
+{
+    cv::Mat color(params.Height, params.Width, CV_8UC3);
+    cv::Mat depth(params.Height, params.Width, CV_16UC1);
+    cv::randu(color, 0, 256);
+    cv::randu(depth, 0, 5000);
+    const double bytes = (double)color.total() * (color.elemSize() + depth.elemSize());
+
+    // The conversion SkeletonDetectorNuitrack::update used before the fused kernel
+    runner.run("RGBDPacking/Merge", 1, bytes, [&]() {
+        cv::Mat colorMat, depthMat;
+        color.convertTo(colorMat, CV_16FC3);
+        colorMat /= 255.0;
+        depth.convertTo(depthMat, CV_16FC1);
+        depthMat /= 1000.f;
+
+        std::vector<cv::Mat> channels;
+        cv::split(colorMat, channels);
+        channels.push_back(depthMat);
+
+        cv::Mat fin;
+        cv::merge(channels, fin);
+        fin.convertTo(fin, CV_16F);
+    });
+
+    cv::Mat packed;
+    runner.run(FramePacking::hasF16C() ? "RGBDPacking/Fused/F16C" : "RGBDPacking/Fused/Scalar", 1, bytes, [&]() {
+        FramePacking::packRGBD(color, depth, 0.001f, packed);
+    });
+}
+
+static void benchPreRoll(Bench::Runner& runner, const BenchParameters& params)
+{
+    cv::Mat color(params.Height, params.Width, CV_8UC3);
+    cv::Mat depth(params.Height, params.Width, CV_16UC1);
+    cv::randu(color, 0, 256);
+    cv::randu(depth, 500, 5000);
+    const double bytes = (double)color.total() * (color.elemSize() + depth.elemSize());
+
+    // Per frame cost during the countdown, the buffer is full so every push also drops a frame
+    PreRollBuffer preRoll{ { 1.0f } };
+    double timestamp = 0.0;
+    runner.run("PreRoll/Push", 1, bytes, [&]() {
+        preRoll.push(timestamp, color, depth);
+        timestamp += 1.0 / 30.0;
+    });
+
+    // One second at 30 fps decoded at the start of the recording
+    runner.run("PreRoll/Flush", 30, bytes * 30, [&]() {
+        for (int i = 0; i < 30; i++)
+            preRoll.push(i / 30.0, color, depth);
+        preRoll.flush([](const PreRollBuffer::Frame&) { });
+    });
+}
+
+static void benchSkeletonJson(Bench::Runner& runner, const BenchParameters& params)
+{
+    auto skeletons = makeSkeletons(params.Frames);
+
+    Json::StreamWriterBuilder writer;
+    std::string serialised = Json::writeString(writer, skeletons);
+
+    runner.run("SkeletonSerialize", params.Frames, serialised.size(), [&]() {
+        serialised = Json::writeString(writer, skeletons);
+    });
+
+    runner.run("SkeletonParse", params.Frames, serialised.size(), [&]() {
+        Json::CharReaderBuilder builder;
+        std::unique_ptr<Json::CharReader> reader{ builder.newCharReader() };
+        Json::Value root;
+        JSONCPP_STRING errs;
+        reader->parse(serialised.data(), serialised.data() + serialised.size(), &root, &errs);
+    });
+}
+
+static void benchSkeletonFusion(Bench::Runner& runner, const BenchParameters& params)
+{
+    // Four cameras around two people, the skeletons are the projections of the same 25 joints
+    const int cameras = 4;
+    std::vector<SkeletonFusion::View> views(cameras);
+    for (int cam = 0; cam < cameras; cam++) {
+        auto& view = views[cam];
+        view.Intrinsics = { 525.0f, 525.0f, params.Width / 2.0f, params.Height / 2.0f };
+        view.DepthSize = { params.Width, params.Height };
+        view.ImageSize = { 2 * params.Width, 2 * params.Height };
+        view.Model = glm::rotate(glm::mat4{ 1.0f }, glm::radians(90.0f * cam), { 0.0f, 1.0f, 0.0f }) * glm::translate(glm::mat4{ 1.0f }, { 0.0f, 0.0f, -3.0f });
+    }
+
+    SkeletonFusion fusion;
+    fusion.setViews(views);
+
+    std::mt19937 rng{ 42 };
+    std::uniform_real_distribution<float> dist{ -0.4f, 0.4f };
+    std::vector<glm::vec3> joints(25);
+    for (auto& joint : joints)
+        joint = { dist(rng), 2.0f * dist(rng), dist(rng) };
+
+    std::vector<Json::Value> people(cameras);
+    for (int cam = 0; cam < cameras; cam++) {
+        const auto projection = views[cam].getProjection();
+        for (int person = 0; person < 2; person++) {
+            Json::Value p;
+            for (const auto& joint : joints) {
+                const auto projected = projection * glm::vec4(joint + glm::vec3{ 1.2f * person, 0.0f, 0.0f }, 1.0f);
+                const auto pixel = views[cam].toImagePixel({ projected.x / projected.z, projected.y / projected.z });
+
+                Json::Value j;
+                j["u"] = pixel.x;
+                j["v"] = pixel.y;
+                j["score"] = 0.8f;
+                p["Skeleton"].append(j);
+            }
+            people[cam].append(p);
+        }
+    }
+
+    runner.run("SkeletonFusion/" + std::to_string(cameras) + "Cameras", 1, 0, [&]() {
+        auto fused = fusion.fuse(people);
+    });
+}
+
+static void benchPlayback(Bench::Runner& runner, const BenchParameters& params, Logger::Logger* logger)
+{
+    auto session = makeSession(params, 0);
+    auto recording = params.Directory / session["Cameras"][0]["FileName"].asString();
+
+    int currentFrame = 0;
+    NuiPlaybackCamera camera{ nullptr, nullptr, logger, recording, &currentFrame, session["Cameras"][0] };
+
+    double frameBytes = (double)params.Width * params.Height * 4 * sizeof(uint16_t);
+
+    runner.run("NuiPlaybackQueryFrame", params.Frames, frameBytes * params.Frames, [&]() {
+        for (currentFrame = 0; currentFrame < params.Frames; currentFrame++) {
+            camera.getDepth();
+            camera.getColorFrame();
+        }
+    });
+
+    // Playback as done by the CameraHandler, reading a frame and converting it into the point cloud vertices
+    const int width = camera.getDepthStreamWidth();
+    const int height = camera.getDepthStreamHeight();
+    std::vector<Point> points(width * height);
+
+    runner.run("PlaybackEndToEnd", params.Frames, frameBytes * params.Frames, [&]() {
+        for (currentFrame = 0; currentFrame < params.Frames; currentFrame++) {
+            auto frame = static_cast<const int16_t*>(camera.getDepth());
+            if (frame == nullptr)
+                continue;
+
+            GLObject::PointCloud::streamDepth(points.data(), width, height, frame, camera.getMetersPerUnit(), 0);
+        }
+    });
+}
+
+static void benchRecordings(Bench::Runner& runner, const BenchParameters& params)
+{
+    auto dir = params.Directory / "Recordings";
+    std::filesystem::remove_all(dir);
+
+    auto sessionParams = params;
+    sessionParams.Directory = dir;
+
+    std::vector<Json::Value> sessions;
+    for (int i = 0; i < params.Sessions; i++) {
+        sessions.push_back(makeSession(sessionParams, i));
+    }
+
+    runner.run("FindRecordings", params.Sessions, 0, [&]() {
+        auto recordings = findRecordings(dir);
+    });
+
+    // Conversion only touches frames that are not FP16 yet, so the frames are reset before every iteration
+    auto frame = makeFrame(params.Width, params.Height, CV_32FC4);
+    double frameBytes = (double)frame.total() * frame.elemSize();
+    int totalFrames = params.Sessions * params.Frames;
+
+    runner.run("ConvertRecordings", totalFrames, frameBytes * totalFrames, [&]() {
+        convertRecordings(sessions, false, dir);
+    }, [&]() {
+        for (const auto& session : sessions) {
+            auto framePath = dir / session["Cameras"][0]["FileName"].asString();
+            for (int i = 0; i < params.Frames; i++) {
+                FrameIO::writeFrame(framePath / (SkeletonDetectorNuitrack::getFrameName(i * 10) + ".bin"), frame);
+            }
+        }
+    });
+}
+
+int main(int argc, char** argv)
+{
+    auto params = parseArguments(argc, argv);
+
+    std::filesystem::remove_all(params.Directory);
+    std::filesystem::create_directories(params.Directory);
+
+    Logger::Logger logger;
+    Bench::Runner runner{ params.Warmup, params.Iterations, params.Filter };
+
+    benchDepthConversion(runner, params);
+    benchIndexCompaction(runner, params);
+    benchDepthStatistics(runner, params);
+    benchDepthFilter(runner, params);
+    benchBackgroundSegmentation(runner, params);
+    benchVoxelGrid(runner, params);
+    benchFrameWriter(runner, params);
+    benchFramePool(runner, params);
+    benchRGBDPacking(runner, params);
+    benchPreRoll(runner, params);
+    benchSkeletonJson(runner, params);
+    benchSkeletonFusion(runner, params);
+    benchPlayback(runner, params, &logger);
+    benchRecordings(runner, params);
+
+    Json::Value root;
+    root["Width"] = params.Width;
+    root["Height"] = params.Height;
+    root["Frames"] = params.Frames;
+    root["Sessions"] = params.Sessions;
+    root["Iterations"] = params.Iterations;
+    root["Hardware Threads"] = std::thread::hardware_concurrency();
+    root["Results"] = (Json::Value)runner;
+
+    writeJson(params.Out, root);
+    std::cout << "Results written to " << params.Out << std::endl;
+
+    std::filesystem::remove_all(params.Directory);
+
+    return 0;
+}
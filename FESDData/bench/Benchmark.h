@@ -0,0 +1,109 @@
+#pragma once
+#include <algorithm>
+#include <chrono>
+#include <functional>
+#include <iostream>
+#include <string>
+#include <vector>
+
+#include <json/json.h>
+
+namespace Bench {
+struct Result
+{
+	std::string Name;
+	int Iterations{ 0 };
+	double FramesPerIteration{ 0 };
+	double BytesPerIteration{ 0 };
+	double TotalSeconds{ 0 };
+	std::vector<double> LatenciesMs{ };
+
+	double percentile(double p) const
+	{
+		if (LatenciesMs.empty())
+			return 0.0;
+
+		auto sorted = LatenciesMs;
+		std::sort(sorted.begin(), sorted.end());
+		size_t i = (size_t)std::min<double>(sorted.size() - 1, p * (sorted.size() - 1) + 0.5);
+		return sorted[i];
+	}
+
+	explicit operator Json::Value() const
+	{
+		Json::Value val;
+
+		val["Name"] = Name;
+		val["Iterations"] = Iterations;
+		val["Frames/s"] = TotalSeconds > 0 ? FramesPerIteration * Iterations / TotalSeconds : 0.0;
+		val["MB/s"] = TotalSeconds > 0 ? BytesPerIteration * Iterations / TotalSeconds / (1024.0 * 1024.0) : 0.0;
+		val["Mean ms"] = Iterations > 0 ? TotalSeconds * 1000.0 / Iterations : 0.0;
+		val["p50 ms"] = percentile(0.50);
+		val["p99 ms"] = percentile(0.99);
+
+		return val;
+	}
+};
+
+/// <summary>
+/// Runs a benchmark a fixed number of times after a warmup and collects the latency of every iteration.
+/// The optional setup is run before each iteration and is not timed.
+/// </summary>
+class Runner
+{
+public:
+	Runner(int warmup, int iterations, std::string filter = "") : m_Warmup(warmup), m_Iterations(iterations), m_Filter(filter) { }
+
+	void run(std::string name, double framesPerIteration, double bytesPerIteration, std::function<void()> fn, std::function<void()> setup = nullptr)
+	{
+		if (!m_Filter.empty() && name.find(m_Filter) == std::string::npos)
+			return;
+
+		std::cout << "Running " << name << "..." << std::endl;
+
+		for (int i = 0; i < m_Warmup; i++) {
+			if (setup) setup();
+			fn();
+		}
+
+		Result result;
+		result.Name = name;
+		result.Iterations = m_Iterations;
+		result.FramesPerIteration = framesPerIteration;
+		result.BytesPerIteration = bytesPerIteration;
+
+		for (int i = 0; i < m_Iterations; i++) {
+			if (setup) setup();
+
+			auto start = std::chrono::steady_clock::now();
+			fn();
+			std::chrono::duration<double> elapsed = std::chrono::steady_clock::now() - start;
+
+			result.TotalSeconds += elapsed.count();
+			result.LatenciesMs.push_back(elapsed.count() * 1000.0);
+		}
+
+		auto val = (Json::Value)result;
+		std::cout << "  " << val["Frames/s"].asDouble() << " frames/s, "
+				  << val["MB/s"].asDouble() << " MB/s, p50 "
+				  << val["p50 ms"].asDouble() << " ms, p99 "
+				  << val["p99 ms"].asDouble() << " ms" << std::endl;
+
+		m_Results.push_back(result);
+	}
+
+	explicit operator Json::Value() const
+	{
+		Json::Value results;
+		for (const auto& result : m_Results)
+			results.append((Json::Value)result);
+
+		return results;
+	}
+private:
+	int m_Warmup;
+	int m_Iterations;
+	std::string m_Filter;
+	std::vector<Result> m_Results{ };
+};
+}
@@ -6,35 +6,38 @@ layout(location = 0) in vec3 aPosFun;
 layout(location = 1) in float aDepth;
 // Colors
 layout(location = 2) in vec3 aColor;
-// Positions/Coordinates
+// Camera index, selects the model matrix
 layout(location = 3) in int aCamIndex;
 
 // Outputs the color for the Fragment Shader
 out vec3 v_Color;
 
-// Inputs the matrices needed for 3D viewing with perspective for up to 4 cameras
-uniform mat4 u_Model;
+// Has to match PointCloud::MaxCameras
+#define MAX_CAMERAS 16
+
+// Extrinsics of every camera, moves its points into the common frame
+layout(std140) uniform CameraModels
+{
+	mat4 u_Models[MAX_CAMERAS];
+};
+
 uniform mat4 u_VP;
 uniform bool u_AlignmentMode;
 
 void main()
 {
 	vec3 pos = vec3(aPosFun[0] * aDepth, aPosFun[1] * aDepth, aDepth);
+	// Cameras beyond the uniform block have no model and stay in the common frame
+	mat4 model = aCamIndex >= 0 && aCamIndex < MAX_CAMERAS ? u_Models[aCamIndex] : mat4(1.0);
 	// Outputs the positions/coordinates of all vertices 
-	if (aCamIndex == 0){
-		gl_Position = u_VP * u_Model * vec4(pos, 1.0);
-	}else{
-		gl_Position = u_VP * vec4(pos, 1.0);
-	}
+	gl_Position = u_VP * model * vec4(pos, 1.0);
 	
 	// Assigns the colors from the Vertex Data to "color"
 	if (!u_AlignmentMode){
 		v_Color = aColor;
 	}else{
-		if (aCamIndex == 0){
-			v_Color = vec3(0, 0, 0);
-		}else{
-			v_Color = vec3(1, 1, 1);
-		}
+		// One flat color per camera
+		const vec3 palette[4] = vec3[4](vec3(0, 0, 0), vec3(1, 1, 1), vec3(1, 0, 0), vec3(0, 0, 1));
+		v_Color = palette[aCamIndex % 4];
 	}
 }
\ No newline at end of file
@@ -6,6 +6,7 @@
 #include <filesystem>
 #include <ranges>
 #include <execution>
+#include <optional>
 
 #include <json/json.h>
 #include <imgui.h>
@@ -23,7 +24,10 @@
 #include "utilities/helper/ImGuiHelper.h"
 #include "utilities/Utils.h"
 #include "utilities/helper/GLFWHelper.h"
+#include "utilities/Profiler.h"
 #include "utilities/ConvertRecordings.h"
+#include "utilities/FramePool.h"
+#include "utilities/Recordings.h"
 
 CameraHandler::CameraHandler(Camera *cam, Renderer *renderer, Logger::Logger* logger) : mp_Camera(cam), mp_Renderer(renderer), mp_Logger(logger)
 {
@@ -61,17 +65,98 @@ void CameraHandler::initAllCameras()
 
     m_CamerasExist = !m_DepthCameras.empty();
     if (m_CamerasExist)
-        mp_PointCloud = std::make_unique<GLObject::PointCloud>(m_DepthCameras, mp_Camera, mp_Logger, mp_Renderer);
+        loadCalibration();
+}
+
+void CameraHandler::loadCalibration()
+{
+    PROFILE_FUNCTION();
+    std::vector<std::optional<Calibration>> calibrations;
+
+    // The intrinsics have to be in place before the point cloud caches them
+    for (auto cam : m_DepthCameras) {
+        auto calibration = m_CalibrationStore.load(cam);
+        if (calibration) {
+            cam->setIntrinsics(calibration->Intrinsics);
+        }
+        else if (!cam->getSerial().empty()) {
+            m_CalibrationStore.save(Calibration::fromCamera(cam));
+        }
+
+        calibrations.push_back(calibration);
+    }
+
+    mp_PointCloud = std::make_unique<GLObject::PointCloud>(m_DepthCameras, mp_Camera, mp_Logger, mp_Renderer);
+
+    if (m_DepthCameras.size() < 2)
+        return;
+
+    // Poses are stored relative to the second camera, which defines the common frame
+    const auto reference = m_DepthCameras[1]->getSerial();
+    for (int cam_id = 0; cam_id < m_DepthCameras.size(); cam_id++) {
+        if (!calibrations[cam_id] || !calibrations[cam_id]->hasExtrinsics())
+            continue;
+
+        const auto& calibration = *calibrations[cam_id];
+        if (calibration.Reference != reference) {
+            mp_Logger->log("Stored extrinsics of " + calibration.Serial + " are relative to " + calibration.Reference + ", which is not the reference camera", Logger::Priority::WARN);
+            continue;
+        }
+
+        if (!m_CalibrationStore.isFresh(calibration)) {
+            mp_Logger->log("Stored extrinsics of " + calibration.Serial + " are outdated, the cameras have to be aligned again", Logger::Priority::WARN);
+            continue;
+        }
+
+        mp_PointCloud->setRotation(calibration.Rotation, cam_id);
+        mp_PointCloud->setTranslation(calibration.Translation, cam_id);
+        mp_Logger->log("Loaded calibration of " + calibration.Serial + " from " + m_CalibrationStore.getDirectory().generic_string());
+    }
+}
+
+void CameraHandler::saveCalibration(bool explicitSave)
+{
+    // Only a registration or the user vouch for the current extrinsics, otherwise the stored ones and their age are kept
+    const bool storeExtrinsics = m_DepthCameras.size() > 1 && mp_PointCloud && (explicitSave || mp_PointCloud->isRegistered());
+
+    for (int cam_id = 0; cam_id < m_DepthCameras.size(); cam_id++) {
+        auto cam = m_DepthCameras[cam_id];
+        auto calibration = Calibration::fromCamera(cam);
+        if (calibration.Serial.empty())
+            continue;
+
+        if (storeExtrinsics) {
+            calibration.Reference = m_DepthCameras[1]->getSerial();
+            calibration.Rotation = mp_PointCloud->getRotation(cam_id);
+            calibration.Translation = mp_PointCloud->getTranslation(cam_id);
+        }
+        else if (auto stored = m_CalibrationStore.load(cam); stored && stored->hasExtrinsics()) {
+            calibration.Reference = stored->Reference;
+            calibration.Rotation = stored->Rotation;
+            calibration.Translation = stored->Translation;
+            calibration.Timestamp = stored->Timestamp;
+        }
+
+        if (!m_CalibrationStore.save(calibration, storeExtrinsics))
+            mp_Logger->log("Could not save the calibration of " + calibration.Serial, Logger::Priority::ERR);
+    }
+
+    if (storeExtrinsics)
+        mp_PointCloud->resetRegistered();
 }
 
 void CameraHandler::OnUpdate()
 {
+    PROFILE_FUNCTION();
     if (!m_CamerasExist && !(m_SessionParams.EstimateSkeleton && (m_State != Streaming && m_State != Playback)))
         return;
 
     if (m_State == Streaming) {
         stream();
     }
+    else if (m_State == Countdown) {
+        learnBackground();
+    }
     else if (m_State == Recording) {
         record();
     }
@@ -82,6 +167,7 @@ void CameraHandler::OnUpdate()
 
 void CameraHandler::OnImGuiRender()
 {
+    PROFILE_FUNCTION();
     if (m_State == Recording) {
         showRecordingStats();
         m_SessionParams.showCurrentSession();
@@ -99,6 +185,11 @@ void CameraHandler::OnImGuiRender()
     if (m_CamerasExist) {
         for (auto cam : m_DepthCameras) {
             cam->CameraSettings();
+
+            // Appends to the settings window of the camera
+            ImGui::Begin(cam->getCameraName().c_str());
+            cam->m_DepthFilter.showSettings();
+            ImGui::End();
         }
 
         ImGui::Begin("PointCloud");
@@ -115,6 +206,12 @@ void CameraHandler::showGeneralGui()
         initAllCameras();
     }
     if (m_CamerasExist) {
+        ImGui::BeginDisabled(m_State != Streaming);
+        if (ImGui::Button("Save Calibration"))
+            saveCalibration(true);
+        ImGui::EndDisabled();
+        ImGuiHelper::HelpMarker("Store the intrinsics and the current alignment of the cameras, they are loaded the next time the cameras are initialised");
+
         ImGui::Checkbox("Show Color Frames", &m_ShowColorFrames);
 
         ImGui::Checkbox("Do skeleton detection", &m_DoSkeletonDetection);
@@ -122,6 +219,11 @@ void CameraHandler::showGeneralGui()
             ImGui::InputFloat("Score Threshold", &m_ScoreThreshold, 0.0f, 0.999f, "%.3f");
             ImGui::Checkbox("Show Uncertainty", &m_ShowUncertainty);
             ImGuiHelper::HelpMarker("Joints which are lower than the Score Thresholt will be shown in grey and the ones above will be shown ");
+
+            ImGui::BeginDisabled(m_DepthCameras.size() < 2);
+            ImGui::Checkbox("Fuse Skeletons", &m_FuseSkeletons);
+            ImGui::EndDisabled();
+            ImGuiHelper::HelpMarker("Triangulate the joints seen by several cameras into one 3D skeleton per person, the cameras have to be aligned in the point cloud");
         }
 
         ImGui::Text("%d Cameras Initialised", m_DepthCameras.size());
@@ -139,16 +241,35 @@ void CameraHandler::showGeneralGui()
 
 void CameraHandler::stream()
 {
+    PROFILE_FUNCTION();
     mp_PointCloud->OnUpdate();
     mp_PointCloud->OnRender();
 
-    for (auto cam : m_DepthCameras)
+    std::vector<Json::Value> people(m_DepthCameras.size());
+    std::vector<cv::Size> imageSizes(m_DepthCameras.size());
+
+    for (int cam_id = 0; cam_id < m_DepthCameras.size(); cam_id++)
     {
+        auto cam = m_DepthCameras[cam_id];
         if (cam->m_IsEnabled && (m_ShowColorFrames || m_DoSkeletonDetection)) {
             auto frame = cam->getColorFrame();
             if (!frame.empty()) {
                 if (m_DoSkeletonDetection) {
-                    m_SkeletonDetectorOpenPose->drawSkeleton(frame, m_ScoreThreshold, m_ShowUncertainty);
+                    // Only the region around the subject is searched, the view shares the pixels so the skeleton is drawn into the frame
+                    auto roi = getSubjectRoi(cam_id, frame.size());
+                    if (!roi.empty()) {
+                        cv::Mat subject = frame(roi);
+                        people[cam_id] = m_SkeletonDetectorOpenPose->drawSkeleton(subject, m_ScoreThreshold, m_ShowUncertainty);
+                        imageSizes[cam_id] = frame.size();
+
+                        // The joints are relative to the region
+                        for (auto& person : people[cam_id]) {
+                            for (auto& joint : person["Skeleton"]) {
+                                joint["u"] = joint["u"].asFloat() + roi.x;
+                                joint["v"] = joint["v"].asFloat() + roi.y;
+                            }
+                        }
+                    }
                 }
 
                 ImGui::Begin((cam->getCameraName() + (std::string)" Color Frame").c_str());
@@ -157,6 +278,11 @@ void CameraHandler::stream()
             }
         }
     }
+
+    if (m_DoSkeletonDetection && m_FuseSkeletons && m_DepthCameras.size() > 1) {
+        fuseSkeletons(people, imageSizes);
+        showSkeletonFusion();
+    }
 }
 
 /// 
@@ -191,20 +317,54 @@ void CameraHandler::showRecordingGui()
     }
 }
 
+cv::Rect CameraHandler::getSubjectRoi(int cam_id, cv::Size frameSize) const
+{
+    // Without registration the depth region does not match the color frame (e.g. the separate webcam of the Orbbec), the whole frame is searched
+    const auto cam = m_DepthCameras[cam_id];
+    if (!cam->isColorAlignedToDepth())
+        return { { 0, 0 }, frameSize };
+
+    const auto region = mp_PointCloud->getSubjectRegion(cam_id);
+    if (region.empty())
+        return { };
+
+    // The color frame may have a different resolution than the depth frame
+    const float scaleX = (float)frameSize.width / (float)cam->getDepthStreamWidth();
+    const float scaleY = (float)frameSize.height / (float)cam->getDepthStreamHeight();
+
+    cv::Rect roi{ (int)(region.X * scaleX), (int)(region.Y * scaleY), (int)std::ceil(region.Width * scaleX), (int)std::ceil(region.Height * scaleY) };
+    return roi & cv::Rect{ { 0, 0 }, frameSize };
+}
+
 void CameraHandler::initRecording() {
     mp_Logger->log("Initialise recording");
 
     std::filesystem::create_directory(m_RecordingDirectory / getFileSafeSessionName(m_SessionName));
 
     if (m_SessionParams.EstimateSkeleton) {
-        if (!m_DepthCameras.empty()) {
+        // Nuitrack keeps the device open between the repetitions of a session
+        if (!m_SkeletonDetectorNuitrack && !m_DepthCameras.empty()) {
             auto intrin = m_DepthCameras[0]->getIntrinsics();
             m_SkeletonDetectorNuitrack = std::make_unique<SkeletonDetectorNuitrack>(mp_Logger, intrin);
         }
 
         if (m_SkeletonDetectorNuitrack) {
+            // Nuitrack takes over the device, its depth is filtered like the depth of the camera
+            if (!m_DepthCameras.empty())
+                m_SkeletonDetectorNuitrack->setDepthFilter(m_DepthCameras[0]->m_DepthFilter.getParameters());
+
             clearCameras();
             m_SkeletonDetectorNuitrack->startRecording(getFileSafeSessionName(m_SessionName));
+            m_SkeletonDetectorNuitrack->setCropToSubject(m_SessionParams.SegmentSubject);
+            m_SkeletonDetectorNuitrack->setRecordingPolicy({ m_SessionParams.KeyframeStride, m_SessionParams.AdaptiveKeyframes },
+                                                           m_SessionParams.LowResDepth ? m_SessionParams.LowResDepthScale : 0,
+                                                           m_SessionParams.getExpectedFrames(SkeletonDetectorNuitrack::FramesPerSecond));
+            m_SkeletonDetectorNuitrack->setPreRoll(m_SessionParams.PreRollInS);
+            if (m_SessionParams.SegmentSubject)
+                m_SkeletonDetectorNuitrack->startBackgroundLearning();
+
+            // The countdown frames are captured off the UI thread
+            m_SkeletonDetectorNuitrack->startPreRoll();
         }
     }
     else {
@@ -212,6 +372,9 @@ void CameraHandler::initRecording() {
             cam->m_IsEnabled = true;
             cam->startRecording(getFileSafeSessionName(m_SessionName));
         }
+
+        if (m_SessionParams.SegmentSubject && mp_PointCloud)
+            mp_PointCloud->startBackgroundLearning();
     }
 
     // Sound an alarm that the countdown is starting
@@ -230,28 +393,72 @@ void CameraHandler::countdown() {
         updateSessionName();
         findRecordings();
 
-        if (!m_SessionParams.EstimateSkeleton) {
-            clearCameras();
-
+        // Only the recorders started in initRecording are closed, the devices keep streaming.
+        // Nuitrack holds the device instead of the cameras, it is released so the cameras can be opened again
+        if (m_SessionParams.EstimateSkeleton) {
+            m_SkeletonDetectorNuitrack.reset();
             initAllCameras();
         }
+        else {
+            for (auto cam : m_DepthCameras)
+                cam->stopRecording();
+
+            // As in startRecording, the frames of the countdown so far are the background
+            if (m_SessionParams.SegmentSubject && mp_PointCloud)
+                mp_PointCloud->finishBackgroundLearning();
+        }
 
         m_State = Streaming;
     }
 }
 
+void CameraHandler::learnBackground()
+{
+    PROFILE_FUNCTION();
+    // Nuitrack learns the background on its pre-roll thread
+    if (!m_SessionParams.SegmentSubject || m_SessionParams.EstimateSkeleton)
+        return;
+
+    if (mp_PointCloud) {
+        mp_PointCloud->OnUpdate();
+        mp_PointCloud->OnRender();
+    }
+}
+
 void CameraHandler::startRecording() {
     mp_Logger->log("Starting recording");
     m_State = Recording;
 
+    // Nuitrack is updated by record() from here on
+    if (m_SessionParams.EstimateSkeleton && m_SkeletonDetectorNuitrack)
+        m_SkeletonDetectorNuitrack->stopPreRoll();
+
+    if (m_SessionParams.SegmentSubject) {
+        if (m_SessionParams.EstimateSkeleton && m_SkeletonDetectorNuitrack)
+            m_SkeletonDetectorNuitrack->finishBackgroundLearning();
+        else if (mp_PointCloud)
+            mp_PointCloud->finishBackgroundLearning();
+    }
+
     m_RecordedFrames = 0;
     m_RecordedSeconds = std::chrono::duration<double>::zero();
     m_RecordingStart = std::chrono::system_clock::now();
+    FramePool::getInstance().resetStatistics();
+
+    // The pre-roll frames are not counted against the frame limit, the camera json marks them
+    if (m_SessionParams.EstimateSkeleton && m_SkeletonDetectorNuitrack)
+        m_SkeletonDetectorNuitrack->flushPreRoll(std::chrono::duration<double>(m_RecordingStart.time_since_epoch()).count());
+
+    if (!m_SessionParams.EstimateSkeleton && m_SessionParams.StreamWhileRecording) {
+        m_StatisticsCSV = std::fstream{ m_RecordingDirectory / getFileSafeSessionName(m_SessionName) / "FrameStatistics.csv", std::ios::out };
+        m_StatisticsCSV << "frame_index,camera,timestamp," << FrameStatistics::getCSVHeader() << std::endl;
+    }
 }
 
 
 void CameraHandler::record()
 {
+    PROFILE_FUNCTION();
     m_RecordedSeconds = std::chrono::system_clock::now() - m_RecordingStart;
 
     if (m_RecordedFrames + 1 > m_SessionParams.FrameLimit && m_SessionParams.LimitFrames) {
@@ -273,6 +480,11 @@ void CameraHandler::record()
         if (m_SessionParams.StreamWhileRecording) {
             mp_PointCloud->OnUpdate();
             mp_PointCloud->OnRender();
+
+            for (int cam_id = 0; cam_id < m_DepthCameras.size(); cam_id++) {
+                m_StatisticsCSV << m_RecordedFrames - 1 << "," << cam_id << "," << m_RecordedSeconds.count() << ","
+                                << mp_PointCloud->getStatistics(cam_id).toCSV() << std::endl;
+            }
         }
         else {
             std::for_each(
@@ -304,6 +516,14 @@ void CameraHandler::showRecordingStats() {
         ImGui::ProgressBar(m_RecordedSeconds.count() / (float)m_SessionParams.TimeLimitInS);
     }
 
+    if (m_SessionParams.EstimateSkeleton && m_SkeletonDetectorNuitrack) {
+        ImGui::Separator();
+        m_SkeletonDetectorNuitrack->getWriterStatistics().showStatistics();
+    }
+
+    ImGui::Separator();
+    FramePool::getInstance().getStatistics().showStatistics();
+
     if (ImGui::Button("Stop Recording")) {
         stopRecording();
     }
@@ -313,6 +533,7 @@ void CameraHandler::showRecordingStats() {
 
 #pragma warning(disable : 4996)
 void CameraHandler::stopRecording() {
+    PROFILE_FUNCTION();
     if (m_State != Recording)
         return;
 
@@ -320,6 +541,9 @@ void CameraHandler::stopRecording() {
 
     m_RecordingEnd = std::chrono::system_clock::now();
 
+    // Between repetitions only the output files are rotated, the devices stay open and keep streaming
+    const bool lastRecording = m_SessionParams.isLastRecording();
+
     std::time_t end_time = std::chrono::system_clock::to_time_t(m_RecordingEnd);
     mp_Logger->log("Finished recording at " + (std::string)std::ctime(&end_time) + "elapsed time: " + std::to_string(m_RecordedSeconds.count()) + "s");
 
@@ -335,46 +559,60 @@ void CameraHandler::stopRecording() {
 
     Json::Value cameras;
 
+    if (m_StatisticsCSV.is_open()) {
+        m_StatisticsCSV.close();
+        root["Frame Statistics"] = getFileSafeSessionName(m_SessionName) + "/FrameStatistics.csv";
+    }
+
     if (!m_SessionParams.EstimateSkeleton) {
         for (int cam_id = 0; cam_id < m_DepthCameras.size(); cam_id++) {
             auto cam = m_DepthCameras[cam_id];
             if (cam->m_IsSelectedForRecording) {
                 auto cam_json = cam->getCameraConfig();
-                cam->stopRecording();
+                // The device recording holds the raw depth, playback applies the same filter again
+                cam_json["DepthFilter"] = (Json::Value)cam->m_DepthFilter.getParameters();
+                if (m_DepthCameras.size() > 1) {
+                    cam_json["Rotation"] = mp_PointCloud->getRotation(cam_id);
+                    cam_json["Translation"] = mp_PointCloud->getTranslation(cam_id);
+                }
                 cameras.append(cam_json);
             }
+
+            // Every camera was started in initRecording
+            cam->stopRecording(lastRecording);
         }
     }
     else {
         cameras.append(m_SkeletonDetectorNuitrack->getCameraJson());
         root["Skeleton"] = m_SkeletonDetectorNuitrack->stopRecording();
+        root["Frame Writer"] = (Json::Value)m_SkeletonDetectorNuitrack->getWriterStatistics();
     }
     root["Cameras"] = cameras;
+    root["Frame Pool"] = (Json::Value)FramePool::getInstance().getStatistics();
 
     if (m_DepthCameras.size() > 1) {
         root["Rotation"] = mp_PointCloud->getRotation();
         root["Translation"] = mp_PointCloud->getTranslation();
     }
 
+    // Keep the alignment for the next session if the cameras were registered since it was stored
+    if (!m_SessionParams.EstimateSkeleton)
+        saveCalibration(false);
+
     root["Session Parameters"] = (Json::Value)m_SessionParams;
 
     Json::StreamWriterBuilder builder;
     configJson << Json::writeString(builder, root);
     configJson.close();
 
-    if (m_SessionParams.EstimateSkeleton) {
-        m_SkeletonDetectorNuitrack->freeCameras();
+    // Nuitrack is only released after the last repetition
+    if (m_SessionParams.EstimateSkeleton && lastRecording) {
+        m_SkeletonDetectorNuitrack.reset();
     }
 
     updateSessionName();
     findRecordings();
 
-    if (!m_SessionParams.EstimateSkeleton) {
-        clearCameras();
-
-        initAllCameras();
-    }
-
     if (!m_SessionParams.stopRecording(std::chrono::system_clock::now() - m_RecordingStart))
         initRecording();
     else
@@ -386,35 +624,13 @@ void CameraHandler::stopRecording() {
 /// 
 
 void CameraHandler::findRecordings() {
-    m_Recordings.clear();
-
-    for (const auto& entry : std::filesystem::directory_iterator(m_RecordingDirectory))
-    {
-        if (entry.is_regular_file() &&
-            entry.path().extension() == ".json" &&
-            entry.path().filename().string().find("Skeleton")  == std::string::npos &&
-            entry.path().filename().string().find("Exercises") == std::string::npos &&
-            entry.path().filename().string().find("Errors")    == std::string::npos) {
-            std::ifstream configJson(entry.path());
-            Json::Value root;
-
-            Json::CharReaderBuilder builder;
-
-            builder["collectComments"] = true;
-
-            JSONCPP_STRING errs;
+    std::vector<std::string> errors;
+    m_Recordings = ::findRecordings(m_RecordingDirectory, &errors);
 
-            if (!parseFromStream(builder, configJson, &root, &errs)) {
-                mp_Logger->log(errs, Logger::Priority::ERR);
-            }
-            else {
-                m_Recordings.push_back(root);
-            }
-        }
+    for (const auto& err : errors) {
+        mp_Logger->log(err, Logger::Priority::ERR);
     }
 
-    std::reverse(m_Recordings.begin(), m_Recordings.end());
-
     mp_Logger->log("Found " + std::to_string(m_Recordings.size()) + " Recordings in '" + m_RecordingDirectory.generic_string() + "'");
 }
 
@@ -526,6 +742,7 @@ void CameraHandler::startPlayback(Json::Value recording)
     m_Recording = recording;
 
     for (auto camera : recording["Cameras"]) {
+        const auto cameras = m_DepthCameras.size();
         auto rec_dir = (m_RecordingDirectory / camera["FileName"].asCString());
         if (camera["Type"].asString() == RealSenseCamera::getType()) {
             m_DepthCameras.push_back(new RealSenseCamera(mp_Camera, mp_Renderer, mp_Logger, rec_dir, &m_CurrentPlaybackFrame));
@@ -539,6 +756,9 @@ void CameraHandler::startPlayback(Json::Value recording)
         else {
             mp_Logger->log("Camera Type '" + camera["Type"].asString() + "' unknown", Logger::Priority::WARN);
         }
+
+        if (m_DepthCameras.size() > cameras && camera.isMember("DepthFilter"))
+            m_DepthCameras.back()->m_DepthFilter = DepthFilter{ DepthFilter::Parameters::fromJson(camera["DepthFilter"]) };
     }
 
     if (!recording["Skeleton"].isNull()) {
@@ -572,12 +792,23 @@ void CameraHandler::startPlayback(Json::Value recording)
     m_CurrentPlaybackFrame = 0;
     m_TotalPlaybackFrames = recording["Frames"].asInt();
     m_CamerasExist = !m_DepthCameras.empty();
-    if (m_CamerasExist)
+    if (m_CamerasExist) {
         mp_PointCloud = std::make_unique<GLObject::PointCloud>(m_DepthCameras, mp_Camera, mp_Logger, mp_Renderer);
+
+        // The alignment of the cameras at the time of the recording, the skeleton fusion needs it
+        for (int cam_id = 0; cam_id < m_DepthCameras.size() && cam_id < recording["Cameras"].size(); cam_id++) {
+            const auto& camera = recording["Cameras"][cam_id];
+            if (camera.isMember("Rotation") && camera.isMember("Translation")) {
+                mp_PointCloud->setRotation(camera["Rotation"], cam_id);
+                mp_PointCloud->setTranslation(camera["Translation"], cam_id);
+            }
+        }
+    }
 }
 
 void CameraHandler::playback()
 {
+    PROFILE_FUNCTION();
     if (m_FixSkeleton && m_FoundRecordedSkeleton) {
         fixSkeleton();
     }
@@ -639,6 +870,17 @@ void CameraHandler::showPlaybackGui()
         ImGui::Text("No Recordings Found!");
     }
     else {
+        ImGui::SliderInt("Frames in Flight", &m_OpenPoseFramesInFlight, 1, 16);
+
+        ImGui::Checkbox("Keyframe Detection", &m_UseKeyframes);
+        ImGuiHelper::HelpMarker("Only run the detector on keyframes and track the joints in between, every joint is tagged with its source (detected, tracked or refined)");
+        ImGui::BeginDisabled(!m_UseKeyframes);
+        ImGui::SliderInt("Keyframe Stride", &m_KeyframeParams.Stride, 1, 30);
+        ImGui::Checkbox("Keyframes on Motion", &m_KeyframeParams.MotionTriggered);
+        ImGui::InputFloat("Motion Threshold", &m_KeyframeParams.MotionThreshold, 0.5f, 1.0f, "%.1f");
+        ImGui::EndDisabled();
+        ImGuiHelper::HelpMarker("Number of frames OpenPose processes at once when calculating the skeletons of a recording, more keep the detector busy but need more memory");
+
         if (ImGui::Button("(Re)Calculate Skeleton for all recordings")) {
             mp_Logger->log("Starting skeleton detection for " + std::to_string(m_Recordings.size()) + " Recordings");
             int i = 0;
@@ -661,7 +903,8 @@ void CameraHandler::showPlaybackGui()
 }
 
 void CameraHandler::fixSkeleton() {
-    // TODO: This wont work if there are multiple cameras so we only use the first
+    PROFILE_FUNCTION();
+    // The labels belong to the Nuitrack skeleton of a single camera, recordings with several cameras are fused in calculateSkeletonsOpenpose
     auto cam = m_DepthCameras[0];
 
     ImGui::Begin("Fix Skeleton", &m_FixSkeleton);
@@ -676,7 +919,7 @@ void CameraHandler::fixSkeleton() {
         m_CurrentPlaybackFrame = 0;
     }
 
-    Json::Value& skel_frame = m_RecordedSkeleton[m_CurrentPlaybackFrame * 10];
+    Json::Value& skel_frame = m_RecordedSkeleton[SkeletonDetectorNuitrack::getKeyframeIndex(m_Recording["Cameras"][0]["Keyframes"], m_CurrentPlaybackFrame)];
 
     if (!skel_frame) {
         m_CurrentPlaybackFrame += 1;
@@ -851,6 +1094,7 @@ void CameraHandler::stopPlayback()
 /// 
 
 void CameraHandler::calculateSkeletonsNuitrack(Json::Value recording) {
+    PROFILE_FUNCTION();
     m_TotalPlaybackFrames = recording["RecordedFrames"].asInt();
 
     for (auto camera : recording["Cameras"]) {
@@ -894,6 +1138,7 @@ void CameraHandler::calculateSkeletonsNuitrack(Json::Value recording) {
 }
 
 void CameraHandler::calculateSkeletonsOpenpose(Json::Value recording) {
+    PROFILE_FUNCTION();
     startPlayback(recording);
 
     if (!m_CamerasExist) {
@@ -901,18 +1146,51 @@ void CameraHandler::calculateSkeletonsOpenpose(Json::Value recording) {
         return;
     }
 
+    m_SkeletonDetectorOpenPose->setFramesInFlight(m_OpenPoseFramesInFlight);
     m_SkeletonDetectorOpenPose->startRecording(getFileSafeSessionName(recording["Name"].asString()));
 
+    // Index of the detection of every frame of every camera, -1 for frames in between keyframes
+    std::vector<KeyframeScheduler> schedulers(m_DepthCameras.size(), KeyframeScheduler{ m_KeyframeParams });
+    std::vector<std::vector<int>> detections(m_DepthCameras.size(), std::vector<int>(m_TotalPlaybackFrames, -1));
+    std::vector<cv::Size> imageSizes(m_DepthCameras.size());
+    int detected = 0;
+
     for (;m_CurrentPlaybackFrame < m_TotalPlaybackFrames; m_CurrentPlaybackFrame++) {
-        for (auto cam : m_DepthCameras) {
-            // Get it and forget it
-            mp_PointCloud->OnUpdate();
+        for (int cam_id = 0; cam_id < m_DepthCameras.size(); cam_id++) {
+            auto cam = m_DepthCameras[cam_id];
+            // Only advances the camera to the frame, nothing is uploaded to the point cloud
+            cam->getDepth();
             auto frame_to_process = cam->getColorFrame();
-            m_SkeletonDetectorOpenPose->saveFrame(frame_to_process);
+            if (!frame_to_process.empty())
+                imageSizes[cam_id] = frame_to_process.size();
+
+            if (!m_UseKeyframes || schedulers[cam_id].update(frame_to_process)) {
+                m_SkeletonDetectorOpenPose->queueFrame(frame_to_process);
+                detections[cam_id][m_CurrentPlaybackFrame] = detected++;
+            }
         }
         std::cout << m_CurrentPlaybackFrame << "/" << m_TotalPlaybackFrames << " Processed" << "\r";
     }
 
+    auto& skeletons = m_SkeletonDetectorOpenPose->finishFrames();
+    if (m_UseKeyframes) {
+        mp_Logger->log("Detected skeletons on " + std::to_string(detected) + " of " + std::to_string(m_TotalPlaybackFrames * m_DepthCameras.size()) + " frames, tracking the rest");
+
+        Json::Value keyframes = skeletons;
+        skeletons = trackSkeletons(recording, keyframes, detections);
+    }
+    m_FoundRecordedSkeleton = false;
+
+    if (m_DepthCameras.size() > 1) {
+        auto fusedPath = m_RecordingDirectory / getFileSafeSessionName(recording["Name"].asString()) / "OPSkeletonFused.json";
+        std::fstream fusedJson(fusedPath, std::ios::out | std::ios::trunc);
+        Json::StreamWriterBuilder builder;
+        fusedJson << Json::writeString(builder, fuseRecordedSkeletons(skeletons, imageSizes));
+        fusedJson.close();
+
+        recording["Fused Skeleton"] = getFileSafeSessionName(recording["Name"].asString()) + "/" + fusedPath.filename().string();
+    }
+
     recording["Skeleton"] = getFileSafeSessionName(recording["Name"].asString()) + "/" + m_SkeletonDetectorOpenPose->stopRecording();
 
     auto configPath = m_RecordingDirectory / getFileSafeSessionName(recording["Name"].asString());
@@ -936,6 +1214,125 @@ void CameraHandler::calculateSkeletonsOpenpose(Json::Value recording) {
     m_State = Streaming;
 }
 
+Json::Value CameraHandler::trackSkeletons(Json::Value recording, const Json::Value& keyframes, const std::vector<std::vector<int>>& detections)
+{
+    PROFILE_FUNCTION();
+    // The recording is played a second time, the frames in between keyframes only run the tracker
+    m_FoundRecordedSkeleton = false;
+    startPlayback(recording);
+    m_FoundRecordedSkeleton = false;
+
+    std::vector<JointTracker> trackers(m_DepthCameras.size());
+    Json::Value skeletons{ Json::arrayValue };
+
+    for (; m_CurrentPlaybackFrame < m_TotalPlaybackFrames; m_CurrentPlaybackFrame++) {
+        for (int cam_id = 0; cam_id < m_DepthCameras.size(); cam_id++) {
+            auto cam = m_DepthCameras[cam_id];
+            auto depth = cam->getFilteredDepth();
+            auto frame = cam->getColorFrame();
+
+            const int detection = cam_id < detections.size() ? detections[cam_id][m_CurrentPlaybackFrame] : -1;
+            if (detection >= 0) {
+                skeletons.append(trackers[cam_id].reset(keyframes[detection], frame));
+                continue;
+            }
+
+            cv::Mat depthMat;
+            if (depth != nullptr)
+                depthMat = cv::Mat(cam->getDepthStreamHeight(), cam->getDepthStreamWidth(), CV_16UC1, (void*)depth);
+
+            skeletons.append(trackers[cam_id].track(frame, depthMat, cam->getMetersPerUnit()));
+        }
+        std::cout << m_CurrentPlaybackFrame << "/" << m_TotalPlaybackFrames << " Tracked" << "\r";
+    }
+
+    return skeletons;
+}
+
+/// 
+/// Skeleton Fusion
+/// 
+
+std::vector<SkeletonFusion::View> CameraHandler::getFusionViews(const std::vector<cv::Size>& imageSizes) const
+{
+    std::vector<SkeletonFusion::View> views;
+    for (int cam_id = 0; cam_id < m_DepthCameras.size(); cam_id++) {
+        auto cam = m_DepthCameras[cam_id];
+        auto& view = views.emplace_back();
+
+        view.Intrinsics = { cam->getIntrinsics(INTRINSICS::FX), cam->getIntrinsics(INTRINSICS::FY),
+                            cam->getIntrinsics(INTRINSICS::CX), cam->getIntrinsics(INTRINSICS::CY) };
+        view.DepthSize = { cam->getDepthStreamWidth(), cam->getDepthStreamHeight() };
+        view.ImageSize = view.DepthSize;
+        if (cam_id < imageSizes.size() && !imageSizes[cam_id].empty())
+            view.ImageSize = { imageSizes[cam_id].width, imageSizes[cam_id].height };
+        view.Model = mp_PointCloud->getCameraModel(cam_id);
+    }
+
+    return views;
+}
+
+void CameraHandler::fuseSkeletons(const std::vector<Json::Value>& people, const std::vector<cv::Size>& imageSizes)
+{
+    PROFILE_FUNCTION();
+    const auto start = std::chrono::high_resolution_clock::now();
+
+    // The alignment can change between frames while streaming
+    m_SkeletonFusion.setViews(getFusionViews(imageSizes));
+    m_FusedSkeleton = m_SkeletonFusion.fuse(people);
+
+    m_FusionTime = std::chrono::duration<float, std::milli>(std::chrono::high_resolution_clock::now() - start).count();
+}
+
+void CameraHandler::showSkeletonFusion()
+{
+    ImGui::Begin("Skeleton Fusion");
+
+    auto& params = m_SkeletonFusion.getParameters();
+    ImGui::SliderFloat("Min Score", &params.MinScore, 0.0f, 1.0f, "%.2f");
+    ImGui::SliderFloat("Max Reprojection Error", &params.MaxReprojectionError, 1.0f, 100.0f, "%.1f px");
+    ImGuiHelper::HelpMarker("A view with a larger error is rejected as an outlier, as long as two other views see the joint");
+    ImGui::SliderFloat("Max Match Error", &params.MaxMatchError, 1.0f, 200.0f, "%.1f px");
+    ImGuiHelper::HelpMarker("Two skeletons in different views belong to the same person if their joints reproject with at most this error");
+    ImGui::SliderFloat("Depth Weight", &params.DepthWeight, 0.0f, 2.0f, "%.2f");
+
+    ImGui::Text("%d People fused in %.3f ms", m_FusedSkeleton.size(), m_FusionTime);
+    for (Json::ArrayIndex person = 0; person < m_FusedSkeleton.size(); person++) {
+        int valid = 0;
+        float error = 0.0f;
+        for (const auto& joint : m_FusedSkeleton[person]["Skeleton"]) {
+            if (!joint["valid"].asBool())
+                continue;
+
+            valid++;
+            error += joint["error"].asFloat();
+        }
+
+        ImGui::Text("Person %d: %d Views, %d Joints, %.1f px mean error", person, m_FusedSkeleton[person]["Views"].size(), valid, valid > 0 ? error / valid : 0.0f);
+    }
+
+    ImGui::End();
+}
+
+Json::Value CameraHandler::fuseRecordedSkeletons(const Json::Value& skeletons, const std::vector<cv::Size>& imageSizes)
+{
+    PROFILE_FUNCTION();
+    m_SkeletonFusion.setViews(getFusionViews(imageSizes));
+
+    const int cameras = (int)m_DepthCameras.size();
+    Json::Value fused{ Json::arrayValue };
+    std::vector<Json::Value> people(cameras);
+
+    for (Json::ArrayIndex frame = 0; (frame + 1) * cameras <= skeletons.size(); frame++) {
+        for (int cam_id = 0; cam_id < cameras; cam_id++)
+            people[cam_id] = skeletons[frame * cameras + cam_id];
+
+        fused.append(m_SkeletonFusion.fuse(people));
+    }
+
+    return fused;
+}
+
 /// 
 /// Utils
 /// 
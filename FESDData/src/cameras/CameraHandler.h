@@ -3,16 +3,20 @@
 #include <chrono>
 #include <string>
 #include <memory>
+#include <fstream>
 
 #include <opencv2/opencv.hpp>
 #include <GLCore/Camera.h>
 #include <GLCore/Renderer.h>
 
 #include "DepthCamera.h"
+#include "obj/KeyframeTracker.h"
 #include "obj/Logger.h"
 #include "obj/SkeletonDetectorOpenPose.h"
 #include "obj/SkeletonDetectorNuitrack.h"
+#include "obj/SkeletonFusion.h"
 #include "obj/SessionParameters.h"
+#include "utilities/CalibrationStore.h"
 
 class CameraHandler
 {
@@ -24,14 +28,21 @@ public:
 	void OnImGuiRender();
 private:
 	void initAllCameras();
+	void loadCalibration();
+	/// <summary>
+	/// Store the calibration of every camera, the extrinsics only after a registration or if the user saves them
+	/// </summary>
+	void saveCalibration(bool explicitSave);
 
 	// Streaming
 	void showGeneralGui();
 	void stream();
+	cv::Rect getSubjectRoi(int cam_id, cv::Size frameSize) const;
 
 	// Recording
 	void initRecording();
 	void countdown();
+	void learnBackground();
 	void startRecording();
 	void showRecordingGui();
 	void showRecordingStats();
@@ -50,6 +61,21 @@ private:
 	// Skeleton Detection
 	void calculateSkeletonsNuitrack(Json::Value recording);
 	void calculateSkeletonsOpenpose(Json::Value recording);
+	Json::Value trackSkeletons(Json::Value recording, const Json::Value& keyframes, const std::vector<std::vector<int>>& detections);
+
+	// Skeleton Fusion
+	/// <summary>
+	/// Views of the current cameras with the extrinsics of the point cloud
+	/// </summary>
+	/// <param name="imageSizes">Resolution of the color frame of every camera the joints are detected in</param>
+	std::vector<SkeletonFusion::View> getFusionViews(const std::vector<cv::Size>& imageSizes) const;
+	void fuseSkeletons(const std::vector<Json::Value>& people, const std::vector<cv::Size>& imageSizes);
+	void showSkeletonFusion();
+	/// <summary>
+	/// Fuse the skeletons of a recording, they are interleaved by camera (frame * cameras + camera)
+	/// </summary>
+	/// <returns>The fused people of every frame</returns>
+	Json::Value fuseRecordedSkeletons(const Json::Value& skeletons, const std::vector<cv::Size>& imageSizes);
 
 	// Utils
 	void clearCameras();
@@ -75,6 +101,7 @@ private:
 	bool m_ShowColorFrames{ false };
 	std::unique_ptr<GLObject::PointCloud> mp_PointCloud;
 	std::vector<DepthCamera *> m_DepthCameras;
+	CalibrationStore m_CalibrationStore{ };
 
 	// Recording
 	std::string m_SessionName{ };
@@ -83,6 +110,7 @@ private:
 	std::chrono::time_point<std::chrono::system_clock> m_RecordingEnd;
 	std::chrono::duration<double> m_RecordedSeconds;
 	int m_RecordedFrames{ 0 };
+	std::fstream m_StatisticsCSV{ };	// Depth statistics of every frame, only if the point cloud is streamed while recording
 
 	// Playback
 	std::vector<Json::Value> m_Recordings;
@@ -100,7 +128,16 @@ private:
 	float m_ScoreThreshold{ 0.0f };
 	bool m_ShowUncertainty{ false };
 	bool m_UseNuitrack{ false };
+	int m_OpenPoseFramesInFlight{ 4 };
+	bool m_UseKeyframes{ true };
+	KeyframeScheduler::Parameters m_KeyframeParams{ };
 	std::unique_ptr<SkeletonDetectorOpenPose> m_SkeletonDetectorOpenPose;
 	std::unique_ptr<SkeletonDetectorNuitrack> m_SkeletonDetectorNuitrack;
+
+	// Skeleton Fusion
+	bool m_FuseSkeletons{ true };
+	SkeletonFusion m_SkeletonFusion{ };
+	Json::Value m_FusedSkeleton{ };
+	float m_FusionTime{ 0.0f };		// Of the last frameset (in ms)
 };
 
@@ -8,6 +8,7 @@
 #include <json/json.h>
 #include <GLCore/Renderer.h>
 
+#include "obj/DepthFilter.h"
 #include "obj/Logger.h"
 
 namespace GLObject
@@ -34,6 +35,19 @@ public:
 	/// <returns>Pointer to first depth pixel</returns>
 	virtual const void *getDepth() = 0;
 
+	/// <summary>
+	/// Gets current depth frame after the depth filter of the camera, the raw frame if the filter is disabled
+	/// </summary>
+	/// <returns>Pointer to first depth pixel</returns>
+	const void *getFilteredDepth()
+	{
+		auto depth = getDepth();
+		if (depth == nullptr || !m_DepthFilter.isEnabled())
+			return depth;
+
+		return m_DepthFilter.apply(static_cast<const uint16_t*>(depth), getDepthStreamWidth(), getDepthStreamHeight(), getMetersPerUnit());
+	}
+
 	/// <summary>
 	/// Gets current color frame for skeleton detection
 	/// </summary>
@@ -67,9 +81,10 @@ public:
 	virtual void saveFrame() = 0;
 
 	/// <summary>
-	/// Stop recording
+	/// Stop recording, only the output files are closed and the device stays open for the next recording
 	/// </summary>
-	virtual void stopRecording() = 0;
+	/// <param name="resumeStreaming">Return to the live stream, false if the next recording starts right away. Cameras which stream while recording ignore it (Orbbec)</param>
+	virtual void stopRecording(bool resumeStreaming = true) = 0;
 	
 	virtual void showCameraInfo() = 0;
 
@@ -77,6 +92,17 @@ public:
 	virtual glm::mat3 getIntrinsics() const = 0;
 	virtual float getMetersPerUnit() const = 0;
 
+	/// <summary>
+	/// Replace the intrinsics, e.g. by a stored calibration. Cameras with a factory calibration ignore this
+	/// </summary>
+	virtual void setIntrinsics(const glm::mat3& intrinsics) { }
+
+	/// <returns>Serial number or URI identifying the device, empty for playback</returns>
+	virtual std::string getSerial() const { return ""; }
+
+	/// <returns>The color frame is registered to the depth frame, so a region of the depth frame covers the same part of the scene in the color frame</returns>
+	virtual bool isColorAlignedToDepth() const { return false; }
+
 	virtual void CameraSettings() =0;
 
 	/// <returns>Camera Name</returns>
@@ -96,6 +122,7 @@ public:
 
 	bool m_IsEnabled{ true };
 	bool m_IsSelectedForRecording{ true };
+	DepthFilter m_DepthFilter{ };
 protected:
 	unsigned int m_CameraId{ 0 };
 	Json::Value m_CameraInfromation;
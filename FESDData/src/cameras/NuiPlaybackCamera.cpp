@@ -8,6 +8,9 @@
 #include "obj/PointCloud.h"
 #include "obj/SkeletonDetectorNuitrack.h"
 #include "utilities/Consts.h"
+#include "utilities/FrameIO.h"
+#include "utilities/FramePool.h"
+#include "utilities/Profiler.h"
 #include "utilities/helper/ImGuiHelper.h"
 
 /// 
@@ -19,6 +22,14 @@ NuiPlaybackCamera::NuiPlaybackCamera(Camera* cam, Renderer* renderer, Logger::Lo
 {
     mp_Logger->log("Opening NuiRecording in '" + m_RecordingPath.string() + "'");
     m_QueriedFrame = -1;
+
+    m_Cropped = camera["Cropped"].asBool();
+    if (m_Cropped) {
+        m_FullWidth = camera["Width"].asInt();
+        m_FullHeight = camera["Height"].asInt();
+        m_Regions = camera["Regions"];
+    }
+    m_Keyframes = camera["Keyframes"];
     
     queryFrame();
     auto size = m_CurrentDepthFrame.size;
@@ -95,57 +106,81 @@ inline float NuiPlaybackCamera::getMetersPerUnit() const
 /// 
 
 void NuiPlaybackCamera::queryFrame() {
+    PROFILE_FUNCTION();
     if (m_QueriedFrame == *mp_CurrentPlaybackFrame) {
         return;
     }
     try {  
-        cv::Mat frame;
-        auto frame_path = m_RecordingPath / SkeletonDetectorNuitrack::getFrameName((*mp_CurrentPlaybackFrame) * 10);
+        cv::Mat depth, color;
+        float depthScale{ 0.001f }, colorScale{ 1.0f / 255.0f };
+        const int frame_index = SkeletonDetectorNuitrack::getKeyframeIndex(m_Keyframes, *mp_CurrentPlaybackFrame);
+        auto frame_path = m_RecordingPath / SkeletonDetectorNuitrack::getFrameName(frame_index);
         if (std::filesystem::exists(frame_path.replace_extension(".bin"))) {
-            std::ifstream fs(frame_path.replace_extension(".bin"), std::fstream::binary);
-
-            // Header
-            int rows, cols, type, channels;
-            fs.read((char*)&rows, sizeof(int));         // rows
-            fs.read((char*)&cols, sizeof(int));         // cols
-            fs.read((char*)&type, sizeof(int));         // type
-            fs.read((char*)&channels, sizeof(int));     // channels
-
-            // Data
-            cv::Mat mat( rows, cols, type );
-            fs.read((char*)mat.data, CV_ELEM_SIZE(type) * rows * cols);
-            frame = mat;
+            // Only the depth and colour planes are read, older interleaved frames are split by FrameIO
+            auto planes = FrameIO::readPlanes(frame_path, { FrameIO::PlaneId::Depth, FrameIO::PlaneId::Color });
+            depth = planes[0].Data;
+            depthScale = planes[0].Scale;
+            color = planes[1].Data;
+            colorScale = planes[1].Scale;
         }
         else if (std::filesystem::exists(frame_path.replace_extension(".yml")))
         {
+            cv::Mat frame;
             cv::FileStorage frameStore((frame_path.replace_extension(".yml")).string(), cv::FileStorage::READ);
 
             frameStore["frame"] >> frame;
             frameStore.release();
+
+            if (!frame.empty()) {
+                std::vector<cv::Mat> channels;
+                cv::split(frame, channels);
+
+                depth = channels[3];
+                depthScale = 1.0f;
+                channels.pop_back();
+                cv::merge(channels, color);
+                colorScale = 1.0f;
+            }
         }
         else {
             mp_Logger->log("Frame '" + SkeletonDetectorNuitrack::getFrameName(*mp_CurrentPlaybackFrame) + "' not found!", Logger::Priority::ERR);
             return;
         }
             
-        if (frame.empty()) {
+        if (depth.empty() || color.empty()) {
             mp_Logger->log("Frame '" + SkeletonDetectorNuitrack::getFrameName(*mp_CurrentPlaybackFrame) + "' not found!", Logger::Priority::ERR);
             return;
         }
 
-        std::vector<cv::Mat> channels;
-        cv::split(frame, channels);
-
-        m_CurrentDepthFrame = channels[3];
-        m_CurrentDepthFrame = m_CurrentDepthFrame.reshape(0, m_DepthWidth);
+        // Every frame gets new buffers from the pool, a frame still held by another stage is not overwritten
+        auto& pool = FramePool::getInstance();
+        cv::Mat depthFrame, colorFrame;
+        if (m_Cropped && frame_index < (int)m_Regions.size()) {
+            const auto& region = m_Regions[frame_index];
+            const cv::Rect roi{ region[0].asInt(), region[1].asInt(), region[2].asInt(), region[3].asInt() };
+
+            depthFrame = pool.acquire(m_FullHeight, m_FullWidth, CV_16UC1);
+            colorFrame = pool.acquire(m_FullHeight, m_FullWidth, CV_8UC3);
+            depthFrame.setTo(0);
+            colorFrame.setTo(0);
+
+            // Converted straight into the region of the full frames
+            cv::Mat depthRegion = depthFrame(roi);
+            cv::Mat colorRegion = colorFrame(roi);
+            depth.convertTo(depthRegion, CV_16UC1, depthScale / m_MetersPerUnit);
+            color.convertTo(colorRegion, CV_8UC3, colorScale * 255.0f);
+        }
+        else {
+            depthFrame = pool.acquire(depth.rows, depth.cols, CV_16UC1);
+            colorFrame = pool.acquire(color.rows, color.cols, CV_8UC3);
 
-        m_CurrentDepthFrame /= m_MetersPerUnit; // Transform meters to units
-        m_CurrentDepthFrame.convertTo(m_CurrentDepthFrame, CV_16UC1);
+            // Transform the stored unit to the units of the camera, the colour is brought to 8 bit
+            depth.convertTo(depthFrame, CV_16UC1, depthScale / m_MetersPerUnit);
+            color.convertTo(colorFrame, CV_8UC3, colorScale * 255.0f);
+        }
 
-        channels.pop_back();
-        cv::merge(channels, m_CurrentColorFrame);
-        m_CurrentColorFrame *= 255;
-        m_CurrentColorFrame.convertTo(m_CurrentColorFrame, CV_8UC3);
+        m_CurrentDepthFrame = depthFrame.reshape(0, m_DepthWidth);
+        m_CurrentColorFrame = colorFrame;
 
         m_QueriedFrame = *mp_CurrentPlaybackFrame;
     }
@@ -33,7 +33,7 @@ public:
 	/// Recording
 	std::string startRecording(std::string sessionName) override { mp_Logger->log("NuiPlayback does not support Recording", Logger::Priority::ERR); return ""; };
 	void saveFrame() override { mp_Logger->log("NuiPlayback does not support Recording", Logger::Priority::ERR); };
-	void stopRecording() override { mp_Logger->log("NuiPlayback does not support Recording", Logger::Priority::ERR); };
+	void stopRecording(bool resumeStreaming = true) override { mp_Logger->log("NuiPlayback does not support Recording", Logger::Priority::ERR); };
 private:
 	Logger::Logger* mp_Logger;
 	int m_QueriedFrame{ -1 };
@@ -46,6 +46,15 @@ private:
 
 	std::filesystem::path m_RecordingPath{ };
 
+	// Frames cropped to the subject are pasted into a frame of this size
+	bool m_Cropped{ false };
+	int m_FullWidth{ 0 };
+	int m_FullHeight{ 0 };
+	Json::Value m_Regions{ };
+
+	// Recorded frames with the full colour and depth, see SkeletonDetectorNuitrack::getKeyframeIndex
+	Json::Value m_Keyframes{ };
+
 	unsigned int m_DepthWidth{ 0 };
 	unsigned int m_DepthHeight{ 0 };
 
@@ -7,7 +7,9 @@
 
 #include "obj/PointCloud.h"
 #include "utilities/Consts.h"
+#include "utilities/FramePool.h"
 #include "utilities/helper/ImGuiHelper.h"
+#include "utilities/Profiler.h"
 
 /// 
 /// Constructors & Destructors
@@ -57,6 +59,7 @@ OrbbecCamera::OrbbecCamera(openni::DeviceInfo deviceInfo, Camera* cam, Renderer*
 
     m_DepthWidth = m_DepthFrameRef.getWidth();
     m_DepthHeight = m_DepthFrameRef.getHeight();
+    initIntrinsics();
 
     m_ColorStream = cv::VideoCapture{ 0, cv::CAP_DSHOW };
 
@@ -99,6 +102,7 @@ OrbbecCamera::OrbbecCamera(Camera* cam, Renderer* renderer, Logger::Logger* logg
     
     m_DepthWidth = m_DepthFrameRef.getWidth();
     m_DepthHeight = m_DepthFrameRef.getHeight();
+    initIntrinsics();
 
     m_IsPlayback = true;
     m_IsEnabled = true;
@@ -173,26 +177,31 @@ void OrbbecCamera::printDeviceInfo() const {
 }
 
 
-inline float OrbbecCamera::getIntrinsics(INTRINSICS intrin) const
+void OrbbecCamera::initIntrinsics()
 {
+    // The field of view does not change while the stream is running, so this is only done once
     //https://towardsdatascience.com/inverse-projection-transformation-c866ccedef1c
-    auto fx = getDepthStreamWidth()  / (2.f * tan(m_DepthStream.getHorizontalFieldOfView() / 2.f));
-    auto fy = getDepthStreamHeight() / (2.f * tan(m_DepthStream.getVerticalFieldOfView()   / 2.f));
-    auto cx = getDepthStreamWidth()  / 2; 
-    auto cy = getDepthStreamHeight() / 2;
+    m_Fx = getDepthStreamWidth()  / (2.f * tan(m_DepthStream.getHorizontalFieldOfView() / 2.f));
+    m_Fy = getDepthStreamHeight() / (2.f * tan(m_DepthStream.getVerticalFieldOfView()   / 2.f));
+    m_Cx = (float)(getDepthStreamWidth()  / 2);
+    m_Cy = (float)(getDepthStreamHeight() / 2);
+}
 
+inline float OrbbecCamera::getIntrinsics(INTRINSICS intrin) const
+{
     switch (intrin)
     {
         using enum INTRINSICS;
     case FX:
-        return fx;
+        return m_Fx;
     case FY:
-        return fy;
+        return m_Fy;
     case CX:
-        return (float)cx;
+        return m_Cx;
     case CY:
-        return (float)cy;
+        return m_Cy;
     }
+    return 0.0f;
 }
 
 inline glm::mat3 OrbbecCamera::getIntrinsics() const
@@ -207,12 +216,35 @@ inline float OrbbecCamera::getMetersPerUnit() const
     return m_MetersPerUnit;
 }
 
+void OrbbecCamera::setIntrinsics(const glm::mat3& intrinsics)
+{
+    m_Fx = intrinsics[0][0];
+    m_Fy = intrinsics[1][1];
+    m_Cx = intrinsics[0][2];
+    m_Cy = intrinsics[1][2];
+}
+
+std::string OrbbecCamera::getSerial() const
+{
+    if (m_IsPlayback)
+        return "";
+
+    char serial[64]{ };
+    int size = sizeof(serial);
+    if (m_Device.getProperty(openni::DEVICE_PROPERTY_SERIAL_NUMBER, serial, &size) == openni::STATUS_OK && serial[0] != '\0')
+        return serial;
+
+    // Not every driver reports a serial, the URI is stable as long as the device stays on the same port
+    return m_DeviceInfo.getUri();
+}
+
 /// 
 /// Frame retreival
 /// 
 
 const void *OrbbecCamera::getDepth()
 {
+    PROFILE_FUNCTION();
     if (m_IsPlayback) {
         mp_PlaybackController->seek(m_DepthStream, *mp_CurrentPlaybackFrame);
     }
@@ -248,6 +280,7 @@ const void *OrbbecCamera::getDepth()
 
 cv::Mat OrbbecCamera::getColorFrame()
 {
+    PROFILE_FUNCTION();
     if (!m_CVCameraFound) {
         while (!m_ColorStream.grab() && m_CVCameraId < m_CVCameraSearchDepth) {
             m_CVCameraId += 1;
@@ -270,7 +303,11 @@ cv::Mat OrbbecCamera::getColorFrame()
         if (m_IsPlayback) {
             m_ColorStream.set(cv::CAP_PROP_POS_FRAMES, *mp_CurrentPlaybackFrame);
         }
-        m_ColorStream.retrieve(m_ColorFrame);
+
+        // Retrieved into a new matrix from the pool, the last frame may still be held by another stage
+        cv::Mat frame = FramePool::getInstance().acquire();
+        if (m_ColorStream.retrieve(frame))
+            m_ColorFrame = frame;
     }
 
     return m_ColorFrame;
@@ -348,6 +385,7 @@ std::string OrbbecCamera::startRecording(std::string sessionName)
 }
 
 void OrbbecCamera::saveFrame() {
+    PROFILE_FUNCTION();
     std::thread depth_save_thread(&OrbbecCamera::saveDepth, this);
     std::thread color_save_thread(&OrbbecCamera::saveColor, this);
     depth_save_thread.join();
@@ -355,6 +393,7 @@ void OrbbecCamera::saveFrame() {
 }
 
 void OrbbecCamera::saveDepth() {
+    PROFILE_FUNCTION();
     int changedStreamDummy;
     openni::VideoStream* pStream = &m_DepthStream;
 
@@ -368,11 +407,13 @@ void OrbbecCamera::saveDepth() {
 }
 
 void OrbbecCamera::saveColor() {
+    PROFILE_FUNCTION();
     m_ColorStreamRecorder.write(getColorFrame());
 }
 
-void OrbbecCamera::stopRecording()
+void OrbbecCamera::stopRecording(bool resumeStreaming)
 {
+    // The depth stream keeps running either way, only the recorders are closed, so there is nothing to resume
     m_IsRecording = false;
     m_Recorder.stop();
     m_Recorder.destroy();
@@ -28,6 +28,8 @@ public:
 	inline float getIntrinsics(INTRINSICS intrin) const override;
 	inline glm::mat3 getIntrinsics() const override;
 	inline float getMetersPerUnit() const override;
+	void setIntrinsics(const glm::mat3& intrinsics) override;
+	std::string getSerial() const override;
 
 	/// Frame retreival
 	const void * getDepth() override;
@@ -41,9 +43,10 @@ public:
 	void saveFrame() override;
 	void saveDepth();
 	void saveColor();
-	void stopRecording() override;
+	void stopRecording(bool resumeStreaming = true) override;
 private:
 	void errorHandling(std::string error_string = "");
+	void initIntrinsics();
 
 	openni::DeviceInfo m_DeviceInfo;
 	openni::Device m_Device;
@@ -69,6 +72,7 @@ private:
 	unsigned int m_DepthWidth;
 	unsigned int m_DepthHeight;
 	float m_MetersPerUnit{ 1.f/1000.f };
+	float m_Fx{ }, m_Fy{ }, m_Cx{ }, m_Cy{ };
 
 	int m_CVCameraId{ 0 };
 	int m_CVCameraSearchDepth{ 10 };
@@ -6,6 +6,8 @@
 
 #include "obj/PointCloud.h"
 #include "utilities/Consts.h"
+#include "utilities/FramePool.h"
+#include "utilities/Profiler.h"
 
 /// 
 /// Constructors & Destructors
@@ -23,9 +25,11 @@ RealSenseCamera::RealSenseCamera(rs2::context* ctx, rs2::device* device, Camera*
 
 	printDeviceInfo();
 	m_Device.query_sensors();
-	m_Config.enable_device(m_Device.get_info(RS2_CAMERA_INFO_SERIAL_NUMBER));
+	m_Serial = m_Device.get_info(RS2_CAMERA_INFO_SERIAL_NUMBER);
+	m_Config.enable_device(m_Serial);
 
 	auto profile = mp_Pipe->start(m_Config);
+	m_PipelineRunning = true;
 
 	rs2::frameset data = mp_Pipe->wait_for_frames(); // Wait for next set of frames from the camera
 	rs2::frame depth = data.get_depth_frame();
@@ -40,6 +44,8 @@ RealSenseCamera::RealSenseCamera(rs2::context* ctx, rs2::device* device, Camera*
 
 	rs2::depth_frame depth_frame = depth.as<rs2::depth_frame>();
 	m_MetersPerUnit = depth_frame.get_units();
+
+	startWorker(true);
 }
 
 RealSenseCamera::RealSenseCamera(Camera* cam, Renderer* renderer, Logger::Logger* logger, std::filesystem::path recording, int *currentPlaybackFrame) :
@@ -49,6 +55,7 @@ RealSenseCamera::RealSenseCamera(Camera* cam, Renderer* renderer, Logger::Logger
 	rs2::config cfg;
 	cfg.enable_device_from_file(recording.string());
 	mp_Pipe->start(cfg); //File will be opened in read mode at this point
+	m_PipelineRunning = true;
 	m_Device = mp_Pipe->get_active_profile().get_device();
 	m_Device.as<rs2::playback>().set_real_time(false);
 
@@ -70,9 +77,8 @@ RealSenseCamera::RealSenseCamera(Camera* cam, Renderer* renderer, Logger::Logger
 
 RealSenseCamera::~RealSenseCamera() {
 	mp_Logger->log("Shutting down [Realsense] " + getCameraName());
-	
 	try {
-		mp_Pipe->stop();
+		stopPipeline();
 	}
 	catch (...) {
 		mp_Logger->log("An exception occured while shutting down [Realsense] Camera " + getCameraName());
@@ -159,55 +165,133 @@ inline float RealSenseCamera::getMetersPerUnit() const
 	return m_MetersPerUnit;
 }
 
+std::string RealSenseCamera::getSerial() const
+{
+	if (m_Device.is<rs2::playback>())
+		return "";
+
+	return m_Device.get_info(RS2_CAMERA_INFO_SERIAL_NUMBER);
+}
+
 
 /// 
 /// Frame retreival
 /// 
 
-const void* RealSenseCamera::getDepth()
+void RealSenseCamera::startWorker(bool align)
 {
-	if (!m_Device.as<rs2::playback>()) {
-		rs2::frameset data = mp_Pipe->wait_for_frames(); // Wait for next set of frames from the camera
-		rs2::depth_frame depth = data.get_depth_frame();
-		if (m_Device.as<rs2::recorder>())
-			rs2::video_frame color = data.get_color_frame();
-		return depth.get_data();
-	}
-	else {
-		rs2::frameset data;
-
-		if (mp_Pipe->poll_for_frames(&data)) // Check if new frames are ready
-		{
-			rs2::depth_frame depth = data.get_depth_frame();
-			rs2::video_frame color = data.get_color_frame();
-			return depth.get_data();
+	m_WorkerAligns = align;
+	m_Worker = std::jthread([this, align](std::stop_token stop) {
+		while (!stop.stop_requested()) {
+			try {
+				rs2::frameset data;
+				if (!mp_Pipe->try_wait_for_frames(&data, READ_WAIT_TIMEOUT))
+					continue;
+
+				// Make sure the frameset is spatialy aligned 
+				// (each pixel in depth image corresponds to the same pixel in the color image)
+				if (align)
+					data = m_AlignToDepth.process(data);
+
+				m_FrameQueue.enqueue(data);
+			}
+			catch (const rs2::error& e) {
+				mp_Logger->log("Querying realsense frame failed: " + std::string(e.what()), Logger::Priority::WARN);
+			}
 		}
+	});
+}
 
-		return nullptr;
-	}
+void RealSenseCamera::stopWorker()
+{
+	if (!m_Worker.joinable())
+		return;
+
+	m_Worker.request_stop();
+	m_Worker.join();
 }
 
-cv::Mat RealSenseCamera::getColorFrame()
+void RealSenseCamera::startPipeline(const std::filesystem::path& recording)
+{
+	stopPipeline();
+
+	rs2::config cfg;
+	cfg.enable_device(m_Serial);
+	if (!recording.empty())
+		cfg.enable_record_to_file(recording.string());
+
+	mp_Pipe->start(cfg);
+	m_PipelineRunning = true;
+	m_Device = mp_Pipe->get_active_profile().get_device();
+
+	// While recording the frames are only drained, aligning them would be wasted
+	m_Frames = { };
+	startWorker(recording.empty());
+}
+
+void RealSenseCamera::stopPipeline()
+{
+	stopWorker();
+	if (!m_PipelineRunning)
+		return;
+
+	mp_Pipe->stop();
+	m_PipelineRunning = false;
+}
+
+bool RealSenseCamera::acquireFrames()
 {
+	PROFILE_FUNCTION();
 	rs2::frameset data;
 
 	if (m_Device.as<rs2::playback>()) {
-		if (!mp_Pipe->poll_for_frames(&data)) {
-			return {};
-		}
+		// Playback is not real time, every frameset is read on the caller so none is skipped
+		if (!mp_Pipe->poll_for_frames(&data))
+			return false;
+
+		m_FramesAligned = false;
 	}
 	else {
-		data = mp_Pipe->wait_for_frames();
+		if (!m_FrameQueue.try_wait_for_frame(&data, READ_WAIT_TIMEOUT))
+			return false;
+
+		m_FramesAligned = m_WorkerAligns;
+	}
+
+	m_Frames = data;
+	return true;
+}
+
+const void* RealSenseCamera::getDepth()
+{
+	PROFILE_FUNCTION();
+	if (!acquireFrames())
+		return nullptr;
+
+	rs2::depth_frame depth = m_Frames.get_depth_frame();
+	return depth ? depth.get_data() : nullptr;
+}
+
+cv::Mat RealSenseCamera::getColorFrame()
+{
+	PROFILE_FUNCTION();
+	if (!m_Frames && !acquireFrames())
+		return {};
 
+	if (!m_FramesAligned) {
+		m_Frames = m_AlignToDepth.process(m_Frames);
+		m_FramesAligned = true;
 	}
 
-	// Make sure the frameset is spatialy aligned 
-	// (each pixel in depth image corresponds to the same pixel in the color image)
-	rs2::frameset aligned_set = m_AlignToDepth.process(data);
-	rs2::video_frame color_frame = aligned_set.get_color_frame();
+	rs2::video_frame color_frame = m_Frames.get_color_frame();
+	if (!color_frame)
+		return {};
+
 	cv::Mat color_mat = { cv::Size(color_frame.get_width(), color_frame.get_height()), CV_8UC3, (void*)color_frame.get_data(), cv::Mat::AUTO_STEP };
-	cv::cvtColor(color_mat, color_mat, cv::COLOR_BGR2RGB);
-	return color_mat;
+	// Converting into a new matrix from the pool leaves the frame of the SDK untouched
+	cv::Mat rgb_mat = FramePool::getInstance().acquire(color_mat.rows, color_mat.cols, CV_8UC3);
+	cv::cvtColor(color_mat, rgb_mat, cv::COLOR_BGR2RGB);
+	return rgb_mat;
 }
 
 
@@ -222,17 +306,10 @@ std::string RealSenseCamera::startRecording(std::string sessionName)
 	std::ranges::replace(cameraName, ' ', '_');
 
 	std::filesystem::path filepath = m_RecordingDirectory / sessionName / (cameraName + ".bag");
-	if (!(m_Device).as<rs2::recorder>())
-	{
-		mp_Pipe->stop();
-		mp_Pipe = std::make_shared<rs2::pipeline>();
-		rs2::config cfg;
-		mp_Logger->log("Creaded Realsense Recorder");
-		
-		cfg.enable_record_to_file(filepath.string());
-		mp_Pipe->start(cfg);
-		m_Device = mp_Pipe->get_active_profile().get_device();
-	}
+
+	// Only the pipeline of this device is restarted with the next bag as its sink, no device is enumerated again
+	startPipeline(filepath);
+	mp_Logger->log("Created Realsense Recorder for " + filepath.filename().string());
 
 	m_CameraInfromation["Name"] = getCameraName();
 	m_CameraInfromation["Type"] = getType();
@@ -252,17 +329,17 @@ std::string RealSenseCamera::startRecording(std::string sessionName)
 }
 
 void RealSenseCamera::saveFrame() {
-	try {
-		rs2::frameset data = mp_Pipe->wait_for_frames();
-		data.get_depth_frame();
-		data.get_color_frame();
-	}
-	catch (...) {
+	PROFILE_FUNCTION();
+	// The recorder writes every frameset the pipeline receives, the worker keeps it flowing
+	if (!acquireFrames())
 		mp_Logger->log("Querying realsense frame failed", Logger::Priority::WARN);
-	}
 }
 
-void RealSenseCamera::stopRecording()
+void RealSenseCamera::stopRecording(bool resumeStreaming)
 {
-	mp_Pipe->stop();
+	// The bag is closed with the pipeline
+	if (resumeStreaming)
+		startPipeline();
+	else
+		stopPipeline();
 }
@@ -1,5 +1,6 @@
 #pragma once
 #include <memory>
+#include <thread>
 
 #include <librealsense2/rs.hpp>
 
@@ -25,9 +26,18 @@ public:
 	float getIntrinsics(INTRINSICS intrin) const override;
 	glm::mat3 getIntrinsics() const override;
 	float getMetersPerUnit() const override;
+	std::string getSerial() const override;
+	// getColorFrame aligns the colour to the depth frame
+	bool isColorAlignedToDepth() const override { return true; }
 
 	/// Frame retreival
+	/// <summary>
+	/// Advances to the next frameset, the depth stays valid until the next call
+	/// </summary>
 	const void *getDepth() override;
+	/// <summary>
+	/// Color of the current frameset aligned to the depth frame, i.e. the color taken at the same instant as the last depth frame
+	/// </summary>
 	cv::Mat getColorFrame() override;
 
 	/// Camera Settings
@@ -36,16 +46,44 @@ public:
 	/// Recording
 	std::string startRecording(std::string sessionName) override;
 	void saveFrame() override;
-	void stopRecording() override;
+	void stopRecording(bool resumeStreaming = true) override;
 private:
+	/// <summary>
+	/// Waits for framesets of the live device and aligns them on a worker thread, the latest one is kept in m_FrameQueue
+	/// </summary>
+	void startWorker(bool align);
+	void stopWorker();
+	/// <summary>
+	/// (Re)start the pipeline of the device, the device is selected by its serial so no other device is touched
+	/// </summary>
+	/// <param name="recording">Bag file the pipeline records to, empty for the live stream</param>
+	void startPipeline(const std::filesystem::path& recording = { });
+	void stopPipeline();
+	/// <summary>
+	/// Replace the current frameset with the next one
+	/// </summary>
+	/// <returns>False if there was no new frameset</returns>
+	bool acquireFrames();
+
 	std::shared_ptr<rs2::pipeline> mp_Pipe;
 	rs2::context* mp_Context{};
 	rs2::device* mp_ProtoDevice{};
 	rs2::device m_Device{};
 	rs2::config m_Config{};
+	std::string m_Serial{ };
+	bool m_PipelineRunning{ false };
 
 	rs2::align m_AlignToDepth{ RS2_STREAM_DEPTH };
 
+	// Only holds the latest frameset, older ones are dropped if the consumer is slower than the sensor
+	rs2::frame_queue m_FrameQueue{ 1, true };
+	std::jthread m_Worker{ };
+	bool m_WorkerAligns{ false };
+
+	// Depth and color of the current tick come from this frameset, holding it keeps the frame data alive
+	rs2::frameset m_Frames{ };
+	bool m_FramesAligned{ false };
+
 	rs2_intrinsics m_Intrinsics;
 
 	Logger::Logger* mp_Logger;
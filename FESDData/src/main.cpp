@@ -21,6 +21,7 @@
 #include "utilities/helper/GLFWHelper.h"
 #include "utilities/helper/ImGuiHelper.h"
 #include "utilities/WindowInfo.h"
+#include "utilities/Profiler.h"
 #include "samples/nuitrack_sample.h"
 Camera *cam = nullptr;
 
@@ -47,6 +48,8 @@ int main(void)
         Logger::Logger logger;
         logger.log("Initialised Log");
 
+        Profiler::setThreadName("Main");
+
         cam = new Camera{window};
         
         Renderer r;
@@ -58,6 +61,8 @@ int main(void)
         
         while (!glfwWindowShouldClose(window))
         {
+            PROFILE_SCOPE("Frame");
+
             float currentFrame = (float)glfwGetTime();
             deltaTime = currentFrame - lastFrame;
             lastFrame = currentFrame;
@@ -77,10 +82,17 @@ int main(void)
             cameraHandler.OnImGuiRender();
 
             logger.showLog();
+            Profiler::showProfiler();
 
-            ImGuiHelper::endFrame();
+            {
+                PROFILE_SCOPE("ImGuiHelper::endFrame");
+                ImGuiHelper::endFrame();
+            }
 
-            glfwSwapBuffers(window);
+            {
+                PROFILE_SCOPE("glfwSwapBuffers");
+                glfwSwapBuffers(window);
+            }
             glfwPollEvents();
         }
     }
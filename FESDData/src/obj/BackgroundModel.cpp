@@ -0,0 +1,196 @@
+#include "BackgroundModel.h"
+
+#include <algorithm>
+#include <cmath>
+#include <execution>
+#include <numeric>
+
+#include "utilities/Profiler.h"
+
+namespace {
+constexpr int RowsPerBlock{ 16 };
+}
+
+void BackgroundModel::resize(int width, int height)
+{
+    if (width == m_Width && height == m_Height)
+        return;
+
+    m_Width = width;
+    m_Height = height;
+
+    m_Background.assign((size_t)width * height, 0.0f);
+    m_ValidCount.assign((size_t)width * height, 0);
+    m_Mask.assign((size_t)width * height, 0);
+
+    m_Rows.resize((height + RowsPerBlock - 1) / RowsPerBlock);
+    std::iota(m_Rows.begin(), m_Rows.end(), 0);
+
+    m_RowCounts.assign(height, 0);
+    m_ColumnCounts.assign(width, 0);
+    m_BlockColumnCounts.assign(m_Rows.size(), std::vector<int>(width, 0));
+
+    // A background of a different resolution is useless
+    m_Ready = false;
+    m_LearnedFrames = 0;
+}
+
+///
+/// Learning
+///
+
+void BackgroundModel::startLearning()
+{
+    std::fill(m_Background.begin(), m_Background.end(), 0.0f);
+    std::fill(m_ValidCount.begin(), m_ValidCount.end(), (uint16_t)0);
+
+    m_LearnedFrames = 0;
+    m_Learning = true;
+    m_Ready = false;
+}
+
+template<typename DepthAt>
+void BackgroundModel::learn(int width, int height, DepthAt depthAt)
+{
+    PROFILE_FUNCTION();
+    if (!m_Learning)
+        return;
+
+    resize(width, height);
+
+    std::for_each(std::execution::par, m_Rows.begin(), m_Rows.end(), [&](int block) {
+        const int last = std::min(height, (block + 1) * RowsPerBlock);
+        for (size_t i = (size_t)block * RowsPerBlock * width; i < (size_t)last * width; i++) {
+            const float d = depthAt(i);
+            const bool valid = d > 0.0f;
+
+            m_Background[i] = std::max(m_Background[i], d);
+            m_ValidCount[i] += valid && m_ValidCount[i] < UINT16_MAX;
+        }
+    });
+
+    m_LearnedFrames++;
+}
+
+void BackgroundModel::learn(const uint16_t* depth, int width, int height, float metersPerUnit)
+{
+    learn(width, height, [=](size_t i) { return (float)depth[i] * metersPerUnit; });
+}
+
+void BackgroundModel::learn(const Point* points, int width, int height)
+{
+    learn(width, height, [=](size_t i) { return points[i].Depth; });
+}
+
+void BackgroundModel::finishLearning()
+{
+    if (!m_Learning)
+        return;
+
+    m_Learning = false;
+    if (m_LearnedFrames == 0)
+        return;
+
+    // Flickering pixels would show up as foreground every time they are valid
+    const uint16_t minValid = (uint16_t)std::ceil(m_Params.MinValidRatio * m_LearnedFrames);
+    for (size_t i = 0; i < m_Background.size(); i++) {
+        if (m_ValidCount[i] < minValid)
+            m_Background[i] = 0.0f;
+    }
+
+    m_Ready = true;
+}
+
+///
+/// Segmentation
+///
+
+template<typename DepthAt>
+const std::vector<uint8_t>& BackgroundModel::segment(int width, int height, DepthAt depthAt)
+{
+    PROFILE_FUNCTION();
+    if (!m_Ready || width != m_Width || height != m_Height) {
+        m_Region = { 0, 0, width, height };
+        return m_Mask;
+    }
+
+    const float threshold = m_Params.Threshold;
+    const float relative = m_Params.RelativeThreshold;
+
+    // Mask and foreground counts per row and per column, every block of rows has its own column counts
+    std::for_each(std::execution::par, m_Rows.begin(), m_Rows.end(), [&](int block) {
+        auto& columns = m_BlockColumnCounts[block];
+        std::fill(columns.begin(), columns.end(), 0);
+
+        const int last = std::min(height, (block + 1) * RowsPerBlock);
+        for (int y = block * RowsPerBlock; y < last; y++) {
+            int count = 0;
+            for (int x = 0; x < width; x++) {
+                const size_t i = (size_t)y * width + x;
+                const float d = depthAt(i);
+                const float b = m_Background[i];
+
+                const uint8_t foreground = d > 0.0f && (b <= 0.0f || d < b - threshold - relative * b);
+                m_Mask[i] = foreground;
+                columns[x] += foreground;
+                count += foreground;
+            }
+            m_RowCounts[y] = count;
+        }
+    });
+
+    std::fill(m_ColumnCounts.begin(), m_ColumnCounts.end(), 0);
+    for (const auto& columns : m_BlockColumnCounts) {
+        for (int x = 0; x < width; x++)
+            m_ColumnCounts[x] += columns[x];
+    }
+
+    // Region of interest from the rows and columns with enough support, single noisy pixels do not grow it
+    auto isLine = [&](int count) { return count >= m_Params.MinLinePixels; };
+    auto top = std::find_if(m_RowCounts.begin(), m_RowCounts.end(), isLine);
+    auto left = std::find_if(m_ColumnCounts.begin(), m_ColumnCounts.end(), isLine);
+    if (top == m_RowCounts.end() || left == m_ColumnCounts.end()) {
+        m_Region = { };
+        clearOutside(0, 0);
+        return m_Mask;
+    }
+
+    auto bottom = std::find_if(m_RowCounts.rbegin(), m_RowCounts.rend(), isLine);
+    auto right = std::find_if(m_ColumnCounts.rbegin(), m_ColumnCounts.rend(), isLine);
+
+    const int x0 = std::max(0, (int)(left - m_ColumnCounts.begin()) - m_Params.Margin);
+    const int y0 = std::max(0, (int)(top - m_RowCounts.begin()) - m_Params.Margin);
+    const int x1 = std::min(width, (int)(m_ColumnCounts.rend() - right) + m_Params.Margin);
+    const int y1 = std::min(height, (int)(m_RowCounts.rend() - bottom) + m_Params.Margin);
+
+    m_Region = { x0, y0, x1 - x0, y1 - y0 };
+    clearOutside(y0, y1);
+    return m_Mask;
+}
+
+void BackgroundModel::clearOutside(int firstRow, int lastRow)
+{
+    // Consumers may only look at the rows of the region, stray pixels outside of it must not be in the mask
+    for (int y = 0; y < m_Height; y++) {
+        if ((y < firstRow || y >= lastRow) && m_RowCounts[y] > 0)
+            std::fill_n(m_Mask.begin() + (size_t)y * m_Width, m_Width, (uint8_t)0);
+    }
+}
+
+const std::vector<uint8_t>& BackgroundModel::segment(const uint16_t* depth, int width, int height, float metersPerUnit)
+{
+    return segment(width, height, [=](size_t i) { return (float)depth[i] * metersPerUnit; });
+}
+
+const std::vector<uint8_t>& BackgroundModel::segment(const Point* points, int width, int height)
+{
+    return segment(width, height, [=](size_t i) { return points[i].Depth; });
+}
+
+float BackgroundModel::getRegionRatio() const
+{
+    if (m_Width == 0 || m_Height == 0)
+        return 1.0f;
+
+    return (float)m_Region.Width * m_Region.Height / ((float)m_Width * m_Height);
+}
@@ -0,0 +1,104 @@
+#pragma once
+#include <cstdint>
+#include <vector>
+
+#include "Point.h"
+
+/// <summary>
+/// Per pixel background depth of a static room, learned while nobody is moving in front of the camera (e.g. during the countdown).
+/// Every following frame is split into a subject mask and the region of interest around it, so recording, rendering and skeleton
+/// detection only have to handle the part of the frame the subject occupies.
+/// The background is the farthest depth seen at every pixel, so a subject walking through the scene while learning does not end up in it.
+/// </summary>
+class BackgroundModel
+{
+public:
+	struct Parameters
+	{
+		float Threshold{ 0.08f };			// Pixels closer than the background by more than this are foreground (in m)
+		float RelativeThreshold{ 0.02f };	// Added per meter of background depth, the noise grows with the distance
+		float MinValidRatio{ 0.5f };		// Pixels valid in fewer of the learned frames have no background
+		int MinLinePixels{ 8 };				// Rows and columns with fewer foreground pixels are ignored for the region of interest
+		int Margin{ 16 };					// Added around the region of interest (in px)
+	};
+
+	/// <summary>
+	/// Bounding box of the foreground in pixels, empty if there is no foreground
+	/// </summary>
+	struct Region
+	{
+		int X{ 0 };
+		int Y{ 0 };
+		int Width{ 0 };
+		int Height{ 0 };
+
+		bool empty() const { return Width <= 0 || Height <= 0; }
+	};
+
+	BackgroundModel() = default;
+	explicit BackgroundModel(Parameters params) : m_Params(params) { }
+
+	Parameters& getParameters() { return m_Params; }
+
+	/// <summary>
+	/// Drop the learned background and start learning from the next frame
+	/// </summary>
+	void startLearning();
+	/// <summary>
+	/// Add a frame to the background, ignored unless learning
+	/// </summary>
+	void learn(const uint16_t* depth, int width, int height, float metersPerUnit);
+	void learn(const Point* points, int width, int height);
+	/// <summary>
+	/// Freeze the background, pixels which were not valid often enough are marked as unknown
+	/// </summary>
+	void finishLearning();
+
+	bool isLearning() const { return m_Learning; }
+	bool isReady() const { return m_Ready; }
+	int getLearnedFrames() const { return m_LearnedFrames; }
+
+	/// <summary>
+	/// Split a frame into subject and background, pixels without a known background are foreground if they are valid
+	/// </summary>
+	/// <returns>Mask with 1 for foreground pixels, valid until the next call</returns>
+	const std::vector<uint8_t>& segment(const uint16_t* depth, int width, int height, float metersPerUnit);
+	const std::vector<uint8_t>& segment(const Point* points, int width, int height);
+
+	const std::vector<uint8_t>& getMask() const { return m_Mask; }
+	const Region& getRegion() const { return m_Region; }
+	/// <summary>
+	/// Fraction of the frame covered by the region of interest
+	/// </summary>
+	float getRegionRatio() const;
+private:
+	template<typename DepthAt>
+	void learn(int width, int height, DepthAt depthAt);
+	template<typename DepthAt>
+	const std::vector<uint8_t>& segment(int width, int height, DepthAt depthAt);
+
+	void resize(int width, int height);
+	/// <summary>
+	/// Remove the foreground pixels of all rows outside of [firstRow, lastRow)
+	/// </summary>
+	void clearOutside(int firstRow, int lastRow);
+
+	Parameters m_Params{ };
+
+	bool m_Learning{ false };
+	bool m_Ready{ false };
+	int m_LearnedFrames{ 0 };
+
+	int m_Width{ 0 };
+	int m_Height{ 0 };
+
+	std::vector<float> m_Background;	// In m, 0 where unknown
+	std::vector<uint16_t> m_ValidCount;
+	std::vector<int> m_Rows;
+
+	std::vector<uint8_t> m_Mask;
+	std::vector<int> m_RowCounts;
+	std::vector<int> m_ColumnCounts;
+	std::vector<std::vector<int>> m_BlockColumnCounts;
+	Region m_Region{ };
+};
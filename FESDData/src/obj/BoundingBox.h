@@ -1,4 +1,5 @@
 #pragma once
+#include <limits>
 #include <random>
 #include <glm/glm.hpp>
 
@@ -39,14 +40,37 @@ public:
 		return isUpdated;
 	}
 
-	glm::vec3 getMinPoint() {
-		return m_MinBoundingPoint;
+	inline void updateBox(const BoundingBox& other)
+	{
+		m_MinBoundingPoint = glm::min(m_MinBoundingPoint, other.m_MinBoundingPoint);
+		m_MaxBoundingPoint = glm::max(m_MaxBoundingPoint, other.m_MaxBoundingPoint);
+	}
+
+	/// <summary>
+	/// Empty box, the first point added becomes both corners
+	/// </summary>
+	inline void reset()
+	{
+		m_MinBoundingPoint = glm::vec3{ std::numeric_limits<float>::max() };
+		m_MaxBoundingPoint = glm::vec3{ std::numeric_limits<float>::lowest() };
+	}
+
+	bool isEmpty() const {
+		return m_MinBoundingPoint.x > m_MaxBoundingPoint.x;
+	}
+
+	glm::vec3 getMinPoint() const {
+		return isEmpty() ? glm::vec3{ 0.0f } : m_MinBoundingPoint;
+	}
+
+	glm::vec3 getMaxPoint() const {
+		return isEmpty() ? glm::vec3{ 0.0f } : m_MaxBoundingPoint;
 	}
 
-	glm::vec3 getMaxPoint() {
-		return m_MaxBoundingPoint;
+	glm::vec3 getSize() const {
+		return getMaxPoint() - getMinPoint();
 	}
 private:
-	glm::vec3 m_MinBoundingPoint{};
-	glm::vec3 m_MaxBoundingPoint{};
+	glm::vec3 m_MinBoundingPoint{ std::numeric_limits<float>::max() };
+	glm::vec3 m_MaxBoundingPoint{ std::numeric_limits<float>::lowest() };
 };
\ No newline at end of file
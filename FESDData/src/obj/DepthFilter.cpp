@@ -0,0 +1,290 @@
+#include "DepthFilter.h"
+
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <execution>
+#include <numeric>
+
+#include <imgui.h>
+
+#include "utilities/Profiler.h"
+
+namespace {
+constexpr int ColumnsPerBlock{ 128 };
+
+///
+/// Row kernels
+///
+
+void convertRow(const uint16_t* in, float* out, int n)
+{
+    for (int x = 0; x < n; x++)
+        out[x] = (float)in[x];
+}
+
+void storeRow(const float* in, uint16_t* out, int n)
+{
+    for (int x = 0; x < n; x++)
+        out[x] = (uint16_t)std::min(in[x] + 0.5f, 65535.0f);
+}
+
+/// <summary>
+/// Blend every pixel of a row with the pixel of the previous row unless one of them is invalid or they are on different sides of an edge
+/// </summary>
+void blendRows(float* row, const float* previous, int n, float alpha, float delta)
+{
+    for (int x = 0; x < n; x++) {
+        const float c = row[x], p = previous[x];
+        const bool blend = c > 0.0f && p > 0.0f && std::abs(c - p) < delta;
+        row[x] = blend ? alpha * c + (1.0f - alpha) * p : c;
+    }
+}
+
+/// <summary>
+/// Recursive filter along a row in both directions, the recursion restarts after invalid pixels and edges.
+/// Every pixel depends on its filtered neighbour, so the loop is sequential, it only selects instead of branching.
+/// </summary>
+void smoothRow(float* row, int n, float alpha, float delta)
+{
+    for (int x = 1; x < n; x++) {
+        const float c = row[x], p = row[x - 1];
+        const bool blend = c > 0.0f && p > 0.0f && std::abs(c - p) < delta;
+        row[x] = blend ? alpha * c + (1.0f - alpha) * p : c;
+    }
+
+    for (int x = n - 2; x >= 0; x--) {
+        const float c = row[x], p = row[x + 1];
+        const bool blend = c > 0.0f && p > 0.0f && std::abs(c - p) < delta;
+        row[x] = blend ? alpha * c + (1.0f - alpha) * p : c;
+    }
+}
+
+void temporalRow(float* row, float* history, uint8_t* valid, int n, float alpha, float delta, int persistence)
+{
+    for (int x = 0; x < n; x++) {
+        const float c = row[x], h = history[x];
+        const uint8_t mask = (uint8_t)((valid[x] << 1) | (c > 0.0f));
+
+        // Bit count of the validity mask
+        uint8_t count = mask - ((mask >> 1) & 0x55);
+        count = (count & 0x33) + ((count >> 2) & 0x33);
+        count = (count + (count >> 4)) & 0x0F;
+
+        const bool isValid = c > 0.0f;
+        const bool blend = isValid && h > 0.0f && std::abs(c - h) < delta;
+        const bool keep = !isValid && persistence > 0 && count >= persistence;
+
+        const float out = blend ? alpha * c + (1.0f - alpha) * h : (keep ? h : c);
+        row[x] = out;
+        history[x] = out;
+        valid[x] = mask;
+    }
+}
+
+/// <summary>
+/// Interpolate runs of invalid pixels between two valid neighbours of the same surface, a scalar scan as the holes are short and rare
+/// </summary>
+void fillRow(float* row, int n, int maxHole, float delta)
+{
+    int x = 0;
+    while (x < n) {
+        if (row[x] > 0.0f) {
+            x++;
+            continue;
+        }
+
+        const int start = x;
+        while (x < n && row[x] <= 0.0f)
+            x++;
+
+        const int length = x - start;
+        if (start == 0 || x == n || length > maxHole)
+            continue;
+
+        const float left = row[start - 1], right = row[x];
+        if (std::abs(left - right) > delta)
+            continue;
+
+        const float step = (right - left) / (float)(length + 1);
+        for (int i = 0; i < length; i++)
+            row[start + i] = left + step * (float)(i + 1);
+    }
+}
+}
+
+///
+/// Parameters
+///
+
+DepthFilter::Parameters::operator Json::Value() const
+{
+    Json::Value val;
+
+    val["Enabled"] = Enabled;
+    val["Spatial"] = Spatial;
+    val["Spatial Alpha"] = SpatialAlpha;
+    val["Spatial Delta"] = SpatialDelta;
+    val["Spatial Iterations"] = SpatialIterations;
+    val["Temporal"] = Temporal;
+    val["Temporal Alpha"] = TemporalAlpha;
+    val["Temporal Delta"] = TemporalDelta;
+    val["Persistence"] = Persistence;
+    val["Hole Filling"] = HoleFilling;
+    val["Max Hole Size"] = MaxHoleSize;
+    val["Hole Delta"] = HoleDelta;
+
+    return val;
+}
+
+DepthFilter::Parameters DepthFilter::Parameters::fromJson(const Json::Value& json)
+{
+    Parameters params;
+
+    params.Enabled = json.get("Enabled", params.Enabled).asBool();
+    params.Spatial = json.get("Spatial", params.Spatial).asBool();
+    params.SpatialAlpha = json.get("Spatial Alpha", params.SpatialAlpha).asFloat();
+    params.SpatialDelta = json.get("Spatial Delta", params.SpatialDelta).asFloat();
+    params.SpatialIterations = json.get("Spatial Iterations", params.SpatialIterations).asInt();
+    params.Temporal = json.get("Temporal", params.Temporal).asBool();
+    params.TemporalAlpha = json.get("Temporal Alpha", params.TemporalAlpha).asFloat();
+    params.TemporalDelta = json.get("Temporal Delta", params.TemporalDelta).asFloat();
+    params.Persistence = json.get("Persistence", params.Persistence).asInt();
+    params.HoleFilling = json.get("Hole Filling", params.HoleFilling).asBool();
+    params.MaxHoleSize = json.get("Max Hole Size", params.MaxHoleSize).asInt();
+    params.HoleDelta = json.get("Hole Delta", params.HoleDelta).asFloat();
+
+    return params;
+}
+
+///
+/// Filter
+///
+
+const uint16_t* DepthFilter::apply(const uint16_t* depth, int width, int height, float metersPerUnit)
+{
+    PROFILE_FUNCTION();
+    using clock = std::chrono::steady_clock;
+    const auto start = clock::now();
+
+    if (width != m_Width || height != m_Height) {
+        m_Width = width;
+        m_Height = height;
+
+        m_Frame.assign((size_t)width * height, 0.0f);
+        m_Output.assign((size_t)width * height, 0);
+
+        m_Rows.resize(height);
+        std::iota(m_Rows.begin(), m_Rows.end(), 0);
+        m_ColumnBlocks.resize((width + ColumnsPerBlock - 1) / ColumnsPerBlock);
+        std::iota(m_ColumnBlocks.begin(), m_ColumnBlocks.end(), 0);
+
+        reset();
+    }
+
+    std::for_each(std::execution::par, m_Rows.begin(), m_Rows.end(), [&](int y) {
+        convertRow(depth + (size_t)y * width, m_Frame.data() + (size_t)y * width, width);
+    });
+
+    // Thresholds in the units of the frame
+    const float unitsPerMeter = metersPerUnit > 0.0f ? 1.0f / metersPerUnit : 1000.0f;
+
+    if (m_Params.Spatial)
+        spatialFilter(m_Params.SpatialDelta * unitsPerMeter);
+
+    if (m_Params.Temporal)
+        temporalFilter(m_Params.TemporalDelta * unitsPerMeter);
+
+    if (m_Params.HoleFilling)
+        fillHoles(m_Params.HoleDelta * unitsPerMeter);
+
+    std::for_each(std::execution::par, m_Rows.begin(), m_Rows.end(), [&](int y) {
+        storeRow(m_Frame.data() + (size_t)y * width, m_Output.data() + (size_t)y * width, width);
+    });
+
+    m_Milliseconds = std::chrono::duration<float, std::milli>(clock::now() - start).count();
+    return m_Output.data();
+}
+
+void DepthFilter::reset()
+{
+    m_History.assign((size_t)m_Width * m_Height, 0.0f);
+    m_Valid.assign((size_t)m_Width * m_Height, 0);
+}
+
+void DepthFilter::spatialFilter(float deltaUnits)
+{
+    PROFILE_FUNCTION();
+    const float alpha = std::clamp(m_Params.SpatialAlpha, 0.0f, 1.0f);
+    float* frame = m_Frame.data();
+
+    for (int iteration = 0; iteration < m_Params.SpatialIterations; iteration++) {
+        // Horizontal, every row on its own
+        std::for_each(std::execution::par, m_Rows.begin(), m_Rows.end(), [&](int y) {
+            smoothRow(frame + (size_t)y * m_Width, m_Width, alpha, deltaUnits);
+        });
+
+        // Vertical, a whole strip of columns is blended with the row above (below) at once
+        std::for_each(std::execution::par, m_ColumnBlocks.begin(), m_ColumnBlocks.end(), [&](int block) {
+            const int x0 = block * ColumnsPerBlock;
+            const int n = std::min(ColumnsPerBlock, m_Width - x0);
+
+            for (int y = 1; y < m_Height; y++)
+                blendRows(frame + (size_t)y * m_Width + x0, frame + (size_t)(y - 1) * m_Width + x0, n, alpha, deltaUnits);
+
+            for (int y = m_Height - 2; y >= 0; y--)
+                blendRows(frame + (size_t)y * m_Width + x0, frame + (size_t)(y + 1) * m_Width + x0, n, alpha, deltaUnits);
+        });
+    }
+}
+
+void DepthFilter::temporalFilter(float deltaUnits)
+{
+    PROFILE_FUNCTION();
+    const float alpha = std::clamp(m_Params.TemporalAlpha, 0.0f, 1.0f);
+    const int persistence = std::clamp(m_Params.Persistence, 0, 8);
+
+    std::for_each(std::execution::par, m_Rows.begin(), m_Rows.end(), [&](int y) {
+        const size_t offset = (size_t)y * m_Width;
+        temporalRow(m_Frame.data() + offset, m_History.data() + offset, m_Valid.data() + offset, m_Width, alpha, deltaUnits, persistence);
+    });
+}
+
+void DepthFilter::fillHoles(float deltaUnits)
+{
+    PROFILE_FUNCTION();
+    std::for_each(std::execution::par, m_Rows.begin(), m_Rows.end(), [&](int y) {
+        fillRow(m_Frame.data() + (size_t)y * m_Width, m_Width, m_Params.MaxHoleSize, deltaUnits);
+    });
+}
+
+void DepthFilter::showSettings()
+{
+    if (!ImGui::TreeNode("Depth Filter"))
+        return;
+
+    if (ImGui::Checkbox("Enable Filter", &m_Params.Enabled))
+        reset();
+
+    ImGui::BeginDisabled(!m_Params.Enabled);
+
+    ImGui::Checkbox("Spatial", &m_Params.Spatial);
+    ImGui::SliderFloat("Spatial Alpha", &m_Params.SpatialAlpha, 0.05f, 1.0f, "%.2f");
+    ImGui::InputFloat("Spatial Delta (in m)", &m_Params.SpatialDelta, 0.005f, 0.01f, "%.3f");
+    ImGui::SliderInt("Spatial Iterations", &m_Params.SpatialIterations, 1, 5);
+
+    if (ImGui::Checkbox("Temporal", &m_Params.Temporal))
+        reset();
+    ImGui::SliderFloat("Temporal Alpha", &m_Params.TemporalAlpha, 0.05f, 1.0f, "%.2f");
+    ImGui::InputFloat("Temporal Delta (in m)", &m_Params.TemporalDelta, 0.005f, 0.01f, "%.3f");
+    ImGui::SliderInt("Persistence", &m_Params.Persistence, 0, 8);
+
+    ImGui::Checkbox("Hole Filling", &m_Params.HoleFilling);
+    ImGui::SliderInt("Max Hole Size", &m_Params.MaxHoleSize, 1, 16);
+    ImGui::InputFloat("Hole Delta (in m)", &m_Params.HoleDelta, 0.005f, 0.01f, "%.3f");
+
+    ImGui::Text("%.2f ms per frame", m_Milliseconds);
+
+    ImGui::EndDisabled();
+    ImGui::TreePop();
+}
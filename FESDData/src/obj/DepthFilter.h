@@ -0,0 +1,80 @@
+#pragma once
+#include <cstdint>
+#include <vector>
+
+#include <json/json.h>
+
+/// <summary>
+/// Depth post processing stage of one camera, applied between the capture and the consumers of the depth frame.
+/// Edge preserving spatial smoothing (recursive filter which does not blend across depth discontinuities), temporal exponential
+/// smoothing which keeps the last value of pixels that were valid often enough in the recent frames, and filling of short holes.
+/// The conversion, the vertical pass of the spatial filter and the temporal filter are branch free loops over whole rows the compiler can vectorise.
+/// The horizontal pass is recursive and the hole filling scans for runs, both are sequential within a row. Rows run in parallel and the buffers are reused between frames.
+/// </summary>
+class DepthFilter
+{
+public:
+	struct Parameters
+	{
+		bool Enabled{ false };
+
+		bool Spatial{ true };
+		float SpatialAlpha{ 0.5f };			// Weight of the current pixel, lower is smoother
+		float SpatialDelta{ 0.02f };		// Neighbours differing by more are an edge (in m)
+		int SpatialIterations{ 1 };
+
+		bool Temporal{ true };
+		float TemporalAlpha{ 0.4f };		// Weight of the current frame
+		float TemporalDelta{ 0.03f };		// Larger changes are motion and reset the history (in m)
+		int Persistence{ 3 };				// Invalid pixels keep their history if they were valid in this many of the last 8 frames, 0 disables
+
+		bool HoleFilling{ true };
+		int MaxHoleSize{ 4 };				// Longest horizontal run of invalid pixels that is filled
+		float HoleDelta{ 0.05f };			// Holes are only filled between neighbours of the same surface (in m)
+
+		explicit operator Json::Value() const;
+		/// <summary>
+		/// Parameters stored with a recording, missing values keep their default
+		/// </summary>
+		static Parameters fromJson(const Json::Value& json);
+	};
+
+	DepthFilter() = default;
+	explicit DepthFilter(Parameters params) : m_Params(params) { }
+
+	Parameters& getParameters() { return m_Params; }
+	bool isEnabled() const { return m_Params.Enabled; }
+
+	/// <summary>
+	/// Filter a depth frame, the temporal history is reset whenever the resolution changes
+	/// </summary>
+	/// <returns>Filtered frame, valid until the next call</returns>
+	const uint16_t* apply(const uint16_t* depth, int width, int height, float metersPerUnit);
+
+	/// <summary>
+	/// Forget the temporal history, e.g. after the camera was paused
+	/// </summary>
+	void reset();
+
+	float getMilliseconds() const { return m_Milliseconds; }
+
+	void showSettings();
+private:
+	void spatialFilter(float deltaUnits);
+	void temporalFilter(float deltaUnits);
+	void fillHoles(float deltaUnits);
+
+	Parameters m_Params{ };
+
+	int m_Width{ 0 };
+	int m_Height{ 0 };
+
+	std::vector<float> m_Frame;			// Working copy of the current frame
+	std::vector<float> m_History;		// Temporally smoothed depth
+	std::vector<uint8_t> m_Valid;		// One bit per frame, most recent in the lowest bit
+	std::vector<uint16_t> m_Output;
+	std::vector<int> m_Rows;
+	std::vector<int> m_ColumnBlocks;
+
+	float m_Milliseconds{ 0.0f };
+};
@@ -0,0 +1,162 @@
+#include "DepthStatistics.h"
+
+#include <algorithm>
+#include <execution>
+#include <format>
+#include <limits>
+#include <numeric>
+
+#include <imgui.h>
+
+#include "utilities/Profiler.h"
+
+namespace {
+constexpr int RowsPerBlock{ 16 };
+}
+
+std::string FrameStatistics::toCSV() const
+{
+    return std::format("{:.4f},{:.4f},{:.4f},{:.4f},{:.4f}", ValidRatio, MinDepth, MaxDepth, MeanDepth, SubjectDistance);
+}
+
+FrameStatistics::operator Json::Value() const
+{
+    Json::Value val;
+
+    val["Valid Ratio"] = ValidRatio;
+    val["Min Depth"] = MinDepth;
+    val["Max Depth"] = MaxDepth;
+    val["Mean Depth"] = MeanDepth;
+    val["Subject Distance"] = SubjectDistance;
+
+    Json::Value min, max;
+    const auto minPoint = Bounds.getMinPoint(), maxPoint = Bounds.getMaxPoint();
+    for (int axis = 0; axis < 3; axis++) {
+        min.append(minPoint[axis]);
+        max.append(maxPoint[axis]);
+    }
+    val["Min Point"] = min;
+    val["Max Point"] = max;
+
+    return val;
+}
+
+template<typename PointAt>
+const FrameStatistics& DepthStatistics::compute(int width, int height, const uint8_t* mask, PointAt pointAt)
+{
+    PROFILE_FUNCTION();
+    const int bins = std::max(1, m_Params.Bins);
+    const float binsPerMeter = (float)bins / std::max(m_Params.MaxDepth, 0.01f);
+
+    const int blocks = (height + RowsPerBlock - 1) / RowsPerBlock;
+    if (m_Blocks.size() != blocks) {
+        m_Blocks.resize(blocks);
+        std::iota(m_Blocks.begin(), m_Blocks.end(), 0);
+        m_Partials.resize(blocks);
+    }
+
+    // Without a mask the subject is assumed to stand in the centre third of the frame
+    const int x0 = width / 3, x1 = width - width / 3;
+    const int y0 = height / 3, y1 = height - height / 3;
+
+    std::for_each(std::execution::par, m_Blocks.begin(), m_Blocks.end(), [&](int block) {
+        auto& partial = m_Partials[block];
+        partial.Valid = 0;
+        partial.DepthSum = 0.0;
+        partial.Subject = 0;
+        partial.SubjectSum = 0.0;
+        partial.Bounds.reset();
+        partial.MinDepth = std::numeric_limits<float>::max();
+        partial.MaxDepth = 0.0f;
+        partial.Histogram.assign(bins, 0);
+
+        const int last = std::min(height, (block + 1) * RowsPerBlock);
+        for (int y = block * RowsPerBlock; y < last; y++) {
+            for (int x = 0; x < width; x++) {
+                const size_t i = (size_t)y * width + x;
+                const glm::vec3 p = pointAt(i, x, y);
+                if (p.z <= 0.0f)
+                    continue;
+
+                partial.Valid++;
+                partial.DepthSum += p.z;
+                partial.Bounds.updateBox(p);
+                partial.MinDepth = std::min(partial.MinDepth, p.z);
+                partial.MaxDepth = std::max(partial.MaxDepth, p.z);
+                partial.Histogram[std::min(bins - 1, (int)(p.z * binsPerMeter))]++;
+
+                const bool subject = mask ? mask[i] != 0 : (x >= x0 && x < x1 && y >= y0 && y < y1);
+                if (subject) {
+                    partial.Subject++;
+                    partial.SubjectSum += p.z;
+                }
+            }
+        }
+    });
+
+    FrameStatistics result;
+    result.Pixels = width * height;
+    result.Histogram.assign(bins, 0);
+
+    double depthSum = 0.0, subjectSum = 0.0;
+    float minDepth = std::numeric_limits<float>::max();
+    for (const auto& partial : m_Partials) {
+        result.ValidPixels += partial.Valid;
+        result.SubjectPixels += partial.Subject;
+        depthSum += partial.DepthSum;
+        subjectSum += partial.SubjectSum;
+        result.Bounds.updateBox(partial.Bounds);
+        minDepth = std::min(minDepth, partial.MinDepth);
+        result.MaxDepth = std::max(result.MaxDepth, partial.MaxDepth);
+
+        for (int bin = 0; bin < bins; bin++)
+            result.Histogram[bin] += partial.Histogram[bin];
+    }
+
+    if (result.ValidPixels > 0) {
+        result.MinDepth = minDepth;
+        result.MeanDepth = (float)(depthSum / result.ValidPixels);
+    }
+    if (result.SubjectPixels > 0)
+        result.SubjectDistance = (float)(subjectSum / result.SubjectPixels);
+    if (result.Pixels > 0)
+        result.ValidRatio = (float)result.ValidPixels / (float)result.Pixels;
+
+    m_Result = std::move(result);
+    return m_Result;
+}
+
+const FrameStatistics& DepthStatistics::compute(const Point* points, int width, int height, const uint8_t* mask)
+{
+    return compute(width, height, mask, [=](size_t i, int, int) { return points[i].getPoint(); });
+}
+
+const FrameStatistics& DepthStatistics::compute(const uint16_t* depth, int width, int height, float metersPerUnit, const glm::mat3& intrinsics, const uint8_t* mask)
+{
+    const float fx = intrinsics[0][0], fy = intrinsics[1][1];
+    const float cx = intrinsics[0][2], cy = intrinsics[1][2];
+
+    return compute(width, height, mask, [=](size_t i, int x, int y) {
+        const float d = (float)depth[i] * metersPerUnit;
+        return glm::vec3{ ((float)x - cx) / fx * d, ((float)y - cy) / fy * d, d };
+    });
+}
+
+void DepthStatistics::showStatistics()
+{
+    const auto& result = m_Result;
+
+    ImGui::Text("Valid Pixels: %.1f%%", 100.0f * result.ValidRatio);
+    ImGui::Text("Depth: %.2f m - %.2f m, mean %.2f m", result.MinDepth, result.MaxDepth, result.MeanDepth);
+    ImGui::Text("Subject Distance: %.2f m", result.SubjectDistance);
+
+    const auto size = result.Bounds.getSize();
+    ImGui::Text("Bounds: %.2f x %.2f x %.2f m", size.x, size.y, size.z);
+
+    if (!result.Histogram.empty()) {
+        std::vector<float> histogram(result.Histogram.begin(), result.Histogram.end());
+        const float max = *std::max_element(histogram.begin(), histogram.end());
+        auto overlay = std::format("0 - {:.1f} m", m_Params.MaxDepth);
+        ImGui::PlotHistogram("Depth Histogram", histogram.data(), (int)histogram.size(), 0, overlay.c_str(), 0.0f, max, ImVec2(0, 60.0f));
+    }
+}
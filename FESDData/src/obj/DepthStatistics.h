@@ -0,0 +1,96 @@
+#pragma once
+#include <cstdint>
+#include <string>
+#include <vector>
+
+#include <glm/glm.hpp>
+#include <json/json.h>
+
+#include "BoundingBox.h"
+#include "Point.h"
+
+/// <summary>
+/// Data quality of one depth frame
+/// </summary>
+struct FrameStatistics
+{
+	int Pixels{ 0 };
+	int ValidPixels{ 0 };
+	float ValidRatio{ 0.0f };
+
+	// Bounds of the valid points in camera space (in m)
+	BoundingBox Bounds{ };
+	float MinDepth{ 0.0f };
+	float MaxDepth{ 0.0f };
+	float MeanDepth{ 0.0f };
+
+	// Mean depth of the subject, the foreground mask if there is one and the centre of the frame otherwise (in m)
+	int SubjectPixels{ 0 };
+	float SubjectDistance{ 0.0f };
+
+	// Valid pixels per depth bin, see DepthStatistics::Parameters
+	std::vector<int> Histogram{ };
+
+	/// <summary>
+	/// Header and row of the per frame statistics written next to recordings
+	/// </summary>
+	static std::string getCSVHeader() { return "valid_ratio,min_depth,max_depth,mean_depth,subject_distance"; }
+	std::string toCSV() const;
+
+	explicit operator Json::Value() const;
+};
+
+/// <summary>
+/// Parallel reduction of a depth frame into its bounds, valid pixel ratio, histogram and the distance of the subject.
+/// Every block of rows is reduced on its own and the partial results are merged, the buffers are reused between frames.
+/// </summary>
+class DepthStatistics
+{
+public:
+	struct Parameters
+	{
+		int Bins{ 60 };
+		float MaxDepth{ 6.0f };		// Upper end of the last bin, farther points are counted in it (in m)
+	};
+
+	DepthStatistics() = default;
+	explicit DepthStatistics(Parameters params) : m_Params(params) { }
+
+	Parameters& getParameters() { return m_Params; }
+
+	/// <summary>
+	/// Statistics of the vertex data of one camera as produced by PointCloud::streamDepth
+	/// </summary>
+	/// <param name="mask">Optional foreground mask of the subject, e.g. from BackgroundModel::segment</param>
+	const FrameStatistics& compute(const Point* points, int width, int height, const uint8_t* mask = nullptr);
+	/// <summary>
+	/// Statistics of a raw depth image
+	/// </summary>
+	/// <param name="intrinsics">Camera matrix (fx, fy, cx, cy) as returned by DepthCamera::getIntrinsics</param>
+	const FrameStatistics& compute(const uint16_t* depth, int width, int height, float metersPerUnit, const glm::mat3& intrinsics, const uint8_t* mask = nullptr);
+
+	const FrameStatistics& getResult() const { return m_Result; }
+
+	void showStatistics();
+private:
+	struct Partial
+	{
+		int Valid{ 0 };
+		double DepthSum{ 0.0 };
+		int Subject{ 0 };
+		double SubjectSum{ 0.0 };
+		BoundingBox Bounds{ };
+		float MinDepth{ 0.0f };
+		float MaxDepth{ 0.0f };
+		std::vector<int> Histogram{ };
+	};
+
+	template<typename PointAt>
+	const FrameStatistics& compute(int width, int height, const uint8_t* mask, PointAt pointAt);
+
+	Parameters m_Params{ };
+
+	std::vector<int> m_Blocks;
+	std::vector<Partial> m_Partials;
+	FrameStatistics m_Result{ };
+};
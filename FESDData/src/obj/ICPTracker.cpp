@@ -0,0 +1,132 @@
+#include "ICPTracker.h"
+
+#include <chrono>
+#include <cmath>
+
+#include "utilities/Profiler.h"
+#include "utilities/RigidTransform.h"
+
+bool ICPTracker::getTargetNormal(const Point* target, int width, int height, int u, int v, glm::vec3& normal) const
+{
+    constexpr int Offset{ 2 };
+    if (u < Offset || v < Offset || u >= width - Offset || v >= height - Offset)
+        return false;
+
+    const int i = v * width + u;
+    const float z = target[i].Depth;
+    const float maxDepthChange = 0.05f * z;
+
+    const Point* neighbours[4]{ &target[i - Offset], &target[i + Offset], &target[i - Offset * width], &target[i + Offset * width] };
+    for (auto n : neighbours) {
+        if (n->Depth <= 0.0f || std::abs(n->Depth - z) > maxDepthChange)
+            return false;
+    }
+
+    normal = glm::cross(neighbours[1]->getPoint() - neighbours[0]->getPoint(), neighbours[3]->getPoint() - neighbours[2]->getPoint());
+    float length = glm::length(normal);
+    if (length <= 0.0f)
+        return false;
+
+    normal /= length;
+    if (glm::dot(normal, target[i].getPoint()) > 0.0f)
+        normal = -normal;
+
+    return true;
+}
+
+const ICPTracker::Result& ICPTracker::track(const Point* source, int sourceWidth, int sourceHeight,
+                                            const Point* target, int targetWidth, int targetHeight, const glm::vec4& targetIntrinsics,
+                                            glm::mat4& model)
+{
+    PROFILE_FUNCTION();
+    using clock = std::chrono::steady_clock;
+
+    const auto start = clock::now();
+    auto elapsedMs = [&start]() { return std::chrono::duration<float, std::milli>(clock::now() - start).count(); };
+
+    const float fx = targetIntrinsics.x, fy = targetIntrinsics.y, cx = targetIntrinsics.z, cy = targetIntrinsics.w;
+    const int stride = std::max(1, m_Params.SourceStride);
+    const float maxDistance2 = m_Params.MaxDistance * m_Params.MaxDistance;
+
+    m_Result = { };
+    glm::mat4 current = model;
+    float iterationMs = 0.0f;
+
+    for (int iteration = 0; iteration < m_Params.MaxIterations; iteration++) {
+        // Stop if another iteration would not fit, the next frame continues from here
+        const float iterationStart = elapsedMs();
+        if (iteration > 0 && iterationStart + iterationMs > m_Params.BudgetMs)
+            break;
+
+        RigidTransform::NormalEquations system{ };
+        double error = 0.0;
+        int inliers = 0;
+
+        for (int v = stride / 2; v < sourceHeight; v += stride) {
+            for (int u = stride / 2; u < sourceWidth; u += stride) {
+                const Point& s = source[v * sourceWidth + u];
+                if (s.Depth <= 0.0f)
+                    continue;
+
+                // Projective association
+                glm::vec3 p = glm::vec3(current * glm::vec4(s.getPoint(), 1.0f));
+                if (p.z <= 0.0f)
+                    continue;
+
+                int tu = (int)std::lround(p.x / p.z * fx + cx);
+                int tv = (int)std::lround(p.y / p.z * fy + cy);
+                if (tu < 0 || tv < 0 || tu >= targetWidth || tv >= targetHeight)
+                    continue;
+
+                const Point& t = target[tv * targetWidth + tu];
+                if (t.Depth <= 0.0f)
+                    continue;
+
+                glm::vec3 q = t.getPoint();
+                glm::vec3 d = p - q;
+                if (glm::dot(d, d) > maxDistance2)
+                    continue;
+
+                glm::vec3 n;
+                if (!getTargetNormal(target, targetWidth, targetHeight, tu, tv, n))
+                    continue;
+
+                // Linearised point-to-plane residual, J = [p x n, n]
+                double r = glm::dot(d, n);
+                glm::vec3 c = glm::cross(p, n);
+                const double J[6]{ c.x, c.y, c.z, n.x, n.y, n.z };
+                RigidTransform::accumulate(system, J, r);
+
+                error += r * r;
+                inliers++;
+            }
+        }
+
+        m_Result.Inliers = inliers;
+        m_Result.RMSE = inliers > 0 ? (float)std::sqrt(error / inliers) : 0.0f;
+
+        if (inliers < m_Params.MinInliers)
+            break;
+
+        std::array<double, 6> x{ };
+        if (!RigidTransform::solve(system, x))
+            break;
+
+        current = RigidTransform::fromUpdate(x) * current;
+        iterationMs = elapsedMs() - iterationStart;
+        m_Result.Iterations = iteration + 1;
+        m_Result.Updated = true;
+
+        auto [rotation, translation] = RigidTransform::getUpdateSize(x);
+        if (rotation < m_Params.ConvergenceEpsilon && translation < m_Params.ConvergenceEpsilon) {
+            m_Result.Converged = true;
+            break;
+        }
+    }
+
+    if (m_Result.Updated)
+        model = current;
+
+    m_Result.Milliseconds = elapsedMs();
+    return m_Result;
+}
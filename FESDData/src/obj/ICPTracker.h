@@ -0,0 +1,55 @@
+#pragma once
+#include <glm/glm.hpp>
+
+#include "Point.h"
+
+/// <summary>
+/// Online point-to-plane ICP keeping the extrinsics of a camera locked while streaming.
+/// A sparse grid of source pixels is matched by projecting it into the organized target image, so no search tree has to be built.
+/// Every call warm starts from the given model, stops once the update is below the convergence threshold and never runs past its time budget.
+/// </summary>
+class ICPTracker
+{
+public:
+	struct Parameters
+	{
+		int SourceStride{ 8 };				// Use every n-th pixel of every n-th row of the source
+		int MaxIterations{ 5 };
+		float MaxDistance{ 0.05f };			// Correspondences further apart are rejected (in m)
+		float ConvergenceEpsilon{ 1e-5f };	// Rotation (rad) and translation (m) update below which ICP stops
+		float BudgetMs{ 2.0f };
+		int MinInliers{ 50 };
+	};
+
+	struct Result
+	{
+		int Iterations{ 0 };
+		int Inliers{ 0 };
+		float RMSE{ 0.0f };
+		float Milliseconds{ 0.0f };
+		bool Converged{ false };
+		bool Updated{ false };
+	};
+
+	ICPTracker() = default;
+	explicit ICPTracker(Parameters params) : m_Params(params) { }
+
+	Parameters& getParameters() { return m_Params; }
+	const Result& getResult() const { return m_Result; }
+
+	/// <summary>
+	/// Refine the model matrix moving the source camera into the frame of the target camera
+	/// </summary>
+	/// <param name="targetIntrinsics">fx, fy, cx, cy of the target camera</param>
+	const Result& track(const Point* source, int sourceWidth, int sourceHeight,
+						const Point* target, int targetWidth, int targetHeight, const glm::vec4& targetIntrinsics,
+						glm::mat4& model);
+private:
+	/// <summary>
+	/// Normal of a target pixel from its neighbours, pointing towards the camera
+	/// </summary>
+	bool getTargetNormal(const Point* target, int width, int height, int u, int v, glm::vec3& normal) const;
+
+	Parameters m_Params{ };
+	Result m_Result{ };
+};
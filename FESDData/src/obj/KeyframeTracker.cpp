@@ -0,0 +1,320 @@
+#include "KeyframeTracker.h"
+
+#include <algorithm>
+#include <cmath>
+
+#include "utilities/Profiler.h"
+
+namespace {
+const cv::Size ThumbnailSize{ 80, 60 };
+}
+
+///
+/// Keyframe Scheduler
+///
+
+bool KeyframeScheduler::update(const cv::Mat& frame)
+{
+    PROFILE_FUNCTION();
+    m_Frames++;
+
+    if (frame.empty())
+        return false;
+
+    cv::resize(frame, m_Thumbnail, ThumbnailSize, 0.0, 0.0, cv::INTER_AREA);
+    if (m_Thumbnail.channels() == 3)
+        cv::cvtColor(m_Thumbnail, m_Thumbnail, cv::COLOR_RGB2GRAY);
+
+    bool keyframe = m_KeyThumbnail.empty() || ++m_SinceKeyframe >= std::max(1, m_Params.Stride);
+
+    if (!keyframe && m_Params.MotionTriggered && m_SinceKeyframe >= m_Params.MinStride) {
+        const double motion = cv::norm(m_Thumbnail, m_KeyThumbnail, cv::NORM_L1) / (double)m_Thumbnail.total();
+        keyframe = motion > m_Params.MotionThreshold;
+    }
+
+    if (keyframe) {
+        m_Thumbnail.copyTo(m_KeyThumbnail);
+        m_SinceKeyframe = 0;
+        m_Keyframes++;
+    }
+
+    return keyframe;
+}
+
+void KeyframeScheduler::reset()
+{
+    m_KeyThumbnail = cv::Mat{ };
+    m_SinceKeyframe = 0;
+    m_Keyframes = 0;
+    m_Frames = 0;
+}
+
+///
+/// Joint Tracker
+///
+
+void JointTracker::Axis::predict(float q)
+{
+    // x' = F x, P' = F P F^T + Q with F = [1 1; 0 1] and the noise of a random acceleration
+    Position += Velocity;
+
+    const float p00 = P[0][0] + P[0][1] + P[1][0] + P[1][1];
+    const float p01 = P[0][1] + P[1][1];
+    const float p10 = P[1][0] + P[1][1];
+    const float p11 = P[1][1];
+
+    P[0][0] = p00 + 0.25f * q;
+    P[0][1] = p01 + 0.5f * q;
+    P[1][0] = p10 + 0.5f * q;
+    P[1][1] = p11 + q;
+}
+
+void JointTracker::Axis::correct(float z, float r)
+{
+    // Only the position is measured
+    const float s = P[0][0] + r;
+    const float k0 = P[0][0] / s;
+    const float k1 = P[1][0] / s;
+    const float y = z - Position;
+
+    Position += k0 * y;
+    Velocity += k1 * y;
+
+    const float p00 = P[0][0], p01 = P[0][1];
+    P[0][0] = (1.0f - k0) * p00;
+    P[0][1] = (1.0f - k0) * p01;
+    P[1][0] -= k1 * p00;
+    P[1][1] -= k1 * p01;
+}
+
+std::string JointTracker::getSourceName(JointSource source)
+{
+    switch (source)
+    {
+    case JointSource::Detected:
+        return "detected";
+    case JointSource::Tracked:
+        return "tracked";
+    case JointSource::Refined:
+        return "refined";
+    }
+    return "unknown";
+}
+
+void JointTracker::toGray(const cv::Mat& frame, cv::Mat& gray) const
+{
+    if (frame.channels() == 3)
+        cv::cvtColor(frame, gray, cv::COLOR_RGB2GRAY);
+    else
+        frame.copyTo(gray);
+}
+
+std::vector<int> JointTracker::matchPeople(const Json::Value& people) const
+{
+    // OpenPose does not keep the order of the people, pair detections and tracked people greedily by their mean joint distance
+    struct Match
+    {
+        float Distance;
+        int Detection;
+        int Tracked;
+    };
+    std::vector<Match> candidates;
+
+    for (Json::ArrayIndex person = 0; person < people.size(); person++) {
+        const auto& skeleton = people[person]["Skeleton"];
+
+        for (size_t tracked = 0; tracked < m_Joints.size(); tracked++) {
+            float distance = 0.0f;
+            int count = 0;
+
+            for (Json::ArrayIndex part = 0; part < skeleton.size() && part < m_Joints[tracked].size(); part++) {
+                const auto& joint = m_Joints[tracked][part];
+                const float u = skeleton[part]["u"].asFloat();
+                const float v = skeleton[part]["v"].asFloat();
+                if (!joint.Valid || skeleton[part]["score"].asFloat() <= 0.0f || (u == 0.0f && v == 0.0f))
+                    continue;
+
+                distance += std::hypot(u - joint.U.Position, v - joint.V.Position);
+                count++;
+            }
+
+            if (count > 0 && distance / count <= m_Params.MaxMatchDistance)
+                candidates.push_back({ distance / count, (int)person, (int)tracked });
+        }
+    }
+
+    std::sort(candidates.begin(), candidates.end(), [](const Match& a, const Match& b) { return a.Distance < b.Distance; });
+
+    std::vector<int> matches(people.size(), -1);
+    std::vector<bool> taken(m_Joints.size(), false);
+    for (const auto& candidate : candidates) {
+        if (matches[candidate.Detection] != -1 || taken[candidate.Tracked])
+            continue;
+
+        matches[candidate.Detection] = candidate.Tracked;
+        taken[candidate.Tracked] = true;
+    }
+
+    return matches;
+}
+
+Json::Value JointTracker::reset(const Json::Value& people, const cv::Mat& frame)
+{
+    PROFILE_FUNCTION();
+    m_People = people;
+    m_FrameSize = frame.size();
+    toGray(frame, m_PreviousGray);
+
+    const auto matches = matchPeople(people);
+
+    std::vector<std::vector<Joint>> joints(people.size());
+    for (Json::ArrayIndex person = 0; person < people.size(); person++) {
+        const auto& skeleton = people[person]["Skeleton"];
+        const int previous = matches[person];
+        joints[person].resize(skeleton.size());
+
+        for (Json::ArrayIndex part = 0; part < skeleton.size(); part++) {
+            auto& joint = joints[person][part];
+            const float u = skeleton[part]["u"].asFloat();
+            const float v = skeleton[part]["v"].asFloat();
+            joint.Valid = skeleton[part]["score"].asFloat() > 0.0f && (u != 0.0f || v != 0.0f);
+
+            // The detection is taken as is, a joint of a matched person that was tracked before keeps its velocity estimate
+            const bool tracked = previous != -1 && part < m_Joints[previous].size() && m_Joints[previous][part].Valid;
+            if (joint.Valid && tracked) {
+                joint.U = m_Joints[previous][part].U;
+                joint.V = m_Joints[previous][part].V;
+                joint.U.predict(m_Params.ProcessNoise);
+                joint.V.predict(m_Params.ProcessNoise);
+                joint.U.correct(u, m_Params.MeasurementNoise);
+                joint.V.correct(v, m_Params.MeasurementNoise);
+            }
+            else {
+                joint.U.P[0][0] = joint.V.P[0][0] = m_Params.MeasurementNoise;
+                joint.U.P[1][1] = joint.V.P[1][1] = 10.0f * m_Params.ProcessNoise;
+            }
+            joint.U.Position = u;
+            joint.V.Position = v;
+            joint.Source = JointSource::Detected;
+        }
+    }
+    m_Joints = std::move(joints);
+
+    return toJson({ }, 0.0f);
+}
+
+Json::Value JointTracker::track(const cv::Mat& frame, const cv::Mat& depth, float metersPerUnit)
+{
+    PROFILE_FUNCTION();
+    if (frame.empty())
+        return toJson(depth, metersPerUnit);
+
+    cv::Mat gray;
+    toGray(frame, gray);
+
+    std::vector<cv::Point2f> previous, next;
+    std::vector<std::pair<int, int>> ids;
+    for (int person = 0; person < m_Joints.size(); person++) {
+        for (int part = 0; part < m_Joints[person].size(); part++) {
+            auto& joint = m_Joints[person][part];
+            if (!joint.Valid)
+                continue;
+
+            previous.emplace_back(joint.U.Position, joint.V.Position);
+            ids.emplace_back(person, part);
+
+            joint.U.predict(m_Params.ProcessNoise);
+            joint.V.predict(m_Params.ProcessNoise);
+            joint.Source = JointSource::Tracked;
+        }
+    }
+
+    const bool flow = m_Params.OpticalFlow && !previous.empty() && !m_PreviousGray.empty() && m_PreviousGray.size() == gray.size();
+    if (flow) {
+        std::vector<uchar> status;
+        std::vector<float> error;
+        cv::calcOpticalFlowPyrLK(m_PreviousGray, gray, previous, next, status, error, { 21, 21 }, 3);
+
+        for (size_t i = 0; i < ids.size(); i++) {
+            if (!status[i] || error[i] > m_Params.MaxFlowError)
+                continue;
+
+            auto& joint = m_Joints[ids[i].first][ids[i].second];
+            joint.U.correct(next[i].x, m_Params.MeasurementNoise);
+            joint.V.correct(next[i].y, m_Params.MeasurementNoise);
+            joint.Source = JointSource::Refined;
+        }
+    }
+
+    // Joints which left the image are lost until the next keyframe
+    for (auto& joints : m_Joints) {
+        for (auto& joint : joints) {
+            if (joint.Valid && (joint.U.Position < 0.0f || joint.V.Position < 0.0f || joint.U.Position >= gray.cols || joint.V.Position >= gray.rows))
+                joint.Valid = false;
+        }
+    }
+
+    m_PreviousGray = gray;
+    m_FrameSize = gray.size();
+
+    return toJson(depth, metersPerUnit);
+}
+
+float JointTracker::sampleDepth(const cv::Mat& depth, float u, float v, cv::Size frameSize, float metersPerUnit) const
+{
+    // The depth frame may have a different resolution than the color frame
+    const int x = (int)(u * depth.cols / frameSize.width);
+    const int y = (int)(v * depth.rows / frameSize.height);
+    const int w = m_Params.DepthWindow;
+
+    // Median of the valid pixels, robust against the background around the edges of the body
+    std::vector<uint16_t> samples;
+    for (int dy = -w; dy <= w; dy++) {
+        for (int dx = -w; dx <= w; dx++) {
+            const int sx = x + dx, sy = y + dy;
+            if (sx < 0 || sy < 0 || sx >= depth.cols || sy >= depth.rows)
+                continue;
+
+            const auto d = depth.at<uint16_t>(sy, sx);
+            if (d > 0)
+                samples.push_back(d);
+        }
+    }
+
+    if (samples.empty())
+        return 0.0f;
+
+    auto median = samples.begin() + samples.size() / 2;
+    std::nth_element(samples.begin(), median, samples.end());
+    return (float)*median * metersPerUnit;
+}
+
+Json::Value JointTracker::toJson(const cv::Mat& depth, float metersPerUnit) const
+{
+    Json::Value people = m_People;
+    for (Json::ArrayIndex person = 0; person < people.size(); person++) {
+        auto& skeleton = people[person]["Skeleton"];
+
+        for (Json::ArrayIndex part = 0; part < skeleton.size(); part++) {
+            const auto& joint = m_Joints[person][part];
+            auto& joint_json = skeleton[part];
+            joint_json["source"] = getSourceName(joint.Source);
+
+            if (joint.Source == JointSource::Detected)
+                continue;
+
+            joint_json["valid"] = joint.Valid;
+            if (!joint.Valid) {
+                joint_json["score"] = 0.0f;
+                continue;
+            }
+
+            joint_json["u"] = joint.U.Position;
+            joint_json["v"] = joint.V.Position;
+            if (!depth.empty())
+                joint_json["d"] = sampleDepth(depth, joint.U.Position, joint.V.Position, m_FrameSize, metersPerUnit);
+        }
+    }
+
+    return people;
+}
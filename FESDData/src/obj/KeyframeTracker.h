@@ -0,0 +1,123 @@
+#pragma once
+#include <string>
+#include <vector>
+
+#include <opencv2/opencv.hpp>
+#include <json/json.h>
+
+/// <summary>
+/// Where the position of a joint in a frame comes from
+/// </summary>
+enum class JointSource
+{
+	Detected,	// Full skeleton detector on a keyframe
+	Tracked,	// Kalman prediction only, the optical flow was lost
+	Refined		// Kalman prediction corrected by the optical flow of the joint
+};
+
+/// <summary>
+/// Decides on which frames the full skeleton detector runs, every Stride-th frame and additionally whenever the image changed
+/// noticeably since the last keyframe
+/// </summary>
+class KeyframeScheduler
+{
+public:
+	struct Parameters
+	{
+		int Stride{ 10 };
+		bool MotionTriggered{ true };
+		float MotionThreshold{ 6.0f };	// Mean absolute grey value difference to the last keyframe on a thumbnail
+		int MinStride{ 2 };				// Motion does not trigger keyframes closer than this
+	};
+
+	KeyframeScheduler() = default;
+	explicit KeyframeScheduler(Parameters params) : m_Params(params) { }
+
+	Parameters& getParameters() { return m_Params; }
+
+	/// <summary>
+	/// Feed the next frame
+	/// </summary>
+	/// <returns>True if the detector should run on this frame</returns>
+	bool update(const cv::Mat& frame);
+	void reset();
+
+	int getKeyframes() const { return m_Keyframes; }
+	int getFrames() const { return m_Frames; }
+private:
+	Parameters m_Params{ };
+
+	cv::Mat m_KeyThumbnail{ };
+	cv::Mat m_Thumbnail{ };
+	int m_SinceKeyframe{ 0 };
+	int m_Keyframes{ 0 };
+	int m_Frames{ 0 };
+};
+
+/// <summary>
+/// Propagates the joints of the last keyframe detection through the following frames.
+/// Every joint has a constant velocity Kalman filter per image axis, the prediction is corrected by the pyramidal Lucas-Kanade
+/// flow of the joint and the depth is sampled around the new position. The skeletons use the format of SkeletonDetectorOpenPose,
+/// every joint is tagged with its source.
+/// </summary>
+class JointTracker
+{
+public:
+	struct Parameters
+	{
+		float ProcessNoise{ 4.0f };			// Acceleration noise (in px^2 per frame^2)
+		float MeasurementNoise{ 4.0f };		// Noise of the optical flow (in px^2)
+		bool OpticalFlow{ true };
+		float MaxFlowError{ 20.0f };		// Flow with a larger error is ignored
+		float MaxMatchDistance{ 50.0f };	// Mean joint distance up to which a detection is the same person as a tracked one (in px)
+		int DepthWindow{ 2 };				// Half size of the window the depth of a joint is sampled in (in px)
+	};
+
+	JointTracker() = default;
+	explicit JointTracker(Parameters params) : m_Params(params) { }
+
+	Parameters& getParameters() { return m_Params; }
+
+	/// <summary>
+	/// Take over the skeletons of a keyframe, joints of a person that was tracked before keep their velocity
+	/// </summary>
+	/// <returns>The skeletons with every joint tagged as detected</returns>
+	Json::Value reset(const Json::Value& people, const cv::Mat& frame);
+	/// <summary>
+	/// Propagate the joints into the next frame
+	/// </summary>
+	/// <param name="depth">Optional depth frame (CV_16UC1), the depth of every joint is added in m</param>
+	Json::Value track(const cv::Mat& frame, const cv::Mat& depth = { }, float metersPerUnit = 0.001f);
+
+	static std::string getSourceName(JointSource source);
+private:
+	struct Axis
+	{
+		float Position{ 0.0f };
+		float Velocity{ 0.0f };
+		float P[2][2]{ { 0.0f, 0.0f }, { 0.0f, 0.0f } };
+
+		void predict(float q);
+		void correct(float z, float r);
+	};
+
+	struct Joint
+	{
+		Axis U{ };
+		Axis V{ };
+		bool Valid{ false };
+		JointSource Source{ JointSource::Detected };
+	};
+
+	void toGray(const cv::Mat& frame, cv::Mat& gray) const;
+	std::vector<int> matchPeople(const Json::Value& people) const;
+	float sampleDepth(const cv::Mat& depth, float u, float v, cv::Size frameSize, float metersPerUnit) const;
+	Json::Value toJson(const cv::Mat& depth, float metersPerUnit) const;
+
+	Parameters m_Params{ };
+
+	Json::Value m_People{ };
+	std::vector<std::vector<Joint>> m_Joints{ };	// Per person per joint
+	cv::Mat m_PreviousGray{ };
+	cv::Size m_FrameSize{ };
+};
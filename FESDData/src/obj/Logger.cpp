@@ -0,0 +1,295 @@
+#include "Logger.h"
+
+#include <algorithm>
+#include <chrono>
+#include <ctime>
+#include <iostream>
+
+#include <imgui.h>
+
+namespace Logger {
+namespace {
+std::atomic<uint32_t> s_NextThreadId{ 0 };
+thread_local uint32_t t_ThreadId{ s_NextThreadId.fetch_add(1, std::memory_order_relaxed) };
+
+const char* getPriorityName(Priority prio)
+{
+    switch (prio)
+    {
+    case Priority::WARN:
+        return "[WARN] ";
+    case Priority::ERR:
+        return "[ERROR] ";
+    default:
+        return "[INFO] ";
+    }
+}
+}
+
+#pragma warning(disable : 4996)
+std::string Entry::toString() const
+{
+    auto time = std::chrono::system_clock::to_time_t(std::chrono::system_clock::time_point{ std::chrono::duration_cast<std::chrono::system_clock::duration>(std::chrono::nanoseconds{ Timestamp }) });
+
+    // Entries are formatted on the writer and the UI thread at the same time, std::localtime shares one buffer between them
+    std::tm localTime{ };
+    localtime_s(&localTime, &time);
+
+    char timeString[32];
+    std::strftime(timeString, sizeof(timeString), "%a %b %d %H:%M:%S %Y", &localTime);
+
+    std::string entry = timeString;
+    entry += " - ";
+    entry += getPriorityName(Prio);
+    entry += getMessage();
+
+    return entry;
+}
+
+/// 
+/// Constructors & Destructors
+/// 
+
+Logger::Logger(std::filesystem::path logFile, size_t maxFileSize, int maxFiles) :
+    m_Queue(QueueCapacity), m_LogFilePath(logFile), m_MaxFileSize(maxFileSize), m_MaxFiles(maxFiles), m_History(HistoryCapacity)
+{
+    static_assert((QueueCapacity & (QueueCapacity - 1)) == 0, "QueueCapacity has to be a power of two");
+
+    for (size_t i = 0; i < QueueCapacity; i++)
+        m_Queue[i].Sequence.store(i, std::memory_order_relaxed);
+
+    openLogFile();
+
+    m_SinkThread = std::thread(&Logger::runSink, this);
+}
+
+Logger::~Logger()
+{
+    m_Running.store(false, std::memory_order_release);
+    if (m_SinkThread.joinable())
+        m_SinkThread.join();
+}
+
+/// 
+/// Logging
+/// 
+
+void Logger::log(std::string_view msg, Priority prio)
+{
+    if (prio < m_MinPriority.load(std::memory_order_relaxed))
+        return;
+
+    Entry entry;
+    entry.Timestamp = std::chrono::duration_cast<std::chrono::nanoseconds>(std::chrono::system_clock::now().time_since_epoch()).count();
+    entry.Prio = prio;
+    entry.ThreadId = t_ThreadId;
+    entry.Length = (uint32_t)std::min(msg.size(), Entry::MaxMessageLength);
+    std::copy_n(msg.data(), entry.Length, entry.Message.data());
+
+    if (!tryPush(entry))
+        m_Dropped.fetch_add(1, std::memory_order_relaxed);
+}
+
+bool Logger::tryPush(const Entry& entry)
+{
+    Cell* cell;
+    size_t pos = m_EnqueuePos.load(std::memory_order_relaxed);
+
+    for (;;) {
+        cell = &m_Queue[pos & (QueueCapacity - 1)];
+        size_t seq = cell->Sequence.load(std::memory_order_acquire);
+        auto diff = (intptr_t)seq - (intptr_t)pos;
+
+        if (diff == 0) {
+            if (m_EnqueuePos.compare_exchange_weak(pos, pos + 1, std::memory_order_relaxed))
+                break;
+        }
+        else if (diff < 0) {
+            // Queue is full
+            return false;
+        }
+        else {
+            pos = m_EnqueuePos.load(std::memory_order_relaxed);
+        }
+    }
+
+    cell->Data = entry;
+    cell->Sequence.store(pos + 1, std::memory_order_release);
+
+    return true;
+}
+
+bool Logger::tryPop(Entry& entry)
+{
+    auto& cell = m_Queue[m_DequeuePos & (QueueCapacity - 1)];
+    if (cell.Sequence.load(std::memory_order_acquire) != m_DequeuePos + 1)
+        return false;
+
+    entry = cell.Data;
+    cell.Sequence.store(m_DequeuePos + QueueCapacity, std::memory_order_release);
+    m_DequeuePos++;
+
+    return true;
+}
+
+/// 
+/// Sink
+/// 
+
+void Logger::runSink()
+{
+    Entry entry;
+
+    for (;;) {
+        bool running = m_Running.load(std::memory_order_acquire);
+        bool wrote = false;
+
+        while (tryPop(entry)) {
+            writeEntry(entry);
+            wrote = true;
+        }
+
+        if (auto dropped = m_Dropped.exchange(0, std::memory_order_relaxed); dropped > 0) {
+            Entry warning;
+            warning.Timestamp = std::chrono::duration_cast<std::chrono::nanoseconds>(std::chrono::system_clock::now().time_since_epoch()).count();
+            warning.Prio = Priority::WARN;
+            auto msg = "Log queue full, dropped " + std::to_string(dropped) + " entries";
+            warning.Length = (uint32_t)std::min(msg.size(), Entry::MaxMessageLength);
+            std::copy_n(msg.data(), warning.Length, warning.Message.data());
+            writeEntry(warning);
+            wrote = true;
+        }
+
+        if (wrote) {
+            std::cout.flush();
+            if (m_LogFile.is_open())
+                m_LogFile.flush();
+        }
+        else if (!running) {
+            return;
+        }
+        else {
+            std::this_thread::sleep_for(std::chrono::milliseconds(2));
+        }
+    }
+}
+
+void Logger::writeEntry(const Entry& entry)
+{
+    auto line = entry.toString();
+    line += '\n';
+
+    std::cout << line;
+
+    if (m_LogFile.is_open()) {
+        m_LogFile << line;
+        m_FileSize += line.size();
+
+        if (m_FileSize > m_MaxFileSize)
+            rotateLogFile();
+    }
+
+    std::lock_guard<std::mutex> lock(m_HistoryMutex);
+    m_History[m_HistoryHead] = entry;
+    m_HistoryHead = (m_HistoryHead + 1) % HistoryCapacity;
+    m_HistorySize = std::min(m_HistorySize + 1, HistoryCapacity);
+}
+
+void Logger::openLogFile()
+{
+    std::error_code ec;
+    if (m_LogFilePath.has_parent_path())
+        std::filesystem::create_directories(m_LogFilePath.parent_path(), ec);
+
+    m_LogFile.open(m_LogFilePath, std::ios::out | std::ios::app);
+    m_FileSize = std::filesystem::exists(m_LogFilePath, ec) ? std::filesystem::file_size(m_LogFilePath, ec) : 0;
+
+    if (!m_LogFile.is_open())
+        std::cout << "Could not open log file '" << m_LogFilePath.string() << "', logging to console only" << std::endl;
+}
+
+void Logger::rotateLogFile()
+{
+    m_LogFile.close();
+
+    // FESD.log -> FESD.1.log -> FESD.2.log ..., the oldest file is removed
+    auto rotatedPath = [this](int i) {
+        auto path = m_LogFilePath;
+        return path.replace_extension(std::to_string(i) + m_LogFilePath.extension().string());
+    };
+
+    std::error_code ec;
+    std::filesystem::remove(rotatedPath(m_MaxFiles), ec);
+    for (int i = m_MaxFiles - 1; i >= 1; i--)
+        std::filesystem::rename(rotatedPath(i), rotatedPath(i + 1), ec);
+    std::filesystem::rename(m_LogFilePath, rotatedPath(1), ec);
+
+    m_LogFile.open(m_LogFilePath, std::ios::out | std::ios::trunc);
+    m_FileSize = 0;
+}
+
+/// 
+/// ImGui
+/// 
+
+void Logger::showLog()
+{
+    ImGui::Begin("Log");
+
+    ImGui::Checkbox("Info", &m_ShowInfo);
+    ImGui::SameLine();
+    ImGui::Checkbox("Warnings", &m_ShowWarn);
+    ImGui::SameLine();
+    ImGui::Checkbox("Errors", &m_ShowErr);
+    ImGui::SameLine();
+
+    const char* priorities[] = { "Info", "Warn", "Error" };
+    int minPriority = (int)getMinPriority();
+    ImGui::SetNextItemWidth(100.0f);
+    if (ImGui::Combo("Minimum Priority", &minPriority, priorities, IM_ARRAYSIZE(priorities)))
+        setMinPriority((Priority)minPriority);
+
+    ImGui::Separator();
+    ImGui::BeginChild("Entries");
+
+    {
+        // The sink waits while the visible rows are drawn
+        std::lock_guard<std::mutex> lock(m_HistoryMutex);
+
+        m_VisibleEntries.clear();
+        for (size_t i = 0; i < m_HistorySize; i++) {
+            // Newest first
+            size_t index = (m_HistoryHead + HistoryCapacity - 1 - i) % HistoryCapacity;
+            auto prio = m_History[index].Prio;
+
+            if ((prio == Priority::INFO && m_ShowInfo) ||
+                (prio == Priority::WARN && m_ShowWarn) ||
+                (prio == Priority::ERR && m_ShowErr)) {
+                m_VisibleEntries.push_back(index);
+            }
+        }
+
+        ImGuiListClipper clipper;
+        clipper.Begin((int)m_VisibleEntries.size());
+        while (clipper.Step()) {
+            for (int row = clipper.DisplayStart; row < clipper.DisplayEnd; row++) {
+                const auto& entry = m_History[m_VisibleEntries[row]];
+                auto text = entry.toString();
+
+                if (entry.Prio == Priority::ERR)
+                    ImGui::PushStyleColor(ImGuiCol_Text, ImVec4(1.0f, 0.4f, 0.4f, 1.0f));
+                else if (entry.Prio == Priority::WARN)
+                    ImGui::PushStyleColor(ImGuiCol_Text, ImVec4(1.0f, 0.8f, 0.3f, 1.0f));
+
+                ImGui::TextUnformatted(text.c_str(), text.c_str() + text.size());
+
+                if (entry.Prio != Priority::INFO)
+                    ImGui::PopStyleColor();
+            }
+        }
+    }
+
+    ImGui::EndChild();
+    ImGui::End();
+}
+}
@@ -1,8 +1,14 @@
 #pragma once
+#include <array>
+#include <atomic>
+#include <cstdint>
+#include <filesystem>
+#include <fstream>
+#include <mutex>
 #include <string>
-#include <chrono>
-#include <imgui.h>
-#include <iostream>
+#include <string_view>
+#include <thread>
+#include <vector>
 
 namespace Logger {
 enum class Priority
@@ -12,45 +18,91 @@ enum class Priority
 	ERR
 };
 
+/// Fixed size log entry, longer messages are truncated
+struct Entry
+{
+	static constexpr size_t MaxMessageLength{ 232 };
+
+	int64_t Timestamp{ 0 };	// Nanoseconds since epoch (system clock)
+	Priority Prio{ Priority::INFO };
+	uint32_t ThreadId{ 0 };
+	uint32_t Length{ 0 };
+	std::array<char, MaxMessageLength> Message{ };
+
+	std::string_view getMessage() const { return { Message.data(), Length }; }
+	std::string toString() const;
+};
+
+/// <summary>
+/// Asynchronous logger, log() only copies the message into a lock-free queue.
+/// A background thread writes the entries to the console and to a rotating log file and keeps the history shown in the Log window.
+/// If the queue is full the entry is dropped and counted instead of blocking the caller.
+/// </summary>
 class Logger {
 public:
-	#pragma warning(disable : 4996)
-	void log(std::string msg, Priority prio = Priority::INFO) {
-		std::string entry = "";
-		auto now = std::chrono::system_clock::to_time_t(std::chrono::system_clock::now());
-		entry += ctime(&now);
-		entry.at(entry.size() - 1) = ' ';
-		entry += "- ";
-
-		if (prio == Priority::INFO) {
-			entry += "[INFO] ";
-		}
-		else if (prio == Priority::WARN) {
-			entry += "[WARN] ";
-		}
-		else if (prio == Priority::ERR) {
-			entry += "[ERROR] ";
-		}
-
-		entry += msg;
-		entry += "\n";
-
-		std::cout << entry;
-
-		m_Log = entry + m_Log;
-
-		if (m_Log.size() > m_MaxLogLength) {
-			m_Log.resize(9000);
-		}
-	}
-
-	void showLog() {
-		ImGui::Begin("Log");
-		ImGui::Text(m_Log.c_str());
-		ImGui::End();
-	}
+	Logger(std::filesystem::path logFile = "logs/FESD.log", size_t maxFileSize = 5 * 1024 * 1024, int maxFiles = 3);
+	~Logger();
+
+	Logger(const Logger&) = delete;
+	Logger& operator=(const Logger&) = delete;
+
+	/// <summary>
+	/// Enqueue a message, can be called from any thread
+	/// </summary>
+	void log(std::string_view msg, Priority prio = Priority::INFO);
+
+	/// <summary>
+	/// Entries below this priority are discarded before they are enqueued
+	/// </summary>
+	void setMinPriority(Priority prio) { m_MinPriority.store(prio, std::memory_order_relaxed); }
+	Priority getMinPriority() const { return m_MinPriority.load(std::memory_order_relaxed); }
+
+	void showLog();
 private:
-	std::string m_Log{ "" };
-	const int m_MaxLogLength{ 10000 };
+	/// Bounded multi-producer queue, every cell carries a sequence number telling producers and the consumer whose turn it is
+	struct Cell
+	{
+		std::atomic<size_t> Sequence{ 0 };
+		Entry Data{ };
+	};
+
+	static constexpr size_t QueueCapacity{ 4096 };
+	static constexpr size_t HistoryCapacity{ 2048 };
+
+	bool tryPush(const Entry& entry);
+	bool tryPop(Entry& entry);
+
+	void runSink();
+	void writeEntry(const Entry& entry);
+	void openLogFile();
+	void rotateLogFile();
+
+	// Queue
+	std::vector<Cell> m_Queue;
+	alignas(64) std::atomic<size_t> m_EnqueuePos{ 0 };
+	alignas(64) size_t m_DequeuePos{ 0 };
+	std::atomic<uint64_t> m_Dropped{ 0 };
+	std::atomic<Priority> m_MinPriority{ Priority::INFO };
+
+	// Sink
+	std::atomic<bool> m_Running{ true };
+	std::thread m_SinkThread;
+	std::ofstream m_LogFile;
+	std::filesystem::path m_LogFilePath;
+	size_t m_MaxFileSize;
+	int m_MaxFiles;
+	size_t m_FileSize{ 0 };
+
+	// History shown in the Log window, newest entry at m_HistoryHead - 1
+	std::mutex m_HistoryMutex;
+	std::vector<Entry> m_History;
+	size_t m_HistoryHead{ 0 };
+	size_t m_HistorySize{ 0 };
+
+	// Log window
+	bool m_ShowInfo{ true };
+	bool m_ShowWarn{ true };
+	bool m_ShowErr{ true };
+	std::vector<size_t> m_VisibleEntries;
 };
-}
\ No newline at end of file
+}
@@ -0,0 +1,303 @@
+#include "NDTAligner.h"
+
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <cstring>
+#include <execution>
+#include <numeric>
+
+#include "utilities/Profiler.h"
+#include "utilities/RigidTransform.h"
+
+namespace {
+constexpr int PointsPerBlock{ 4096 };
+
+/// <summary>
+/// Upper triangular W with W^T * W = A for a symmetric positive definite A
+/// </summary>
+bool getWhitening(const glm::mat3& a, glm::mat3& w)
+{
+    // Cholesky A = L * L^T, glm is column major so a[col][row]
+    float l00 = a[0][0];
+    if (l00 <= 0.0f)
+        return false;
+    l00 = std::sqrt(l00);
+
+    float l10 = a[0][1] / l00;
+    float l20 = a[0][2] / l00;
+
+    float l11 = a[1][1] - l10 * l10;
+    if (l11 <= 0.0f)
+        return false;
+    l11 = std::sqrt(l11);
+
+    float l21 = (a[1][2] - l20 * l10) / l11;
+
+    float l22 = a[2][2] - l20 * l20 - l21 * l21;
+    if (l22 <= 0.0f)
+        return false;
+    l22 = std::sqrt(l22);
+
+    // W = L^T
+    w = glm::mat3{ 0.0f };
+    w[0][0] = l00; w[1][0] = l10; w[2][0] = l20;
+    w[1][1] = l11; w[2][1] = l21;
+    w[2][2] = l22;
+
+    return true;
+}
+}
+
+///
+/// Grid
+///
+
+uint64_t NDTAligner::Grid::getKey(const glm::vec3& p) const
+{
+    constexpr int64_t Bits{ 21 };
+    constexpr int64_t Offset{ (int64_t)1 << (Bits - 1) };
+    constexpr int64_t Mask{ ((int64_t)1 << Bits) - 1 };
+
+    auto x = ((int64_t)std::floor(p.x / Resolution) + Offset) & Mask;
+    auto y = ((int64_t)std::floor(p.y / Resolution) + Offset) & Mask;
+    auto z = ((int64_t)std::floor(p.z / Resolution) + Offset) & Mask;
+
+    return (uint64_t)(x << (2 * Bits) | y << Bits | z);
+}
+
+void NDTAligner::Grid::build(const std::vector<glm::vec3>& points, float resolution, int minPoints)
+{
+    PROFILE_FUNCTION();
+    Resolution = resolution;
+
+    // Sort the points by cell so every cell is a contiguous range
+    std::vector<std::pair<uint64_t, uint32_t>> keys(points.size());
+    std::vector<uint32_t> indices(points.size());
+    std::iota(indices.begin(), indices.end(), 0);
+
+    std::transform(std::execution::par, indices.begin(), indices.end(), keys.begin(), [&](uint32_t i) {
+        return std::make_pair(getKey(points[i]), i);
+    });
+    std::sort(std::execution::par, keys.begin(), keys.end());
+
+    std::vector<uint32_t> starts;
+    for (uint32_t i = 0; i < keys.size(); i++) {
+        if (i == 0 || keys[i].first != keys[i - 1].first)
+            starts.push_back(i);
+    }
+    starts.push_back((uint32_t)keys.size());
+
+    std::vector<Cell> cells(starts.size() - 1);
+    std::vector<uint8_t> valid(cells.size(), 0);
+    std::vector<uint32_t> ranges(cells.size());
+    std::iota(ranges.begin(), ranges.end(), 0);
+
+    std::for_each(std::execution::par, ranges.begin(), ranges.end(), [&](uint32_t c) {
+        const uint32_t first = starts[c], last = starts[c + 1];
+        const int n = (int)(last - first);
+        if (n < minPoints)
+            return;
+
+        glm::dvec3 mean{ 0.0 };
+        for (auto i = first; i < last; i++)
+            mean += glm::dvec3(points[keys[i].second]);
+        mean /= n;
+
+        glm::dmat3 covariance{ 0.0 };
+        for (auto i = first; i < last; i++) {
+            glm::dvec3 d = glm::dvec3(points[keys[i].second]) - mean;
+            covariance += glm::outerProduct(d, d);
+        }
+        covariance /= n - 1;
+
+        // Flat cells are singular, inflate all directions by a fraction of the spread
+        double regularisation = std::max(1e-8, 0.01 * (covariance[0][0] + covariance[1][1] + covariance[2][2]) / 3.0);
+        covariance += glm::dmat3{ regularisation };
+
+        Cell& cell = cells[c];
+        cell.Mean = glm::vec3(mean);
+        valid[c] = getWhitening(glm::mat3(glm::inverse(covariance)), cell.Whitening);
+    });
+
+    Cells.clear();
+    Lookup.clear();
+    Lookup.reserve(cells.size());
+
+    for (size_t c = 0; c < cells.size(); c++) {
+        if (!valid[c])
+            continue;
+
+        Lookup.emplace(keys[starts[c]].first, (uint32_t)Cells.size());
+        Cells.push_back(cells[c]);
+    }
+}
+
+int NDTAligner::Grid::findNeighbours(const glm::vec3& p, const Cell* cells[8]) const
+{
+    // Step towards the closer neighbour along every axis
+    glm::vec3 cell = p / Resolution;
+    glm::vec3 step = glm::sign(cell - glm::floor(cell) - 0.5f) * Resolution;
+
+    int count = 0;
+    for (int i = 0; i < 8; i++) {
+        glm::vec3 q{ i & 1 ? p.x + step.x : p.x, i & 2 ? p.y + step.y : p.y, i & 4 ? p.z + step.z : p.z };
+
+        auto found = Lookup.find(getKey(q));
+        if (found != Lookup.end())
+            cells[count++] = &Cells[found->second];
+    }
+
+    return count;
+}
+
+///
+/// Aligner
+///
+
+bool NDTAligner::isTargetValid(uint64_t hash) const
+{
+    if (!hasTarget() || hash != m_TargetHash || m_Grids.size() != m_Params.Resolutions.size())
+        return false;
+
+    for (size_t i = 0; i < m_Grids.size(); i++) {
+        if (m_Grids[i].Resolution != m_Params.Resolutions[i])
+            return false;
+    }
+
+    return true;
+}
+
+bool NDTAligner::setTarget(const std::vector<glm::vec3>& points, uint64_t hash)
+{
+    PROFILE_FUNCTION();
+
+    if (isTargetValid(hash))
+        return false;
+
+    m_Grids.resize(m_Params.Resolutions.size());
+    for (size_t i = 0; i < m_Grids.size(); i++)
+        m_Grids[i].build(points, m_Params.Resolutions[i], m_Params.MinPointsPerCell);
+
+    m_TargetHash = hash;
+    return true;
+}
+
+void NDTAligner::resetTarget()
+{
+    m_Grids.clear();
+    m_TargetHash = 0;
+}
+
+const NDTAligner::Result& NDTAligner::align(const std::vector<glm::vec3>& source, glm::mat4& transformation)
+{
+    PROFILE_FUNCTION();
+    using clock = std::chrono::steady_clock;
+    const auto start = clock::now();
+
+    m_Result = { };
+    if (!hasTarget() || source.empty())
+        return m_Result;
+
+    struct Partial
+    {
+        RigidTransform::NormalEquations System{ };
+        double Score{ 0.0 };
+    };
+
+    std::vector<uint32_t> blocks((source.size() + PointsPerBlock - 1) / PointsPerBlock);
+    std::iota(blocks.begin(), blocks.end(), 0);
+    std::vector<Partial> partials(blocks.size());
+
+    glm::mat4 current = transformation;
+
+    for (const auto& grid : m_Grids) {
+        m_Result.Converged = false;
+
+        // Coarse levels only need a fraction of the source points
+        const size_t stride = std::max<size_t>(1, (size_t)std::lround(grid.Resolution / m_Grids.back().Resolution));
+        const double used = (double)((source.size() + stride - 1) / stride);
+
+        for (int iteration = 0; iteration < m_Params.MaxIterations; iteration++) {
+            std::for_each(std::execution::par, blocks.begin(), blocks.end(), [&](uint32_t block) {
+                Partial& partial = partials[block];
+                partial = { };
+
+                const size_t last = std::min(source.size(), (size_t)(block + 1) * PointsPerBlock);
+                for (size_t i = (size_t)block * PointsPerBlock; i < last; i++) {
+                    if (i % stride != 0)
+                        continue;
+
+                    glm::vec3 p = glm::vec3(current * glm::vec4(source[i], 1.0f));
+
+                    // The cell of the point and the seven neighbours of its octant, smooths the jumps at cell borders
+                    const Cell* cells[8];
+                    int cellCount = grid.findNeighbours(p, cells);
+
+                    for (int n = 0; n < cellCount; n++) {
+                        const Cell* cell = cells[n];
+
+                        // Whitened residual, its squared norm is the Mahalanobis distance to the cell
+                        glm::vec3 e = cell->Whitening * (p - cell->Mean);
+                        double weight = std::exp(-0.5 * glm::dot(e, e));
+                        partial.Score += weight;
+
+                        if (weight < 1e-6)
+                            continue;
+
+                        for (int k = 0; k < 3; k++) {
+                            glm::vec3 w{ cell->Whitening[0][k], cell->Whitening[1][k], cell->Whitening[2][k] };
+                            glm::vec3 c = glm::cross(p, w);
+                            const double J[6]{ c.x, c.y, c.z, w.x, w.y, w.z };
+                            RigidTransform::accumulate(partial.System, J, e[k], weight);
+                        }
+                    }
+                }
+            });
+
+            RigidTransform::NormalEquations system{ };
+            double score = 0.0;
+            for (const auto& partial : partials) {
+                for (int row = 0; row < 6; row++)
+                    for (int col = 0; col < 7; col++)
+                        system[row][col] += partial.System[row][col];
+                score += partial.Score;
+            }
+
+            m_Result.Score = (float)(score / used);
+            m_Result.Iterations++;
+
+            std::array<double, 6> x{ };
+            if (!RigidTransform::solve(system, x))
+                break;
+
+            current = RigidTransform::fromUpdate(x) * current;
+
+            auto [rotation, translation] = RigidTransform::getUpdateSize(x);
+            if (rotation < m_Params.TransformationEpsilon && translation < m_Params.TransformationEpsilon) {
+                m_Result.Converged = true;
+                break;
+            }
+        }
+    }
+
+    transformation = current;
+    m_Result.Milliseconds = std::chrono::duration<float, std::milli>(clock::now() - start).count();
+
+    return m_Result;
+}
+
+uint64_t NDTAligner::hashFrame(const Point* points, int count)
+{
+    // FNV-1a over the depth values
+    uint64_t hash = 14695981039346656037ull;
+    for (int i = 0; i < count; i++) {
+        uint32_t bits;
+        std::memcpy(&bits, &points[i].Depth, sizeof(bits));
+
+        hash ^= bits;
+        hash *= 1099511628211ull;
+    }
+
+    return hash;
+}
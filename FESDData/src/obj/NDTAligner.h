@@ -0,0 +1,87 @@
+#pragma once
+#include <cstdint>
+#include <unordered_map>
+#include <vector>
+
+#include <glm/glm.hpp>
+
+#include "Point.h"
+
+/// <summary>
+/// Normal Distributions Transform aligning a moving cloud to a reference cloud.
+/// The reference is represented by one grid of normal distributions per resolution, built in parallel once and kept until a reference
+/// with a different hash is set, so repeated alignments of the moving cameras only pay for the optimisation.
+/// Alignment runs coarse to fine, every level starts from the result of the previous one and coarse levels only use a subset of the source.
+/// </summary>
+class NDTAligner
+{
+public:
+	struct Parameters
+	{
+		std::vector<float> Resolutions{ 0.4f, 0.2f, 0.1f };	// Cell sizes from coarse to fine (in m)
+		int MaxIterations{ 15 };							// Per resolution
+		float TransformationEpsilon{ 1e-4f };
+		int MinPointsPerCell{ 6 };
+	};
+
+	struct Result
+	{
+		int Iterations{ 0 };
+		float Score{ 0.0f };		// Mean likelihood of the source points on the finest grid, summed over the neighbouring cells
+		float Milliseconds{ 0.0f };
+		bool Converged{ false };
+	};
+
+	NDTAligner() = default;
+	explicit NDTAligner(Parameters params) : m_Params(params) { }
+
+	Parameters& getParameters() { return m_Params; }
+	const Result& getResult() const { return m_Result; }
+
+	/// <summary>
+	/// Build the grids of the reference cloud unless they were already built for the same hash and resolutions
+	/// </summary>
+	/// <returns>True if the grids were rebuilt</returns>
+	bool setTarget(const std::vector<glm::vec3>& points, uint64_t hash);
+	bool hasTarget() const { return !m_Grids.empty(); }
+	/// <summary>
+	/// The grids were built for this hash with the current resolutions
+	/// </summary>
+	bool isTargetValid(uint64_t hash) const;
+	uint64_t getTargetHash() const { return m_TargetHash; }
+	void resetTarget();
+
+	/// <summary>
+	/// Align the source cloud to the reference
+	/// </summary>
+	/// <param name="transformation">Initial guess, replaced by the transformation moving the source into the frame of the reference</param>
+	const Result& align(const std::vector<glm::vec3>& source, glm::mat4& transformation);
+
+	/// <summary>
+	/// Hash of the depth values of a frame, identifies the reference the grids were built from
+	/// </summary>
+	static uint64_t hashFrame(const Point* points, int count);
+private:
+	struct Cell
+	{
+		glm::vec3 Mean;
+		glm::mat3 Whitening;	// W^T * W is the inverse covariance
+	};
+
+	struct Grid
+	{
+		float Resolution{ 0.0f };
+		std::vector<Cell> Cells;
+		std::unordered_map<uint64_t, uint32_t> Lookup;
+
+		void build(const std::vector<glm::vec3>& points, float resolution, int minPoints);
+		uint64_t getKey(const glm::vec3& p) const;
+		int findNeighbours(const glm::vec3& p, const Cell* cells[8]) const;
+	};
+
+	Parameters m_Params{ };
+	Result m_Result{ };
+
+	std::vector<Grid> m_Grids;
+	uint64_t m_TargetHash{ 0 };
+};
@@ -0,0 +1,271 @@
+#include "OrganizedNormals.h"
+
+#include <algorithm>
+#include <cmath>
+#include <execution>
+#include <numeric>
+
+#include "utilities/Profiler.h"
+
+namespace {
+/// <summary>
+/// Eigenvector of the smallest eigenvalue of a symmetric 3x3 matrix, analytic solution of the characteristic polynomial
+/// </summary>
+/// <returns>Normal in xyz, curvature in w</returns>
+glm::vec4 smallestEigenvector(float a00, float a01, float a02, float a11, float a12, float a22)
+{
+    const float trace = a00 + a11 + a22;
+    if (trace <= 0.0f)
+        return glm::vec4{ 0.0f };
+
+    float p1 = a01 * a01 + a02 * a02 + a12 * a12;
+    float q = trace / 3.0f;
+    float p2 = (a00 - q) * (a00 - q) + (a11 - q) * (a11 - q) + (a22 - q) * (a22 - q) + 2.0f * p1;
+    float p = std::sqrt(p2 / 6.0f);
+
+    // Isotropic, no dominant plane
+    if (p <= 1e-12f)
+        return glm::vec4{ 0.0f };
+
+    float b00 = (a00 - q) / p, b01 = a01 / p, b02 = a02 / p;
+    float b11 = (a11 - q) / p, b12 = a12 / p, b22 = (a22 - q) / p;
+    float r = 0.5f * (b00 * (b11 * b22 - b12 * b12) - b01 * (b01 * b22 - b12 * b02) + b02 * (b01 * b12 - b11 * b02));
+    float phi = std::acos(std::clamp(r, -1.0f, 1.0f)) / 3.0f;
+
+    // Eigenvalues l0 >= l1 >= l2
+    float l0 = q + 2.0f * p * std::cos(phi);
+    float l2 = q + 2.0f * p * std::cos(phi + 2.0f * 3.14159265f / 3.0f);
+
+    // The eigenvector is orthogonal to the rows of A - l2 * I, take the most stable cross product
+    glm::vec3 r0{ a00 - l2, a01, a02 };
+    glm::vec3 r1{ a01, a11 - l2, a12 };
+    glm::vec3 r2{ a02, a12, a22 - l2 };
+
+    glm::vec3 c0 = glm::cross(r0, r1);
+    glm::vec3 c1 = glm::cross(r0, r2);
+    glm::vec3 c2 = glm::cross(r1, r2);
+    float d0 = glm::dot(c0, c0);
+    float d1 = glm::dot(c1, c1);
+    float d2 = glm::dot(c2, c2);
+
+    glm::vec3 n;
+    if (d0 >= d1 && d0 >= d2)
+        n = c0 / std::sqrt(d0);
+    else if (d1 >= d2)
+        n = c1 / std::sqrt(d1);
+    else
+        n = c2 / std::sqrt(d2);
+
+    if (!std::isfinite(n.x) || l0 <= 0.0f)
+        return glm::vec4{ 0.0f };
+
+    return { n, std::max(l2, 0.0f) / trace };
+}
+}
+
+OrganizedNormals::Moments& OrganizedNormals::Moments::operator+=(const Moments& other)
+{
+    N += other.N;
+    X += other.X; Y += other.Y; Z += other.Z;
+    XX += other.XX; XY += other.XY; XZ += other.XZ;
+    YY += other.YY; YZ += other.YZ; ZZ += other.ZZ;
+    return *this;
+}
+
+void OrganizedNormals::buildIntegralImages(int width, int height)
+{
+    PROFILE_FUNCTION();
+
+    const int stride = width + 1;
+    m_Integral.resize((size_t)stride * (height + 1));
+    m_EdgeIntegral.resize((size_t)stride * (height + 1));
+
+    // Only the first row and column have to be cleared, everything else is overwritten
+    std::fill_n(m_Integral.begin(), stride, Moments{ });
+    std::fill_n(m_EdgeIntegral.begin(), stride, 0);
+    for (int v = 1; v <= height; v++) {
+        m_Integral[(size_t)v * stride] = Moments{ };
+        m_EdgeIntegral[(size_t)v * stride] = 0;
+    }
+
+    std::vector<int> rows(height);
+    std::iota(rows.begin(), rows.end(), 0);
+
+    // Prefix sums along the rows
+    std::for_each(std::execution::par, rows.begin(), rows.end(), [&](int v) {
+        Moments sum{ };
+        int edges = 0;
+
+        for (int u = 0; u < width; u++) {
+            const int i = v * width + u;
+            const auto& p = m_Positions[i];
+
+            if (p.z > 0.0f) {
+                sum += { 1.0, p.x, p.y, p.z,
+                         (double)p.x * p.x, (double)p.x * p.y, (double)p.x * p.z,
+                         (double)p.y * p.y, (double)p.y * p.z, (double)p.z * p.z };
+            }
+            edges += m_Edges[i];
+
+            m_Integral[(size_t)(v + 1) * stride + u + 1] = sum;
+            m_EdgeIntegral[(size_t)(v + 1) * stride + u + 1] = edges;
+        }
+    });
+
+    // Prefix sums along the columns, blocks of columns in parallel
+    constexpr int ColumnsPerBlock{ 64 };
+    std::vector<int> blocks((stride + ColumnsPerBlock - 1) / ColumnsPerBlock);
+    std::iota(blocks.begin(), blocks.end(), 0);
+
+    std::for_each(std::execution::par, blocks.begin(), blocks.end(), [&](int block) {
+        const int first = block * ColumnsPerBlock;
+        const int last = std::min(stride, first + ColumnsPerBlock);
+
+        for (int v = 2; v <= height; v++) {
+            for (int u = first; u < last; u++) {
+                m_Integral[(size_t)v * stride + u] += m_Integral[(size_t)(v - 1) * stride + u];
+                m_EdgeIntegral[(size_t)v * stride + u] += m_EdgeIntegral[(size_t)(v - 1) * stride + u];
+            }
+        }
+    });
+}
+
+glm::vec4 OrganizedNormals::computeNormal(const Moments& m) const
+{
+    if (m.N < m_Params.MinNeighbours)
+        return glm::vec4{ 0.0f };
+
+    const double mx = m.X / m.N, my = m.Y / m.N, mz = m.Z / m.N;
+
+    return smallestEigenvector((float)(m.XX / m.N - mx * mx), (float)(m.XY / m.N - mx * my), (float)(m.XZ / m.N - mx * mz),
+                               (float)(m.YY / m.N - my * my), (float)(m.YZ / m.N - my * mz),
+                               (float)(m.ZZ / m.N - mz * mz));
+}
+
+const std::vector<glm::vec4>& OrganizedNormals::compute(const Point* points, int width, int height)
+{
+    PROFILE_FUNCTION();
+
+    const int count = width * height;
+    m_Positions.resize(count);
+    m_Edges.resize(count);
+    m_Normals.resize(count);
+
+    std::vector<int> rows(height);
+    std::iota(rows.begin(), rows.end(), 0);
+
+    std::for_each(std::execution::par, rows.begin(), rows.end(), [&](int v) {
+        for (int i = v * width; i < (v + 1) * width; i++)
+            m_Positions[i] = points[i].getPoint();
+    });
+
+    auto isDiscontinuous = [&](float z, float neighbour) {
+        return neighbour <= 0.0f || std::abs(neighbour - z) > m_Params.MaxDepthChange * z;
+    };
+
+    std::for_each(std::execution::par, rows.begin(), rows.end(), [&](int v) {
+        for (int u = 0; u < width; u++) {
+            const int i = v * width + u;
+            const float z = m_Positions[i].z;
+
+            m_Edges[i] = z <= 0.0f
+                || (u + 1 < width && isDiscontinuous(z, m_Positions[i + 1].z))
+                || (v + 1 < height && isDiscontinuous(z, m_Positions[i + width].z));
+        }
+    });
+
+    buildIntegralImages(width, height);
+
+    const int radius = std::max(1, m_Params.Radius);
+    const int step = std::max(1, m_Params.Step);
+    const int stride = width + 1;
+
+    std::for_each(std::execution::par, rows.begin(), rows.end(), [&](int v) {
+        const int top = std::max(0, v - radius);
+        const int bottom = std::min(height, v + radius + 1);
+
+        for (int u = 0; u < width; u++) {
+            const int i = v * width + u;
+            const glm::vec3 c = m_Positions[i];
+
+            if (c.z <= 0.0f) {
+                m_Normals[i] = glm::vec4{ 0.0f };
+                continue;
+            }
+
+            const int left = std::max(0, u - radius);
+            const int right = std::min(width, u + radius + 1);
+
+            // Edges of the last row and column of the window point outside of it
+            auto edges = m_EdgeIntegral[(size_t)(bottom - 1) * stride + right - 1] - m_EdgeIntegral[(size_t)top * stride + right - 1]
+                       - m_EdgeIntegral[(size_t)(bottom - 1) * stride + left] + m_EdgeIntegral[(size_t)top * stride + left];
+
+            Moments m{ };
+            if (edges == 0) {
+                m = m_Integral[(size_t)bottom * stride + right];
+                m += m_Integral[(size_t)top * stride + left];
+
+                const auto& topRight = m_Integral[(size_t)top * stride + right];
+                const auto& bottomLeft = m_Integral[(size_t)bottom * stride + left];
+                m.N -= topRight.N + bottomLeft.N;
+                m.X -= topRight.X + bottomLeft.X; m.Y -= topRight.Y + bottomLeft.Y; m.Z -= topRight.Z + bottomLeft.Z;
+                m.XX -= topRight.XX + bottomLeft.XX; m.XY -= topRight.XY + bottomLeft.XY; m.XZ -= topRight.XZ + bottomLeft.XZ;
+                m.YY -= topRight.YY + bottomLeft.YY; m.YZ -= topRight.YZ + bottomLeft.YZ; m.ZZ -= topRight.ZZ + bottomLeft.ZZ;
+            }
+            else {
+                // Moments relative to the centre point, skipping neighbours behind a discontinuity
+                const float maxDepthChange = m_Params.MaxDepthChange * c.z;
+
+                for (int nv = v - radius; nv <= v + radius; nv += step) {
+                    if (nv < 0 || nv >= height)
+                        continue;
+
+                    for (int nu = u - radius; nu <= u + radius; nu += step) {
+                        if (nu < 0 || nu >= width)
+                            continue;
+
+                        const glm::vec3& q = m_Positions[nv * width + nu];
+                        if (q.z <= 0.0f || std::abs(q.z - c.z) > maxDepthChange)
+                            continue;
+
+                        glm::vec3 d = q - c;
+                        m += { 1.0, d.x, d.y, d.z,
+                               (double)d.x * d.x, (double)d.x * d.y, (double)d.x * d.z,
+                               (double)d.y * d.y, (double)d.y * d.z, (double)d.z * d.z };
+                    }
+                }
+            }
+
+            auto normal = computeNormal(m);
+
+            // Orient towards the camera at the origin
+            if (glm::dot(glm::vec3(normal), c) > 0.0f)
+                normal = { -normal.x, -normal.y, -normal.z, normal.w };
+
+            m_Normals[i] = normal;
+        }
+    });
+
+    return m_Normals;
+}
+
+void OrganizedNormals::shade(Point* points, const glm::vec4* normals, int count)
+{
+    PROFILE_FUNCTION();
+
+    std::vector<int> blocks((count + 4095) / 4096);
+    std::iota(blocks.begin(), blocks.end(), 0);
+
+    std::for_each(std::execution::par, blocks.begin(), blocks.end(), [&](int block) {
+        for (int i = block * 4096; i < std::min(count, (block + 1) * 4096); i++) {
+            if (points[i].Depth <= 0.0f || normals[i] == glm::vec4{ 0.0f })
+                continue;
+
+            auto ray = glm::normalize(points[i].getPoint());
+            float light = 0.25f + 0.75f * std::max(0.0f, -glm::dot(glm::vec3(normals[i]), ray));
+
+            for (auto& c : points[i].Color)
+                c *= light;
+        }
+    });
+}
@@ -0,0 +1,62 @@
+#pragma once
+#include <cstdint>
+#include <vector>
+
+#include <glm/glm.hpp>
+
+#include "Point.h"
+
+/// <summary>
+/// Normal estimation for organized clouds, the neighbours of a point are the pixels around it in the depth image so no search tree is needed.
+/// The normal is the eigenvector of the smallest eigenvalue of the covariance of a pixel window.
+/// The moments of every window are read from integral images in constant time, only windows containing a depth discontinuity are
+/// accumulated pixel by pixel so neighbours across the discontinuity can be ignored. Rows are processed in parallel.
+/// </summary>
+class OrganizedNormals
+{
+public:
+	struct Parameters
+	{
+		int Radius{ 4 };				// Window of (2 * Radius + 1)^2 pixels
+		int Step{ 2 };					// Only use every Step-th pixel of windows containing a discontinuity
+		float MaxDepthChange{ 0.02f };	// Relative to the depth of the centre pixel
+		int MinNeighbours{ 5 };
+	};
+
+	OrganizedNormals() = default;
+	explicit OrganizedNormals(Parameters params) : m_Params(params) { }
+
+	Parameters& getParameters() { return m_Params; }
+
+	/// <summary>
+	/// Estimate the normals of the vertex data of one camera
+	/// </summary>
+	/// <returns>Per pixel normal (xyz, pointing towards the camera) and curvature (w), zero where no normal could be estimated</returns>
+	const std::vector<glm::vec4>& compute(const Point* points, int width, int height);
+
+	const std::vector<glm::vec4>& getNormals() const { return m_Normals; }
+
+	/// <summary>
+	/// Darken the colour of every point by the angle between its normal and the viewing ray of the camera
+	/// </summary>
+	static void shade(Point* points, const glm::vec4* normals, int count);
+private:
+	/// Zeroth to second order moments of the points of a window
+	struct Moments
+	{
+		double N, X, Y, Z, XX, XY, XZ, YY, YZ, ZZ;
+
+		Moments& operator+=(const Moments& other);
+	};
+
+	void buildIntegralImages(int width, int height);
+	glm::vec4 computeNormal(const Moments& m) const;
+
+	Parameters m_Params{ };
+
+	std::vector<glm::vec3> m_Positions;
+	std::vector<uint8_t> m_Edges;			// Pixel is invalid or its right or lower neighbour is behind a discontinuity
+	std::vector<Moments> m_Integral;		// (width + 1) * (height + 1), first row and column are zero
+	std::vector<int> m_EdgeIntegral;
+	std::vector<glm::vec4> m_Normals;
+};
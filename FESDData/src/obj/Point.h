@@ -13,6 +13,22 @@ class Point
 public:
 	Point() : PositionFunction{ 0.0f }, Depth(0.0f), Color{ 0.0f }, CamId( 0.0f ) {}
 
+	/// <summary>
+	/// Direction of the ray through pixel (u, v), multiplied with the depth it gives the point
+	/// </summary>
+	static std::array<float, 2> getPositionFunction(int u, int v, float fx, float fy, float cx, float cy)
+	{
+		return { ((float)u - cx) / fx, ((float)v - cy) / fy };
+	}
+
+	/// <summary>
+	/// Index of the depth pixel shown by the point at index i, the point cloud shows the depth frame rotated by 180 degrees
+	/// </summary>
+	static int getDepthIndex(int i, int width, int height)
+	{
+		return width * height - 1 - i;
+	}
+
 	std::array<float, 3> getColorFromDepth(float depth) const {
 		float z = std::clamp(depth / 6.0f, 0.0f, 1.0f);
 		return CMap::getViridis(z);
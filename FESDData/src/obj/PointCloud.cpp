@@ -4,12 +4,17 @@
 #include <ranges>
 #include <random>
 #include <execution>
+#include <limits>
+#include <numeric>
 
 #include <GLCore/GLErrorManager.h>
 #include <imgui.h>
 #include <glm/gtc/matrix_transform.hpp>
 #include <glm/gtx/euler_angles.hpp>
 
+#include "utilities/Profiler.h"
+#include "utilities/helper/ImGuiHelper.h"
+
 #define PixIter(cam_index) for(int i = 0; i < m_NumElements[cam_index]; i++)
 
 namespace GLObject
@@ -30,35 +35,39 @@ namespace GLObject
             m_NumElements.push_back(m_StreamWidths.back() * m_StreamHeights.back());
             m_ElementOffset.push_back(m_NumElementsTotal);
             
-            m_MVPS.push_back({ });
+            m_Rotations.push_back({ 0.0f, 0.0f, 0.0f });
+            m_Translations.push_back({ 0.0f, 0.0f, 0.0f });
 
             m_Points.push_back(std::make_shared<Point[]>(m_NumElements.back()));
 
+            m_Statistics.push_back({ });
             m_BoundingBoxes.push_back({ });
             m_CellSizes.push_back({ });
+            m_Voxels.push_back({ });
+            m_Backgrounds.push_back({ });
 
             m_NumElementsTotal += m_NumElements.back();
         }
         
         // Add the last element + 1 so termination criteria is simpler
         m_ElementOffset.push_back(m_NumElementsTotal + 1);
-        auto* indices = new unsigned int[m_NumElementsTotal];
+        m_Indices.resize(m_NumElementsTotal);
+        m_MeanDepths.resize(m_CameraCount, 0.0f);
 
         for (int cam_index = 0; cam_index < m_CameraCount; cam_index++) {
             float fx = m_DepthCameras[cam_index]->getIntrinsics(INTRINSICS::FX);
             float fy = m_DepthCameras[cam_index]->getIntrinsics(INTRINSICS::FY);
             float cx = m_DepthCameras[cam_index]->getIntrinsics(INTRINSICS::CX);
             float cy = m_DepthCameras[cam_index]->getIntrinsics(INTRINSICS::CY);
+            m_Intrinsics.push_back({ fx, fy, cx, cy });
 
             for (int w = 0; w < m_StreamWidths[cam_index]; w++) {
                 for (int h = 0; h < m_StreamHeights[cam_index]; h++) {
                     int i = h * m_StreamWidths[cam_index] + w;
                     
-                    m_Points[cam_index][i].PositionFunction = { ((float)w - cx) / fx,
-                                                                ((float)h - cy) / fy };
+                    m_Points[cam_index][i].PositionFunction = Point::getPositionFunction(w, h, fx, fy, cx, cy);
 
                     m_Points[cam_index][i].updateVertexArray(0.f, cam_index);
-                    indices[i + m_ElementOffset[cam_index]] = i + m_ElementOffset[cam_index];
                 }
             }
         }
@@ -80,12 +89,27 @@ namespace GLObject
         
         m_GLUtil.m_VAO->AddBuffer(*m_GLUtil.m_VB, *m_GLUtil.m_VBL);
 
-        m_GLUtil.m_IndexBuffer = std::make_unique<IndexBuffer>(indices, m_NumElementsTotal);
+        // Filled with the valid pixels every frame
+        m_GLUtil.m_IndexBuffer = std::make_unique<IndexBuffer>(m_NumElementsTotal);
+        m_GLUtil.m_IndexBuffer->SetData(nullptr, 0);
 
         m_GLUtil.m_Shader = std::make_unique<Shader>("resources/shaders/PointCloud");
         m_GLUtil.m_Shader->Bind();
 
-        delete indices;
+        if (m_CameraCount > MaxCameras)
+            mp_Logger->log("Only the first " + std::to_string(MaxCameras) + " cameras can be transformed, the others are drawn in the common frame", Logger::Priority::WARN);
+
+        // One model matrix per camera, all cameras are drawn in one call
+        m_Models.resize(MaxCameras, glm::mat4{ 1.0f });
+        m_GLUtil.m_UniformBuffer = std::make_unique<UniformBuffer>(MaxCameras * sizeof(glm::mat4));
+        m_GLUtil.m_UniformBuffer->SetData(m_Models.data(), MaxCameras * sizeof(glm::mat4));
+        m_GLUtil.m_UniformBuffer->BindBase(CameraModelsBinding);
+        m_GLUtil.m_Shader->SetUniformBlockBinding("CameraModels", CameraModelsBinding);
+    }
+
+    PointCloud::~PointCloud()
+    {
+        cancelRegistration();
     }
 
     // 
@@ -98,6 +122,7 @@ namespace GLObject
 
     void PointCloud::OnUpdate(bool subData)
     {
+        PROFILE_FUNCTION();
         const int16_t *depth;
 
         for (int cam_index = 0; cam_index < m_CameraCount; cam_index++) {
@@ -106,73 +131,89 @@ namespace GLObject
                 continue;
 
             if (m_State == m_State.STREAM) {
-                depth = static_cast<const int16_t*>(cam->getDepth());
+                depth = static_cast<const int16_t*>(cam->getFilteredDepth());
                 if (depth != nullptr) {
                     streamDepth(cam_index, depth);
+                    m_IndicesOutdated = true;
+
+                    auto& background = m_Backgrounds[cam_index];
+                    if (background.isLearning())
+                        background.learn(m_Points[cam_index].get(), m_StreamWidths[cam_index], m_StreamHeights[cam_index]);
+                    else if (background.isReady() && m_CullBackground)
+                        background.segment(m_Points[cam_index].get(), m_StreamWidths[cam_index], m_StreamHeights[cam_index]);
+
+                    const uint8_t* mask = m_CullBackground && background.isReady() ? background.getMask().data() : nullptr;
+                    const auto& statistics = m_Statistics[cam_index].compute(m_Points[cam_index].get(), m_StreamWidths[cam_index], m_StreamHeights[cam_index], mask);
+                    m_BoundingBoxes[cam_index] = statistics.Bounds;
+
+                    if (m_ShadeNormals) {
+                        auto points = m_Points[cam_index].get();
+                        const auto& normals = m_NormalEstimator.compute(points, m_StreamWidths[cam_index], m_StreamHeights[cam_index]);
+                        OrganizedNormals::shade(points, normals.data(), m_NumElements[cam_index]);
+                    }
                 }
             }
 
-            GLCall(glBufferSubData(GL_ARRAY_BUFFER, 
-                                    sizeof(Point) * m_ElementOffset[cam_index], 
-                                    sizeof(Point) * m_NumElements[cam_index], 
-                                m_Points[cam_index].get()));
+            // Only the rows containing the subject are drawn when culling
+            int firstRow = 0, rows = m_StreamHeights[cam_index];
+            if (m_CullBackground && m_Backgrounds[cam_index].isReady()) {
+                const auto& region = m_Backgrounds[cam_index].getRegion();
+                firstRow = region.Y;
+                rows = region.empty() ? 0 : region.Height;
+            }
+
+            PROFILE_SCOPE("glBufferSubData");
+            if (rows > 0) {
+                const int first = firstRow * m_StreamWidths[cam_index];
+                GLCall(glBufferSubData(GL_ARRAY_BUFFER,
+                                        sizeof(Point) * (m_ElementOffset[cam_index] + first),
+                                        sizeof(Point) * rows * m_StreamWidths[cam_index],
+                                    m_Points[cam_index].get() + first));
+            }
         }
+
+        updateIndices();
+
+        if (m_TrackExtrinsics && m_State == m_State.STREAM)
+            trackExtrinsics();
     }
 
     void PointCloud::OnRender()
     {
+        PROFILE_FUNCTION();
         m_GLUtil.m_Shader->Bind();
 
-        glm::mat4 model{ 1.0f };
+        for (int cam_index = 0; cam_index < std::min(m_CameraCount, MaxCameras); cam_index++)
+            m_Models[cam_index] = getModel(cam_index);
 
-        model = glm::eulerAngleYXZ(m_Rotation.y, m_Rotation.x, m_Rotation.z); 
-        model = glm::translate(model, m_Translation);
-
-        m_GLUtil.m_Shader->SetUniformMat4f(("u_Model"), model);
+        m_GLUtil.m_UniformBuffer->SetData(m_Models.data(), MaxCameras * sizeof(glm::mat4));
+        m_GLUtil.m_UniformBuffer->BindBase(CameraModelsBinding);
 
         m_GLUtil.m_Shader->SetUniformMat4f("u_VP", camera->getViewProjection());
         m_GLUtil.m_Shader->SetUniformBool("u_AlignmentMode", m_AlignmentMode);
+
+        // Larger points close the gaps of the skipped pixels
+        GLCall(glPointSize(1.5f * m_LODStride));
         m_GLUtil.mp_Renderer->DrawPoints(*m_GLUtil.m_VAO, *m_GLUtil.m_IndexBuffer, *m_GLUtil.m_Shader);
     }
 
     void PointCloud::OnImGuiRender()
     {
+        PROFILE_FUNCTION();
         if (m_State != m_State.STREAM && ImGui::Button("Resume Stream"))
             resumeStream();
 
         if (m_State == m_State.STREAM && ImGui::Button("Pause Stream"))
             pauseStream();
-        /*
-        if (ImGui::TreeNode("NDT")) {
-            ImGui::InputFloat("Transformation Epsilon", &m_TransformationEpsilon, 0.01);
-            ImGui::InputFloat("Step Size", &m_StepSize, 0.05);
-            ImGui::InputFloat("Resolution", &m_Resolution, 0.1);
-            ImGui::InputInt("Max Iterations", &m_MaxIterations);
-            ImGui::TreePop();
-        }
-
-        ImGui::SetNextItemOpen(true);
-        if (ImGui::TreeNode("Feature Based")) {
-
-            ImGui::InputFloat("Leaf filter size (in cm)", &m_LeafSize, 0.01);
-
-            ImGui::Checkbox("Use SIFT", &m_UseSIFT);
-            
-            ImGui::BeginDisabled(!m_UseSIFT);
-            ImGui::InputFloat("Min Scale", &m_MinScale);
-            ImGui::InputInt("N Octaves", &m_NOctaves);
-            ImGui::InputInt("N ScalesPerOctave", &m_NScalesPerOctave);
-            ImGui::InputFloat("Min Contrast", &m_MinContrast);
-            ImGui::EndDisabled();
-
-            if (ImGui::Button("Gather Keypoints")) {
-                acquireData();
-                estimateKeyPoints();
-            }
-            ImGui::TreePop();
-        }*/
+        showNDT();
+        showRegistration();
+        showTracking();
 
         ImGui::Checkbox("Alignment Mode", &m_AlignmentMode);
+        ImGui::Checkbox("Shade Normals", &m_ShadeNormals);
+        showLOD();
+        showBackground();
+        showStatistics();
 
         manipulateTranslation();
     }
@@ -181,13 +222,27 @@ namespace GLObject
     {
         if (ImGui::CollapsingHeader("Translation"))
         {
-            ImGui::InputFloat("Yaw", &m_Rotation.x, 0.01f, 0.1f, "%.2f");
-            ImGui::InputFloat("Pitch", &m_Rotation.y, 0.01f, 0.1f, "%.2f");
-            ImGui::InputFloat("Roll", &m_Rotation.z, 0.01f, 0.1f, "%.2f");
+            for (int cam_index = 0; cam_index < m_CameraCount; cam_index++) {
+                ImGui::PushID(cam_index);
+                if (ImGui::TreeNode(m_DepthCameras[cam_index]->getCameraName().c_str())) {
+                    auto& rotation = m_Rotations[cam_index];
+                    auto& translation = m_Translations[cam_index];
 
-            ImGui::InputFloat("Translation x", &m_Translation.x, 0.01, 0.1, "%.3f");
-            ImGui::InputFloat("Translation y", &m_Translation.y, 0.01, 0.1, "%.3f");
-            ImGui::InputFloat("Translation z", &m_Translation.z, 0.01, 0.1, "%.3f");
+                    ImGui::InputFloat("Yaw", &rotation.x, 0.01f, 0.1f, "%.2f");
+                    ImGui::InputFloat("Pitch", &rotation.y, 0.01f, 0.1f, "%.2f");
+                    ImGui::InputFloat("Roll", &rotation.z, 0.01f, 0.1f, "%.2f");
+
+                    ImGui::InputFloat("Translation x", &translation.x, 0.01, 0.1, "%.3f");
+                    ImGui::InputFloat("Translation y", &translation.y, 0.01, 0.1, "%.3f");
+                    ImGui::InputFloat("Translation z", &translation.z, 0.01, 0.1, "%.3f");
+
+                    if (ImGui::Button("Reset Pose"))
+                        setModel(glm::mat4{ 1.0f }, cam_index);
+
+                    ImGui::TreePop();
+                }
+                ImGui::PopID();
+            }
         }
 
         if (ImGui::CollapsingHeader("Scale"))
@@ -199,24 +254,61 @@ namespace GLObject
     //
     // Getters
     //
-    Json::Value PointCloud::getRotation()
+    glm::mat4 PointCloud::getModel(int cam_index) const
+    {
+        const auto& rotation = m_Rotations[cam_index];
+        glm::mat4 model = glm::eulerAngleYXZ(rotation.y, rotation.x, rotation.z);
+        return glm::translate(model, m_Translations[cam_index]);
+    }
+
+    void PointCloud::setModel(const glm::mat4& model, int cam_index)
+    {
+        // Inverse of getModel, model = R * T so the translation has to be rotated back
+        auto& r = m_Rotations[cam_index];
+        glm::extractEulerAngleYXZ(model, r.y, r.x, r.z);
+
+        glm::mat3 rotation{ model };
+        m_Translations[cam_index] = glm::transpose(rotation) * glm::vec3(model[3]);
+    }
+
+    glm::mat4 PointCloud::getRelativeModel(int cam_index, int reference) const
+    {
+        return glm::inverse(getModel(reference)) * getModel(cam_index);
+    }
+
+    void PointCloud::setRelativeModel(const glm::mat4& model, int cam_index, int reference)
+    {
+        setModel(getModel(reference) * model, cam_index);
+    }
+
+    Json::Value PointCloud::getRotation(int cam_index)
     {
         Json::Value rotation;
-        rotation["Roll"] = m_Rotation.x;
-        rotation["Pitch"] = m_Rotation.y;
-        rotation["Yaw"] = m_Rotation.z;
+        rotation["Roll"] = m_Rotations[cam_index].x;
+        rotation["Pitch"] = m_Rotations[cam_index].y;
+        rotation["Yaw"] = m_Rotations[cam_index].z;
         return rotation;
     }
 
-    Json::Value PointCloud::getTranslation()
+    Json::Value PointCloud::getTranslation(int cam_index)
     {
         Json::Value translation;
-        translation["X"] = m_Translation.x;
-        translation["Y"] = m_Translation.y;
-        translation["Z"] = m_Translation.z;
+        translation["X"] = m_Translations[cam_index].x;
+        translation["Y"] = m_Translations[cam_index].y;
+        translation["Z"] = m_Translations[cam_index].z;
         return translation;
     }
 
+    void PointCloud::setRotation(const Json::Value& rotation, int cam_index)
+    {
+        m_Rotations[cam_index] = { rotation["Roll"].asFloat(), rotation["Pitch"].asFloat(), rotation["Yaw"].asFloat() };
+    }
+
+    void PointCloud::setTranslation(const Json::Value& translation, int cam_index)
+    {
+        m_Translations[cam_index] = { translation["X"].asFloat(), translation["Y"].asFloat(), translation["Z"].asFloat() };
+    }
+
     //
     // Pause and Resume
     //
@@ -227,6 +319,7 @@ namespace GLObject
 
     void PointCloud::resumeStream()
     {
+        cancelRegistration();
         m_State.setState(PointCloudStreamState::STREAM);
         
         m_ICPInitialised = false;
@@ -235,87 +328,321 @@ namespace GLObject
 
     void PointCloud::streamDepth(int cam_index, const int16_t *depth)
     {
-        PixIter(cam_index)
+        streamDepth(m_Points[cam_index].get(), m_StreamWidths[cam_index], m_StreamHeights[cam_index], depth,
+                    m_DepthCameras[cam_index]->getMetersPerUnit(), cam_index);
+    }
+
+    void PointCloud::streamDepth(Point* points, int width, int height, const int16_t* depth, float metersPerUnit, int cam_index)
+    {
+        PROFILE_FUNCTION();
+        for (int i = 0; i < width * height; i++)
         {
-            // Rotate the stream
-            int depth_i = m_StreamWidths[cam_index] * (m_StreamHeights[cam_index] + 1) - i;
-            m_BoundingBoxes[cam_index].updateBox(m_Points[cam_index][i].getPoint());
-            auto adapted_depth = (float)depth[depth_i] * m_DepthCameras[cam_index]->getMetersPerUnit();
+            const int depth_i = Point::getDepthIndex(i, width, height);
+            auto adapted_depth = (float)depth[depth_i] * metersPerUnit;
 
-            m_Points[cam_index][i].updateVertexArray(adapted_depth, cam_index);
+            points[i].updateVertexArray(adapted_depth, cam_index);
         }
     }
 
-    void PointCloud::acquireData()
+    //
+    // Index compaction
+    //
+    int PointCloud::compactIndices(const Point* points, int width, int height, int stride, unsigned int offset, unsigned int* indices, float* meanDepth, const uint8_t* mask)
     {
-        if (m_State.m_State == m_State.REGISTRATION)
-            return;
+        PROFILE_FUNCTION();
+        constexpr int RowsPerBlock{ 16 };
+
+        stride = std::max(stride, 1);
+        const int rows = (height + stride - 1) / stride;
+        std::vector<int> blocks((rows + RowsPerBlock - 1) / RowsPerBlock);
+        std::iota(blocks.begin(), blocks.end(), 0);
+
+        std::vector<int> counts(blocks.size() + 1, 0);
+        std::vector<double> depths(blocks.size(), 0.0);
+
+        auto forEachValid = [&](int block, auto&& f) {
+            const int last = std::min(rows, (block + 1) * RowsPerBlock);
+            for (int row = block * RowsPerBlock; row < last; row++) {
+                const int h = row * stride;
+                for (int w = 0; w < width; w += stride) {
+                    const int i = h * width + w;
+                    if (points[i].Depth > 0.0f && (mask == nullptr || mask[i]))
+                        f(i);
+                }
+            }
+        };
+
+        // Count, scan and write, every block knows where its indices go without synchronisation
+        std::for_each(std::execution::par, blocks.begin(), blocks.end(), [&](int block) {
+            int count = 0;
+            double depth = 0.0;
+            forEachValid(block, [&](int i) { count++; depth += points[i].Depth; });
+
+            counts[block] = count;
+            depths[block] = depth;
+        });
 
-        m_State.m_State = m_State.REGISTRATION;
-        m_CloudStatic = std::make_shared<pcl::PointCloud<pcl::PointXYZ>>(m_NumElements[0], 1);
+        std::exclusive_scan(counts.begin(), counts.end(), counts.begin(), 0);
 
-        for (int i = 0; i < m_NumElements[0]; i++) {
-            if (m_Points[1][i].Depth == 0.0f)
+        std::for_each(std::execution::par, blocks.begin(), blocks.end(), [&](int block) {
+            unsigned int* out = indices + counts[block];
+            forEachValid(block, [&](int i) { *out++ = offset + (unsigned int)i; });
+        });
+
+        const int total = counts.back();
+        if (meanDepth != nullptr)
+            *meanDepth = total > 0 ? (float)(std::accumulate(depths.begin(), depths.end(), 0.0) / total) : 0.0f;
+
+        return total;
+    }
+
+    int PointCloud::getLODStride() const
+    {
+        if (!m_UseLOD || m_LODDistance <= 0.0f)
+            return 1;
+
+        // The centre of a cloud is approximated by the optical axis at its mean depth
+        const glm::vec3 viewer = camera->getPosition();
+        float distance = std::numeric_limits<float>::max();
+        for (int cam_index = 0; cam_index < m_CameraCount; cam_index++) {
+            if (m_MeanDepths[cam_index] <= 0.0f)
                 continue;
-            auto p = &(m_CloudStatic.get()->at(i));
-            auto point = m_Points[0][i].getPoint();
-            p->x = point.x;
-            p->y = point.y;
-            p->z = point.z;
+
+            glm::vec4 centre{ 0.0f, 0.0f, m_MeanDepths[cam_index], 1.0f };
+            if (cam_index < MaxCameras)
+                centre = getModel(cam_index) * centre;
+
+            distance = std::min(distance, glm::distance(viewer, glm::vec3(centre)));
         }
 
-        mp_Logger->log("Loaded static Point cloud with " + std::to_string(m_CloudStatic->size()) + " data points");
+        if (distance == std::numeric_limits<float>::max())
+            return 1;
+
+        return std::clamp(1 + (int)(distance / m_LODDistance), 1, std::max(m_MaxLODStride, 1));
+    }
+
+    void PointCloud::updateIndices()
+    {
+        PROFILE_FUNCTION();
+        const int stride = getLODStride();
+        if (!m_IndicesOutdated && stride == m_LODStride)
+            return;
+
+        m_LODStride = stride;
+        m_IndexCount = 0;
+
+        for (int cam_index = 0; cam_index < m_CameraCount; cam_index++) {
+            const auto& background = m_Backgrounds[cam_index];
+            const uint8_t* mask = m_CullBackground && background.isReady() ? background.getMask().data() : nullptr;
+
+            m_IndexCount += compactIndices(m_Points[cam_index].get(), m_StreamWidths[cam_index], m_StreamHeights[cam_index], m_LODStride,
+                                           m_ElementOffset[cam_index], m_Indices.data() + m_IndexCount, &m_MeanDepths[cam_index], mask);
+        }
+
+        // The element buffer binding is part of the vertex array state, so bind ours first
+        m_GLUtil.m_VAO->Bind();
+        m_GLUtil.m_IndexBuffer->SetData(m_Indices.data(), m_IndexCount);
+        m_IndicesOutdated = false;
+    }
+
+    void PointCloud::showLOD()
+    {
+        if (!ImGui::TreeNode("Level of Detail"))
+            return;
+
+        bool changed = ImGui::Checkbox("Decimate with Distance", &m_UseLOD);
+        ImGui::BeginDisabled(!m_UseLOD);
+        changed |= ImGui::SliderFloat("Distance per Level (m)", &m_LODDistance, 0.5f, 10.0f, "%.1f");
+        changed |= ImGui::SliderInt("Max Stride", &m_MaxLODStride, 1, 8);
+        ImGui::EndDisabled();
+
+        // Also applies while paused, when the stream does not refresh the indices
+        if (changed)
+            m_IndicesOutdated = true;
 
-        // Loading second scan of room from new perspective.
-        m_CloudDynamic = std::make_shared<pcl::PointCloud<pcl::PointXYZ>>(m_NumElements[1], 1);
+        ImGui::Text("Stride: %d", m_LODStride);
+        ImGui::Text("Drawn points: %d / %d (%.1f%%)", m_IndexCount, m_NumElementsTotal, 100.0f * m_IndexCount / std::max(m_NumElementsTotal, 1));
 
-        for (int i = 0; i < m_NumElements[1]; i++) {
-            if (m_Points[1][i].Depth == 0.0f)
+        ImGui::TreePop();
+    }
+
+    //
+    // Background
+    //
+    void PointCloud::startBackgroundLearning()
+    {
+        for (auto& background : m_Backgrounds)
+            background.startLearning();
+    }
+
+    void PointCloud::finishBackgroundLearning()
+    {
+        for (int cam_index = 0; cam_index < m_CameraCount; cam_index++) {
+            auto& background = m_Backgrounds[cam_index];
+            if (!background.isLearning())
                 continue;
-            auto p = &(m_CloudDynamic.get()->at(i));
-            auto point = m_Points[1][i].getPoint();
-            p->x = point.x;
-            p->y = point.y;
-            p->z = point.z;
+
+            background.finishLearning();
+            mp_Logger->log("Learned the background of " + m_DepthCameras[cam_index]->getCameraName() + " from " + std::to_string(background.getLearnedFrames()) + " frames");
         }
-        mp_Logger->log("Loaded dynamic Point cloud with " + std::to_string(m_CloudDynamic->size()) + " data points");
-        filterData();
+        m_IndicesOutdated = true;
     }
-    
+
+    BackgroundModel::Region PointCloud::getSubjectRegion(int cam_index) const
+    {
+        const int width = m_StreamWidths[cam_index], height = m_StreamHeights[cam_index];
+        const auto& background = m_Backgrounds[cam_index];
+        if (!background.isReady())
+            return { 0, 0, width, height };
+
+        // The points are the depth frame rotated by 180 degrees, see streamDepth
+        auto region = background.getRegion();
+        if (region.empty())
+            return region;
+
+        return { std::max(0, width - region.X - region.Width), std::max(0, height - region.Y - region.Height), region.Width, region.Height };
+    }
+
+    void PointCloud::showBackground()
+    {
+        if (!ImGui::TreeNode("Background"))
+            return;
+
+        bool learning = std::ranges::any_of(m_Backgrounds, [](const auto& background) { return background.isLearning(); });
+        if (!learning && ImGui::Button("Learn Background"))
+            startBackgroundLearning();
+        if (learning && ImGui::Button("Finish Learning"))
+            finishBackgroundLearning();
+        ImGuiHelper::HelpMarker("The background is learned automatically during the countdown if the session segments the subject, nobody should stand still in front of the cameras while learning");
+
+        if (ImGui::Checkbox("Cull Background", &m_CullBackground)) {
+            // The masks are only segmented while culling, the current points may not have one yet, e.g. while paused
+            if (m_CullBackground) {
+                for (int cam_index = 0; cam_index < m_CameraCount; cam_index++) {
+                    auto& background = m_Backgrounds[cam_index];
+                    if (background.isReady())
+                        background.segment(m_Points[cam_index].get(), m_StreamWidths[cam_index], m_StreamHeights[cam_index]);
+                }
+            }
+            m_IndicesOutdated = true;
+        }
+
+        for (int cam_index = 0; cam_index < m_CameraCount; cam_index++) {
+            const auto& background = m_Backgrounds[cam_index];
+            const auto& name = m_DepthCameras[cam_index]->getCameraName();
+            if (background.isLearning())
+                ImGui::Text("%s: learning, %d frames", name.c_str(), background.getLearnedFrames());
+            else if (background.isReady())
+                ImGui::Text("%s: subject covers %.1f%% of the frame", name.c_str(), 100.0f * background.getRegionRatio());
+            else
+                ImGui::Text("%s: no background", name.c_str());
+        }
+
+        ImGui::TreePop();
+    }
+
+    void PointCloud::showStatistics()
+    {
+        if (!ImGui::TreeNode("Depth Statistics"))
+            return;
+
+        for (int cam_index = 0; cam_index < m_CameraCount; cam_index++) {
+            ImGui::PushID(cam_index);
+            if (ImGui::TreeNode(m_DepthCameras[cam_index]->getCameraName().c_str())) {
+                m_Statistics[cam_index].showStatistics();
+                ImGui::TreePop();
+            }
+            ImGui::PopID();
+        }
+
+        ImGui::TreePop();
+    }
+
     void PointCloud::filterData() {
-        pcl::PointCloud<pcl::PointXYZ>::Ptr filtered_cloud_dynamic(new pcl::PointCloud<pcl::PointXYZ>);
-        pcl::ApproximateVoxelGrid<pcl::PointXYZ> approximate_voxel_filter;
-        approximate_voxel_filter.setLeafSize(m_LeafSize, m_LeafSize, m_LeafSize);
-        approximate_voxel_filter.setInputCloud(m_CloudStatic);
-        approximate_voxel_filter.filter(*m_CloudStatic);
-        approximate_voxel_filter.setInputCloud(m_CloudDynamic);
-        approximate_voxel_filter.filter(*m_CloudDynamic);
+        PROFILE_FUNCTION();
+        m_VoxelGrid.setLeafSize(m_LeafSize);
+
+        m_CloudStatic = filterCloud(0);
         mp_Logger->log("Filtered static cloud contains " + std::to_string(m_CloudStatic->size()) + " data points");
+
+        m_CloudDynamic = filterCloud(1);
         mp_Logger->log("Filtered dynamic cloud contains " + std::to_string(m_CloudDynamic->size()) + " data points");
     }
 
+    pcl::PointCloud<pcl::PointXYZ>::Ptr PointCloud::filterCloud(int cam_index)
+    {
+        // Pixels without depth are skipped by the voxel grid
+        const auto& voxels = m_VoxelGrid.filter(m_Points[cam_index].get(), m_NumElements[cam_index]);
+        // Keep the source pixels, the normals are looked up in the organized image
+        m_Voxels[cam_index] = voxels;
+
+        auto cloud = std::make_shared<pcl::PointCloud<pcl::PointXYZ>>(voxels.size(), 1);
+        for (size_t i = 0; i < voxels.size(); i++) {
+            auto& p = cloud->at(i);
+            p.x = voxels.Centroids[i].x;
+            p.y = voxels.Centroids[i].y;
+            p.z = voxels.Centroids[i].z;
+        }
+
+        return cloud;
+    }
+
     void PointCloud::computeNormals() {
+        PROFILE_FUNCTION();
         // Calculate normals for both pointclouds
-        pcl::NormalEstimation<pcl::PointXYZ, pcl::Normal> ne;
-        pcl::search::KdTree<pcl::PointXYZ>::Ptr tree_normal(new pcl::search::KdTree<pcl::PointXYZ>());
-        ne.setSearchMethod(tree_normal);
-
-        // Output datasets
-        m_NormalsStatic = std::make_shared<pcl::PointCloud<pcl::Normal>>();
-        m_NormalsDynamic = std::make_shared<pcl::PointCloud<pcl::Normal>>();
+        m_NormalsStatic = computeNormals(0);
+        m_NormalsDynamic = computeNormals(1);
+
+        // Voxels without a normal would poison the features, drop them from both clouds
+        auto removeInvalid = [](pcl::PointCloud<pcl::PointXYZ>::Ptr& cloud, pcl::PointCloud<pcl::Normal>::Ptr& normals) {
+            auto validCloud = std::make_shared<pcl::PointCloud<pcl::PointXYZ>>();
+            auto validNormals = std::make_shared<pcl::PointCloud<pcl::Normal>>();
+            validCloud->reserve(cloud->size());
+            validNormals->reserve(normals->size());
+
+            for (size_t i = 0; i < cloud->size(); i++) {
+                if (!std::isfinite(normals->at(i).normal_x))
+                    continue;
 
-        // Use all neighbors in a sphere of radius 3cm
-        ne.setRadiusSearch(std::max(0.03f, m_LeafSize));
+                validCloud->push_back(cloud->at(i));
+                validNormals->push_back(normals->at(i));
+            }
 
-        ne.setInputCloud(m_CloudStatic);
-        ne.compute(*m_NormalsStatic);
+            cloud = validCloud;
+            normals = validNormals;
+        };
 
-        ne.setInputCloud(m_CloudDynamic);
-        ne.compute(*m_NormalsDynamic);
+        removeInvalid(m_CloudStatic, m_NormalsStatic);
+        removeInvalid(m_CloudDynamic, m_NormalsDynamic);
 
         m_NormalsCalculated = true;
     }
 
+    pcl::PointCloud<pcl::Normal>::Ptr PointCloud::computeNormals(int cam_index)
+    {
+        // Estimate on the full depth image, every voxel takes the normal of its source pixel
+        const auto& normals = m_NormalEstimator.compute(m_Points[cam_index].get(), m_StreamWidths[cam_index], m_StreamHeights[cam_index]);
+        const auto& voxels = m_Voxels[cam_index];
+
+        auto cloud = std::make_shared<pcl::PointCloud<pcl::Normal>>(voxels.size(), 1);
+        for (size_t i = 0; i < voxels.size(); i++) {
+            const auto& n = normals[voxels.SourceIndices[i]];
+            auto& normal = cloud->at(i);
+
+            if (n == glm::vec4{ 0.0f }) {
+                normal.normal_x = normal.normal_y = normal.normal_z = normal.curvature = std::numeric_limits<float>::quiet_NaN();
+                continue;
+            }
+
+            normal.normal_x = n.x;
+            normal.normal_y = n.y;
+            normal.normal_z = n.z;
+            normal.curvature = n.w;
+        }
+
+        return cloud;
+    }
+
     double computeCloudResolution(const pcl::PointCloud<pcl::PointXYZ>::ConstPtr& cloud)
     {
         double res = 0.0;
@@ -348,7 +675,8 @@ namespace GLObject
     }
 
     void PointCloud::estimateKeyPoints()
-    {        
+    {
+        PROFILE_FUNCTION();
         if (m_UseSIFT)
         {
             m_SIFTKPStatic = std::make_shared<pcl::PointCloud<pcl::PointXYZ>>();
@@ -364,9 +692,6 @@ namespace GLObject
             pcl::concatenateFields(*m_CloudStatic, *m_NormalsStatic, *normalpoint_static);
             pcl::concatenateFields(*m_CloudDynamic, *m_NormalsDynamic, *normalpoint_dynamic);
             
-            mp_Logger->log("SIFT found " + std::to_string(normalpoint_static->size()) + " key points (static)");
-            mp_Logger->log("SIFT found " + std::to_string(normalpoint_dynamic->size()) + " key points (dynamic)");
-           
             pcl::SIFTKeypoint<pcl::PointNormal, pcl::PointWithScale> sift;
             pcl::PointCloud<pcl::PointWithScale> result;
             pcl::search::KdTree<pcl::PointNormal>::Ptr tree_sift(new pcl::search::KdTree<pcl::PointNormal>());
@@ -387,18 +712,27 @@ namespace GLObject
             mp_Logger->log("SIFT found " + std::to_string(m_SIFTKPStatic->size()) + " key points (static)");
             mp_Logger->log("SIFT found " + std::to_string(m_SIFTKPDynamic->size()) + " key points (dynamic)");
         }
+        else
+        {
+            // Without SIFT every point of the filtered clouds is a key point, the key points of an earlier run must not be used
+            m_SIFTKPStatic = m_CloudStatic;
+            m_SIFTKPDynamic = m_CloudDynamic;
+            mp_Logger->log("SIFT disabled, using all " + std::to_string(m_SIFTKPStatic->size()) + " (static) and " + std::to_string(m_SIFTKPDynamic->size()) + " (dynamic) filtered points as key points");
+        }
     }
 
     void PointCloud::describeKeyPoints()
     {
+        PROFILE_FUNCTION();
         {// FPFH
             // Calculate normals for both pointclouds
             if (!m_NormalsCalculated) {
                 computeNormals();
             }
 
+            // Keypoints are described in parallel, the neighbourhoods come from the full filtered clouds
             pcl::search::KdTree<pcl::PointXYZ>::Ptr tree(new pcl::search::KdTree<pcl::PointXYZ>());
-            pcl::FPFHEstimation<pcl::PointXYZ, pcl::Normal, pcl::FPFHSignature33> fpfh;
+            pcl::FPFHEstimationOMP<pcl::PointXYZ, pcl::Normal, pcl::FPFHSignature33> fpfh(std::max(1u, std::thread::hardware_concurrency()));
 
             fpfh.setSearchMethod(tree);
 
@@ -406,139 +740,312 @@ namespace GLObject
             m_FPFHsDynamic = std::make_shared<pcl::PointCloud<pcl::FPFHSignature33>>();
             m_FPFHsStatic = std::make_shared<pcl::PointCloud<pcl::FPFHSignature33>>();
 
-            // Use all neighbors in a sphere of radius 5cm
             // IMPORTANT: the radius used here has to be larger than the radius used to estimate the surface normals!!!
-            fpfh.setRadiusSearch(0.05);
+            fpfh.setRadiusSearch(m_FPFHRadius);
 
             // Compute the features
             fpfh.setInputCloud(m_SIFTKPStatic);
+            fpfh.setSearchSurface(m_CloudStatic);
             fpfh.setInputNormals(m_NormalsStatic);
             fpfh.compute(*m_FPFHsStatic);
 
             fpfh.setInputCloud(m_SIFTKPDynamic);
+            fpfh.setSearchSurface(m_CloudDynamic);
             fpfh.setInputNormals(m_NormalsDynamic);
             fpfh.compute(*m_FPFHsDynamic);
 
             mp_Logger->log("FPFH found " + std::to_string(m_FPFHsStatic->size()) + " descriptors (static)");
             mp_Logger->log("FPFH found " + std::to_string(m_FPFHsDynamic->size()) + " descriptors (dynamic)");
         }
-        {
+    }
+
+    void PointCloud::findCorrespondence()
+    {
+        PROFILE_FUNCTION();
+        // The model matrix moves camera 0 into the frame of camera 1, so the static cloud is the source
+        pcl::registration::CorrespondenceEstimation<pcl::FPFHSignature33, pcl::FPFHSignature33> estimation;
+        estimation.setInputSource(m_FPFHsStatic);
+        estimation.setInputTarget(m_FPFHsDynamic);
+
+        m_Correspondences = std::make_shared<pcl::Correspondences>();
+        estimation.determineReciprocalCorrespondences(*m_Correspondences);
+
+        mp_Logger->log("Found " + std::to_string(m_Correspondences->size()) + " correspondences");
+    }
+
+    void PointCloud::rejectCorrespondence()
+    {
+        PROFILE_FUNCTION();
+        pcl::registration::CorrespondenceRejectorSampleConsensus<pcl::PointXYZ> rejector;
+        rejector.setInputSource(m_SIFTKPStatic);
+        rejector.setInputTarget(m_SIFTKPDynamic);
+        rejector.setInlierThreshold(m_InlierThreshold);
+        rejector.setMaximumIterations(m_RANSACIterations);
+        rejector.setRefineModel(false);
+        rejector.setInputCorrespondences(m_Correspondences);
+
+        m_Inliers = std::make_shared<pcl::Correspondences>();
+        rejector.getCorrespondences(*m_Inliers);
+
+        mp_Logger->log("RANSAC kept " + std::to_string(m_Inliers->size()) + "/" + std::to_string(m_Correspondences->size()) + " correspondences");
+    }
 
+    bool PointCloud::estimateTransformation(glm::mat4& model)
+    {
+        PROFILE_FUNCTION();
+        if (m_Inliers->size() < 3) {
+            mp_Logger->log("Not enough correspondences to estimate a transformation", Logger::Priority::WARN);
+            return false;
         }
+
+        pcl::registration::TransformationEstimationSVD<pcl::PointXYZ, pcl::PointXYZ> svd;
+        Eigen::Matrix4f transformation;
+        svd.estimateRigidTransformation(*m_SIFTKPStatic, *m_SIFTKPDynamic, *m_Inliers, transformation);
+
+        for (int col = 0; col < 4; col++)
+            for (int row = 0; row < 4; row++)
+                model[col][row] = transformation(row, col);
+
+        return true;
     }
 
-    /*
-    void PointCloud::alignPointcloudsNDT() {
-       
-        
-        // Initializing Normal Distributions Transform (NDT).
-        pcl::NormalDistributionsTransform<pcl::PointXYZ, pcl::PointXYZ> ndt;
-
-        // Setting scale dependent NDT parameters
-        // Setting minimum transformation difference for termination condition.
-        //ndt.setTransformationEpsilon(m_TransformationEpsilon);
-        // Setting maximum step size for More-Thuente line search.
-        //ndt.setStepSize(m_StepSize);
-        //Setting Resolution of NDT grid structure (VoxelGridCovariance).
-        //ndt.setResolution(m_Resolution);
-        
-        // Setting max number of registration iterations.
-        //ndt.setMaximumIterations(m_MaxIterations);
-        
-        // Setting point cloud to be aligned.
-        ndt.setInputSource(filtered_cloud_dynamic);
-        // Setting point cloud to be aligned to.
-        ndt.setInputTarget(m_CloudStatic);
+    //
+    // Online ICP
+    //
+    void PointCloud::trackExtrinsics()
+    {
+        if (m_CameraCount < 2 || !m_DepthCameras[0]->m_IsEnabled || !m_DepthCameras[1]->m_IsEnabled)
+            return;
+
+        // Warm start from the current extrinsics, camera 0 is moved into the frame of camera 1
+        glm::mat4 model = getRelativeModel(0, 1);
+        const auto& result = m_ICPTracker.track(m_Points[0].get(), m_StreamWidths[0], m_StreamHeights[0],
+                                                m_Points[1].get(), m_StreamWidths[1], m_StreamHeights[1], m_Intrinsics[1],
+                                                model);
+
+        if (result.Updated) {
+            setRelativeModel(model, 0, 1);
+            m_Registered = true;
+        }
+    }
 
-        glm::mat4 model{ 1.0f };
+    void PointCloud::showTracking()
+    {
+        if (!ImGui::TreeNode("ICP Tracking"))
+            return;
 
-        model = glm::eulerAngleYXZ(m_Rotation.y, m_Rotation.x, m_Rotation.z);
-        model = glm::translate(model, m_Translation);
+        ImGui::BeginDisabled(m_CameraCount < 2);
+        ImGui::Checkbox("Track Extrinsics", &m_TrackExtrinsics);
+        ImGui::EndDisabled();
 
-        Eigen::Matrix4f init_guess;
+        auto& params = m_ICPTracker.getParameters();
+        ImGui::InputInt("Source Stride", &params.SourceStride);
+        ImGui::InputInt("Max Iterations##ICP", &params.MaxIterations);
+        ImGui::InputFloat("Max Distance (in m)", &params.MaxDistance, 0.01f);
+        ImGui::InputFloat("Budget (in ms)", &params.BudgetMs, 0.5f);
 
-        for (int x = 0; x < 4; x++) {
-            for (int y = 0; y < 4; y++) {
-                init_guess(x, y) = model[x][y];
-            }
+        const auto& result = m_ICPTracker.getResult();
+        ImGui::Text("%d iterations, %d inliers, RMSE %.2f mm, %.2f ms%s",
+                    result.Iterations, result.Inliers, result.RMSE * 1000.0f, result.Milliseconds, result.Converged ? ", converged" : "");
+
+        ImGui::TreePop();
+    }
+
+    //
+    // NDT
+    //
+    void PointCloud::alignPointcloudsNDT()
+    {
+        PROFILE_FUNCTION();
+        if (m_CameraCount < 2)
+            return;
+
+        m_VoxelGrid.setLeafSize(m_LeafSize);
+
+        // The grid is reused while the reference frame is unchanged, a kept reference is only rebuilt if the resolutions changed
+        const auto hash = NDTAligner::hashFrame(m_Points[0].get(), m_NumElements[0]);
+        const bool keep = m_KeepNDTReference && m_NDT.hasTarget() && m_NDT.isTargetValid(m_NDT.getTargetHash());
+        if (!keep && !m_NDT.isTargetValid(hash)) {
+            m_NDT.setTarget(m_VoxelGrid.filter(m_Points[0].get(), m_NumElements[0]).Centroids, hash);
+            mp_Logger->log("Built NDT reference grid");
+        }
+
+        // NDT moves camera 1 onto the reference, the inverse moves camera 0 into the frame of camera 1
+        const auto& source = m_VoxelGrid.filter(m_Points[1].get(), m_NumElements[1]).Centroids;
+        glm::mat4 transformation = getRelativeModel(1, 0);
+        const auto& result = m_NDT.align(source, transformation);
+
+        mp_Logger->log("Normal Distributions Transform " + (std::string)(result.Converged ? "converged" : "did not converge") +
+                       " after " + std::to_string(result.Iterations) + " iterations in " + std::to_string(result.Milliseconds) +
+                       " ms, score: " + std::to_string(result.Score));
+
+        if (result.Iterations > 0) {
+            setRelativeModel(glm::inverse(transformation), 0, 1);
+            m_Registered = true;
         }
-        
-        // Calculating required rigid transform to align the input cloud to the target cloud.
-        pcl::PointCloud<pcl::PointXYZ>::Ptr output_cloud(new pcl::PointCloud<pcl::PointXYZ>);
-        ndt.align(*output_cloud, init_guess);
-        
-        mp_Logger->log("Normal Distributions Transform has converged: " + std::to_string(ndt.hasConverged()) + " score: " + std::to_string(ndt.getFitnessScore()) + " In " + std::to_string(ndt.getFinalNumIteration()) + "/" + std::to_string(m_MaxIterations) + " Iterations");
-        
-        auto transform = Eigen::Affine3f(ndt.getFinalTransformation());
-        pcl::getTranslationAndEulerAngles(transform,
-            m_Translation.x, m_Translation.y, m_Translation.z,
-            m_Rotation.x, m_Rotation.y, m_Rotation.z);
     }
 
-    void PointCloud::alignPointclouds()
+    void PointCloud::showNDT()
     {
-        if (!m_ICPInitialised) {
-            m_State.setState(PointCloudStreamState::ICP);
-            m_CloudStatic = std::make_shared<pcl::PointCloud<pcl::PointXYZ>>(m_NumElements[0], 1);
+        if (!ImGui::TreeNode("NDT"))
+            return;
 
-            for (int i = 0; i < m_NumElements[0]; i++) {
-                auto p = &(m_CloudStatic.get()->at(i));
-                auto point = m_Points[0][i].getPoint();
-                p->x = point.x;
-                p->y = point.y;
-                p->z = point.z;
-            }
+        auto& params = m_NDT.getParameters();
+
+        ImGui::BeginDisabled(m_RegistrationThread.joinable() || m_CameraCount < 2);
+        ImGui::InputFloat("Transformation Epsilon", &params.TransformationEpsilon, 0.0001f, 0.001f, "%.4f");
+        ImGui::InputInt("Max Iterations", &params.MaxIterations);
+
+        // Coarse to fine, every level halves the cell size
+        float finest = params.Resolutions.back();
+        int levels = (int)params.Resolutions.size();
+        bool changed = ImGui::InputFloat("Resolution (in m)", &finest, 0.05f);
+        changed |= ImGui::SliderInt("Levels", &levels, 1, 5);
+        if (changed && finest > 0.0f) {
+            params.Resolutions.resize(levels);
+            for (int i = 0; i < levels; i++)
+                params.Resolutions[i] = finest * (float)(1 << (levels - 1 - i));
+        }
+
+        ImGui::Checkbox("Keep Reference", &m_KeepNDTReference);
+        ImGuiHelper::HelpMarker("Keep the reference grid even though the reference camera sees a different frame, e.g. while it is static but noisy");
+        ImGui::SameLine();
+        if (ImGui::Button("Rebuild Reference"))
+            m_NDT.resetTarget();
+
+        if (ImGui::Button("Align (NDT)"))
+            alignPointcloudsNDT();
+        ImGui::EndDisabled();
+
+        ImGui::TreePop();
+    }
+
+    //
+    // Registration job
+    //
+    void PointCloud::startRegistration()
+    {
+        if (m_RegistrationThread.joinable() || m_CameraCount < 2)
+            return;
+
+        // The worker reads the vertex data, it must not be streamed into while the job runs
+        m_State.setState(PointCloudStreamState::REGISTRATION);
+        m_NormalsCalculated = false;
+
+        m_RegistrationCancelled = false;
+        m_RegistrationDone = false;
+        m_RegistrationSucceeded = false;
+        m_RegistrationProgress = 0.0f;
+        m_RegistrationStage = "Starting";
 
-            m_ICP.setInputSource(m_CloudStatic);
-            m_ICPInitialised = true;
-            m_AlignmentMode = true;
+        m_RegistrationThread = std::thread(&PointCloud::runRegistration, this);
+    }
+
+    void PointCloud::cancelRegistration()
+    {
+        if (!m_RegistrationThread.joinable())
+            return;
+
+        m_RegistrationCancelled = true;
+        m_RegistrationThread.join();
+
+        if (!m_RegistrationDone)
+            mp_Logger->log("Registration cancelled", Logger::Priority::WARN);
+
+        m_RegistrationDone = false;
+        m_State.setState(PointCloudStreamState::STREAM);
+    }
+
+    bool PointCloud::setRegistrationStage(const char* stage, float progress)
+    {
+        m_RegistrationStage = stage;
+        m_RegistrationProgress = progress;
+        return !m_RegistrationCancelled;
+    }
+
+    void PointCloud::runRegistration()
+    {
+        PROFILE_THREAD("Registration");
+        PROFILE_FUNCTION();
+
+        try {
+            if (setRegistrationStage("Filtering", 0.0f))
+                filterData();
+            if (setRegistrationStage("Normals", 0.1f))
+                computeNormals();
+            if (setRegistrationStage("Keypoints", 0.2f))
+                estimateKeyPoints();
+            if (setRegistrationStage("Descriptors", 0.5f))
+                describeKeyPoints();
+            if (setRegistrationStage("Correspondences", 0.7f))
+                findCorrespondence();
+            if (setRegistrationStage("Rejection", 0.8f))
+                rejectCorrespondence();
+            if (setRegistrationStage("Transformation", 0.95f))
+                m_RegistrationSucceeded = estimateTransformation(m_RegistrationModel);
+        }
+        catch (const std::exception& e) {
+            mp_Logger->log((std::string)"Registration failed: " + e.what(), Logger::Priority::ERR);
+            m_RegistrationSucceeded = false;
         }
 
-        if (m_IsAligned) {
-            // Set the max correspondence distance to 5cm (e.g., correspondences with higher
-            // distances will be ignored)
-            m_ICP.setMaxCorrespondenceDistance(0.5);
-            // Set the maximum number of iterations (criterion 1)
-            m_ICP.setMaximumIterations(100);
-            // Set the transformation epsilon (criterion 2)
-            m_ICP.setTransformationEpsilon(1e-8);
-            // Set the euclidean distance difference epsilon (criterion 3)
-            m_ICP.setEuclideanFitnessEpsilon(1);
+        setRegistrationStage("Done", 1.0f);
+        m_RegistrationDone.store(true, std::memory_order_release);
+    }
 
-            m_CloudDynamic = std::make_shared<pcl::PointCloud<pcl::PointXYZ>>(m_NumElements[1], 1);
+    void PointCloud::finishRegistration()
+    {
+        if (!m_RegistrationDone.load(std::memory_order_acquire))
+            return;
 
-            glm::mat4 model{ 1.0f };
+        m_RegistrationThread.join();
+        m_RegistrationDone = false;
 
-            model = glm::eulerAngleYXZ(m_Rotation.y, m_Rotation.x, m_Rotation.z);
-            model = glm::translate(model, m_Translation);
+        if (m_RegistrationSucceeded && !m_RegistrationCancelled) {
+            setRelativeModel(m_RegistrationModel, 0, 1);
+            m_IsAligned = true;
+            m_Registered = true;
+            mp_Logger->log("Registration finished");
+        }
 
-            Eigen::Matrix4f eigen_model;
+        m_State.setState(PointCloudStreamState::STREAM);
+    }
 
-            for (int x = 0; x < 4; x++) {
-                for (int y = 0; y < 4; y++) {
-                    eigen_model(x, y) = model[x][y];
-                }
-            }
+    void PointCloud::showRegistration()
+    {
+        finishRegistration();
 
-            for (int i = 0; i < m_NumElements[1]; i++) {
-                if (m_Points[1][i].Depth == 0.0f)
-                    continue;
-                auto p = &(m_CloudDynamic.get()->at(i));
-                auto point = m_Points[1][i].getPoint();
-                p->x = point.x;
-                p->y = point.y;
-                p->z = point.z;
-            }
-            pcl::transformPointCloud(*m_CloudDynamic.get(), *m_CloudDynamic.get(), eigen_model);
-            m_ICP.setInputTarget(m_CloudDynamic);
-
-            pcl::PointCloud<pcl::PointXYZ> final;
-            m_ICP.align(final);
-
-            auto transform = Eigen::Affine3f(m_ICP.getFinalTransformation());
-            pcl::getTranslationAndEulerAngles(transform,
-                                              m_Translation.x, m_Translation.y, m_Translation.z,
-                                              m_Rotation.x, m_Rotation.y, m_Rotation.z );
-        }   
-    }*/
+        if (!ImGui::TreeNode("Feature Based"))
+            return;
+
+        const bool running = m_RegistrationThread.joinable();
+
+        ImGui::BeginDisabled(running);
+        ImGui::InputFloat("Leaf filter size (in m)", &m_LeafSize, 0.01f);
+
+        ImGui::Checkbox("Use SIFT", &m_UseSIFT);
+
+        ImGui::BeginDisabled(!m_UseSIFT);
+        ImGui::InputFloat("Min Scale", &m_MinScale);
+        ImGui::InputInt("N Octaves", &m_NOctaves);
+        ImGui::InputInt("N ScalesPerOctave", &m_NScalesPerOctave);
+        ImGui::InputFloat("Min Contrast", &m_MinContrast);
+        ImGui::EndDisabled();
+
+        ImGui::InputFloat("FPFH Radius (in m)", &m_FPFHRadius, 0.01f);
+        ImGui::InputFloat("Inlier Threshold (in m)", &m_InlierThreshold, 0.01f);
+        ImGui::InputInt("RANSAC Iterations", &m_RANSACIterations, 1000);
+
+        if (ImGui::Button("Register Cameras"))
+            startRegistration();
+        ImGui::EndDisabled();
+
+        if (running) {
+            ImGui::ProgressBar(m_RegistrationProgress.load(), { -FLT_MIN, 0 }, m_RegistrationStage.load());
+            if (ImGui::Button("Cancel"))
+                cancelRegistration();
+        }
+
+        ImGui::TreePop();
+    }
 }
\ No newline at end of file
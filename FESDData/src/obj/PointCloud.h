@@ -1,6 +1,8 @@
 #pragma once
 #include <array>
+#include <atomic>
 #include <memory>
+#include <thread>
 #include <unordered_map>
 #include <type_traits>
 
@@ -20,6 +22,7 @@
 
 // Describing keypoints - Feature descriptors
 #include <pcl/features/fpfh.h>
+#include <pcl/features/fpfh_omp.h>
 #include <pcl/features/normal_3d.h>
 #include <pcl/features/our_cvfh.h>
 #include <pcl/features/principal_curvatures.h>
@@ -39,14 +42,18 @@
 // Transformation Estimation
 #include <pcl/registration/transformation_estimation_svd.h>
 
-#include <pcl/filters/approximate_voxel_grid.h>
-
 
 #include "cameras/DepthCamera.h"
 #include "Logger.h"
+#include "ICPTracker.h"
+#include "NDTAligner.h"
 #include "Point.h"
+#include "BackgroundModel.h"
 #include "BoundingBox.h"
+#include "DepthStatistics.h"
+#include "OrganizedNormals.h"
 #include "PointCloudStreamState.h"
+#include "VoxelGrid.h"
 #include "utilities/GLUtil.h"
 
 namespace GLObject
@@ -56,6 +63,7 @@ namespace GLObject
 	public:
 		// Constructor
 		PointCloud(std::vector<DepthCamera*> depthCameras, const Camera *cam, Logger::Logger* logger, Renderer *renderer);
+		~PointCloud();
 		
 		// Updates
 		void OnUpdate() override;
@@ -64,28 +72,120 @@ namespace GLObject
 		void OnImGuiRender() override;
 		void manipulateTranslation();
 
-		Json::Value getRotation();
-		Json::Value getTranslation();
+		/// <summary>
+		/// Pose of a camera in the common frame, by default camera 0 is moved into the frame of camera 1
+		/// </summary>
+		Json::Value getRotation(int cam_index = 0);
+		Json::Value getTranslation(int cam_index = 0);
+		void setRotation(const Json::Value& rotation, int cam_index = 0);
+		void setTranslation(const Json::Value& translation, int cam_index = 0);
+		/// <summary>
+		/// Whether a registration (feature based, NDT or ICP tracking) moved the cameras since resetRegistered
+		/// </summary>
+		bool isRegistered() const { return m_Registered; }
+		void resetRegistered() { m_Registered = false; }
+
+		// Has to match MAX_CAMERAS in PointCloud.vert
+		static constexpr int MaxCameras{ 16 };
+
+		/// <summary>
+		/// Convert a raw depth frame into the vertex data of a single camera
+		/// </summary>
+		static void streamDepth(Point* points, int width, int height, const int16_t* depth, float metersPerUnit, int cam_index);
+		/// <summary>
+		/// Write the indices of all pixels with a valid depth on every stride-th row and column, blocks of rows are counted and written in parallel
+		/// </summary>
+		/// <param name="offset">Added to every index, the offset of the camera in the vertex buffer</param>
+		/// <param name="meanDepth">Mean depth of the emitted pixels, 0 if there are none</param>
+		/// <returns>Number of indices written</returns>
+		/// <param name="mask">Optional, only pixels with a non zero mask are written</param>
+		static int compactIndices(const Point* points, int width, int height, int stride, unsigned int offset, unsigned int* indices, float* meanDepth = nullptr, const uint8_t* mask = nullptr);
+
+		/// <summary>
+		/// Learn the background of every camera from the following frames, e.g. during the countdown
+		/// </summary>
+		void startBackgroundLearning();
+		void finishBackgroundLearning();
+		/// <summary>
+		/// Bounding box of the subject in the orientation of the depth frame of the camera, the whole frame if no background was learned
+		/// </summary>
+		BackgroundModel::Region getSubjectRegion(int cam_index) const;
+
+		/// <summary>
+		/// Statistics of the last streamed depth frame of a camera
+		/// </summary>
+		const FrameStatistics& getStatistics(int cam_index) const { return m_Statistics[cam_index].getResult(); }
+		const BoundingBox& getBoundingBox(int cam_index) const { return m_BoundingBoxes[cam_index]; }
+		/// <summary>
+		/// Transformation from the camera into the common frame of the point cloud
+		/// </summary>
+		glm::mat4 getCameraModel(int cam_index) const { return getModel(cam_index); }
 	private:
 		void pauseStream();
 		void resumeStream();
 
+		glm::mat4 getModel(int cam_index = 0) const;
+		void setModel(const glm::mat4& model, int cam_index = 0);
+		/// <summary>
+		/// Transformation from a camera into the frame of another camera, the registration methods estimate these
+		/// </summary>
+		glm::mat4 getRelativeModel(int cam_index, int reference) const;
+		void setRelativeModel(const glm::mat4& model, int cam_index, int reference);
+
 		void streamDepth(int cam_index, const int16_t* depth);
 
+		/// 
+		/// Index compaction
+		/// 
+
+		/// <summary>
+		/// Rebuild the index buffer from the valid pixels of all cameras, so holes are not drawn at the camera origin
+		/// </summary>
+		void updateIndices();
+		/// <summary>
+		/// Decimation stride from the distance of the viewer to the closest cloud
+		/// </summary>
+		int getLODStride() const;
+		void showLOD();
+
+		std::vector<unsigned int> m_Indices;
+		int m_IndexCount{ 0 };
+		bool m_IndicesOutdated{ true };
+		std::vector<float> m_MeanDepths;
+
+		/// 
+		/// Background
+		/// 
+
+		void showBackground();
+		void showStatistics();
+
+		std::vector<BackgroundModel> m_Backgrounds;
+		bool m_CullBackground{ true };
+
+		bool m_UseLOD{ true };
+		float m_LODDistance{ 4.0f };	// Every multiple of this distance (in m) increases the stride by one
+		int m_MaxLODStride{ 4 };
+		int m_LODStride{ 1 };
+
 		pcl::PointCloud<pcl::PointXYZ>::Ptr m_CloudStatic;
 		pcl::PointCloud<pcl::PointXYZ>::Ptr m_CloudDynamic;
 
-		void acquireData();
-
 		float m_LeafSize{ 0.01f };
+		VoxelGrid m_VoxelGrid{ };
+		std::vector<VoxelCloud> m_Voxels{ };
 
 		void filterData();
+		pcl::PointCloud<pcl::PointXYZ>::Ptr filterCloud(int cam_index);
 		
 		bool m_NormalsCalculated{ false };
 		pcl::PointCloud<pcl::Normal>::Ptr m_NormalsStatic;
 		pcl::PointCloud<pcl::Normal>::Ptr m_NormalsDynamic;
+		OrganizedNormals m_NormalEstimator{ };
+		bool m_ShadeNormals{ false };
 
 		void computeNormals();
+		pcl::PointCloud<pcl::Normal>::Ptr computeNormals(int cam_index);
 
 		// SIFT
 		bool m_UseSIFT{ true };
@@ -99,6 +199,7 @@ namespace GLObject
 		void estimateKeyPoints();
 		
 		// FPFHE
+		float m_FPFHRadius{ 0.05f };
 		pcl::PointCloud<pcl::FPFHSignature33>::Ptr m_FPFHsDynamic;
 		pcl::PointCloud<pcl::FPFHSignature33>::Ptr m_FPFHsStatic;
 
@@ -118,6 +219,7 @@ namespace GLObject
 		pcl::registration::CorrespondenceEstimationNormalShooting< PointSource, PointTarget, NormalT, Scalar >
 		*/
 		void findCorrespondence();
+		pcl::CorrespondencesPtr m_Correspondences;
 
 		/*
 		pcl::registration::CorrespondenceRejectorSampleConsensus< PointT >
@@ -126,24 +228,75 @@ namespace GLObject
 		pcl::registration::CorrespondenceRejectorPoly< SourceT, TargetT >
 		*/
 		void rejectCorrespondence();
+		float m_InlierThreshold{ 0.05f };
+		int m_RANSACIterations{ 10000 };
+		pcl::CorrespondencesPtr m_Inliers;
+
+		bool estimateTransformation(glm::mat4& model);
+
+		/// 
+		/// Registration job
+		/// 
+
+		/// <summary>
+		/// Run the feature based registration on a worker thread, the stream is paused until the job finished
+		/// </summary>
+		void startRegistration();
+		/// <summary>
+		/// Cancellation is checked between the stages of the pipeline
+		/// </summary>
+		void cancelRegistration();
+		void runRegistration();
+		bool setRegistrationStage(const char* stage, float progress);
+		void finishRegistration();
+		void showRegistration();
+
+		std::thread m_RegistrationThread;
+		std::atomic<bool> m_RegistrationCancelled{ false };
+		std::atomic<bool> m_RegistrationDone{ false };
+		std::atomic<float> m_RegistrationProgress{ 0.0f };
+		std::atomic<const char*> m_RegistrationStage{ "" };
+		bool m_RegistrationSucceeded{ false };
+		glm::mat4 m_RegistrationModel{ 1.0f };
+
+		/// 
+		/// NDT
+		/// 
+
+		/// <summary>
+		/// Align camera 1 to the grid of camera 0, the grid is only rebuilt for a new reference frame
+		/// </summary>
+		void alignPointcloudsNDT();
+		void showNDT();
+
+		NDTAligner m_NDT{ };
+		bool m_KeepNDTReference{ false };	// Override, the grid is otherwise rebuilt whenever the reference frame changes
+
+		/// 
+		/// Online ICP
+		/// 
+		
+		void trackExtrinsics();
+		void showTracking();
 
-		//void alignPointcloudsNDT();
-		//void alignPointclouds();
+		bool m_TrackExtrinsics{ false };
+		ICPTracker m_ICPTracker{ };
 
 		Logger::Logger* mp_Logger;
 
 		PointCloudStreamState m_State{ };
 
 		std::vector<DepthCamera*> m_DepthCameras;
-		std::vector<glm::mat4> m_MVPS{};
 		const int m_CameraCount{ };
 
 		std::vector<std::shared_ptr<Point[]>> m_Points;
 
 		GLUtil m_GLUtil{ };
 
-		glm::vec3 m_Rotation{ 0 };
-		glm::vec3 m_Translation{ 0 };
+		std::vector<glm::vec3> m_Rotations;
+		std::vector<glm::vec3> m_Translations;
+		std::vector<glm::mat4> m_Models;	// Uploaded to the uniform buffer every frame
+		static constexpr unsigned int CameraModelsBinding{ 0 };
 		float m_Scale{ 1.0f };
 
 		int m_NumElementsTotal{ 0 };
@@ -151,17 +304,15 @@ namespace GLObject
 		std::vector<int> m_ElementOffset;
 		std::vector<int> m_StreamWidths;
 		std::vector<int> m_StreamHeights;
+		std::vector<glm::vec4> m_Intrinsics;	// fx, fy, cx, cy
 
-		std::vector<BoundingBox> m_BoundingBoxes{ };
+		std::vector<DepthStatistics> m_Statistics{ };
+		std::vector<BoundingBox> m_BoundingBoxes{ };	// Of the last frame, from the statistics
 		std::vector<glm::vec3> m_CellSizes{ };
 
 		bool m_AlignmentMode{ false };
 		bool m_ICPInitialised{ false };
 		bool m_IsAligned{ false };
-
-		float m_TransformationEpsilon{ 0.01 };
-		float m_StepSize{ 0.1 };
-		float m_Resolution{ 0.5 };
-		int m_MaxIterations{ 50 };
+		bool m_Registered{ false };
 	};
 };
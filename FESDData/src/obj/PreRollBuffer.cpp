@@ -0,0 +1,95 @@
+#include "PreRollBuffer.h"
+
+#include "utilities/Profiler.h"
+
+void PreRollBuffer::push(double timestamp, const cv::Mat& color, const cv::Mat& depth, const Json::Value& data)
+{
+    PROFILE_FUNCTION();
+    if (m_Params.Seconds <= 0.0f)
+        return;
+
+    EncodedFrame entry = std::move(m_Spare);
+    m_Spare = EncodedFrame{ };
+    entry.Timestamp = timestamp;
+    entry.ColorSize = color.size();
+    entry.DepthSize = depth.size();
+    entry.Data = data;
+
+    // imencode only resizes the vectors, their capacity is kept from the dropped frame
+    entry.Color.clear();
+    entry.Depth.clear();
+    if (!color.empty())
+        cv::imencode(".jpg", color, entry.Color, { cv::IMWRITE_JPEG_QUALITY, m_Params.JpegQuality });
+    if (!depth.empty())
+        cv::imencode(".png", depth, entry.Depth, { cv::IMWRITE_PNG_COMPRESSION, m_Params.PngCompression });
+
+    m_Bytes += entry.getBytes();
+    m_Entries.push_back(std::move(entry));
+
+    while (m_Entries.size() > 1 && timestamp - m_Entries.front().Timestamp > m_Params.Seconds)
+        dropOldest();
+
+    while (!m_Entries.empty() && m_Bytes > m_Params.ByteBudget) {
+        dropOldest();
+        m_Dropped++;
+    }
+}
+
+void PreRollBuffer::dropOldest()
+{
+    m_Bytes -= m_Entries.front().getBytes();
+    m_Spare = std::move(m_Entries.front());
+    m_Entries.pop_front();
+}
+
+int PreRollBuffer::flush(const std::function<void(const Frame&)>& sink)
+{
+    PROFILE_FUNCTION();
+    int frames = 0;
+    Frame frame;
+    while (!m_Entries.empty()) {
+        // Decoded into the same matrices for every frame
+        decode(m_Entries.front(), frame);
+        sink(frame);
+        frames++;
+        dropOldest();
+    }
+
+    return frames;
+}
+
+std::vector<PreRollBuffer::EncodedFrame> PreRollBuffer::take()
+{
+    std::vector<EncodedFrame> frames;
+    frames.reserve(m_Entries.size());
+    for (auto& entry : m_Entries)
+        frames.push_back(std::move(entry));
+
+    m_Entries.clear();
+    m_Bytes = 0;
+    return frames;
+}
+
+void PreRollBuffer::decode(const EncodedFrame& encoded, Frame& frame, bool decodeColor)
+{
+    PROFILE_FUNCTION();
+    frame.Timestamp = encoded.Timestamp;
+    frame.Data = encoded.Data;
+
+    if (encoded.Color.empty() || !decodeColor)
+        frame.Color.release();
+    else
+        cv::imdecode(encoded.Color, cv::IMREAD_COLOR, &frame.Color);
+
+    if (encoded.Depth.empty())
+        frame.Depth.release();
+    else
+        cv::imdecode(encoded.Depth, cv::IMREAD_ANYDEPTH, &frame.Depth);
+}
+
+void PreRollBuffer::clear()
+{
+    m_Entries.clear();
+    m_Bytes = 0;
+    m_Dropped = 0;
+}
@@ -0,0 +1,87 @@
+#pragma once
+#include <cstdint>
+#include <deque>
+#include <functional>
+#include <vector>
+
+#include <opencv2/opencv.hpp>
+#include <json/json.h>
+
+/// <summary>
+/// Keeps the last seconds of a camera compressed in memory, so a recording can include what happened before it was started.
+/// Colour is JPEG and depth lossless 16 bit PNG encoded. The oldest frames are dropped once the buffer spans more than the duration
+/// or its encoded frames exceed the byte budget, the encode buffers of dropped frames are reused.
+/// </summary>
+class PreRollBuffer
+{
+public:
+	struct Parameters
+	{
+		float Seconds{ 2.0f };
+		size_t ByteBudget{ 64ull * 1024 * 1024 };
+		int JpegQuality{ 90 };
+		int PngCompression{ 1 };	// Fastest zlib level, depth compresses well regardless
+	};
+
+	struct Frame
+	{
+		double Timestamp{ 0.0 };	// As passed to push (in s)
+		cv::Mat Color{ };
+		cv::Mat Depth{ };
+		Json::Value Data{ };		// E.g. the skeletons detected in the frame
+	};
+
+	/// <summary>
+	/// Frame as kept in the buffer
+	/// </summary>
+	struct EncodedFrame
+	{
+		double Timestamp{ 0.0 };
+		cv::Size ColorSize{ };
+		cv::Size DepthSize{ };
+		std::vector<uchar> Color{ };
+		std::vector<uchar> Depth{ };
+		Json::Value Data{ };
+
+		size_t getBytes() const { return Color.size() + Depth.size(); }
+	};
+
+	PreRollBuffer() = default;
+	explicit PreRollBuffer(Parameters params) : m_Params(params) { }
+
+	Parameters& getParameters() { return m_Params; }
+
+	/// <summary>
+	/// Compress a frame into the buffer and drop the frames which no longer fit
+	/// </summary>
+	void push(double timestamp, const cv::Mat& color, const cv::Mat& depth, const Json::Value& data = { });
+	/// <summary>
+	/// Decode the frames oldest first and empty the buffer
+	/// </summary>
+	/// <returns>Number of frames passed to the sink</returns>
+	int flush(const std::function<void(const Frame&)>& sink);
+	/// <summary>
+	/// Move the compressed frames out oldest first and empty the buffer, e.g. to decode them on another thread
+	/// </summary>
+	std::vector<EncodedFrame> take();
+	/// <summary>
+	/// Decode a frame, the matrices of the frame are reused
+	/// </summary>
+	static void decode(const EncodedFrame& encoded, Frame& frame, bool decodeColor = true);
+	void clear();
+
+	int getFrames() const { return (int)m_Entries.size(); }
+	size_t getBytes() const { return m_Bytes; }
+	double getDuration() const { return m_Entries.empty() ? 0.0 : m_Entries.back().Timestamp - m_Entries.front().Timestamp; }
+	/// <returns>Frames dropped for the byte budget before they were older than the duration</returns>
+	uint64_t getDropped() const { return m_Dropped; }
+private:
+	void dropOldest();
+
+	Parameters m_Params{ };
+
+	std::deque<EncodedFrame> m_Entries{ };
+	EncodedFrame m_Spare{ };	// Last dropped entry, its buffers take the next frame
+	size_t m_Bytes{ 0 };
+	uint64_t m_Dropped{ 0 };
+};
@@ -1,4 +1,5 @@
 #pragma once
+#include <algorithm>
 #include <chrono>
 #include <vector>
 #include <queue>
@@ -56,6 +57,23 @@ public:
 		ImGui::Checkbox("Estimate Skeleton", &EstimateSkeleton);
 		ImGuiHelper::HelpMarker("Estimate the skeleton while recording.");
 
+		ImGui::BeginDisabled(!EstimateSkeleton);
+		ImGui::SliderInt("Keyframe Stride", &KeyframeStride, 1, 30);
+		ImGuiHelper::HelpMarker("Only every n-th frame is stored with the full colour and depth, every frame keeps its timestamp and skeleton.");
+		ImGui::Checkbox("Adaptive Keyframes", &AdaptiveKeyframes);
+		ImGuiHelper::HelpMarker("Additionally store a full frame whenever the image changed noticeably since the last one.");
+		ImGui::Checkbox("Low Resolution Depth", &LowResDepth);
+		ImGui::BeginDisabled(!LowResDepth);
+		ImGui::SliderInt("Depth Downscale", &LowResDepthScale, 2, 8);
+		ImGui::EndDisabled();
+		ImGuiHelper::HelpMarker("Store a downscaled depth frame for the frames in between keyframes.");
+		ImGui::SliderFloat("Pre-Roll in S", &PreRollInS, 0.0f, 5.0f, "%.1f");
+		ImGuiHelper::HelpMarker("Keep the last seconds of the countdown compressed in memory and store them at the start of the recording, their timestamps are negative. 0 to disable.");
+		ImGui::EndDisabled();
+
+		ImGui::Checkbox("Segment Subject", &SegmentSubject);
+		ImGuiHelper::HelpMarker("Learn the background during the countdown, only the region around the subject is recorded, rendered and searched for skeletons. Nobody should stand in front of the cameras during the countdown.");
+
 		ImGui::Checkbox("Stream", &StreamWhileRecording);
 		ImGuiHelper::HelpMarker("Show the Live Pointcloud while recording, this might decrease performance.");
 		
@@ -115,6 +133,11 @@ public:
 		val["Cramped"] = Cramped;
 		val["Dark Clothing"] = DarkClothing;
 		val["Exercise"] = selectedExercises.front().Id;
+		val["Segment Subject"] = SegmentSubject;
+		val["Keyframe Stride"] = KeyframeStride;
+		val["Adaptive Keyframes"] = AdaptiveKeyframes;
+		val["Low Resolution Depth"] = LowResDepth ? LowResDepthScale : 0;
+		val["Pre-Roll"] = EstimateSkeleton ? PreRollInS : 0.0f;
 
 		return val;
 	}
@@ -198,10 +221,26 @@ public:
 		return false;
 	}
 
+	/// <returns>Number of frames a recording is limited to at this frame rate, 0 if it is not limited</returns>
+	int getExpectedFrames(int framesPerSecond) const {
+		int frames = 0;
+		if (LimitTime && TimeLimitInS > 0)
+			frames = TimeLimitInS * framesPerSecond;
+		if (LimitFrames && FrameLimit > 0)
+			frames = frames > 0 ? std::min(frames, FrameLimit) : FrameLimit;
+
+		return frames;
+	}
+
 	bool cancelRecording() {
 		return CancelRecording;
 	}
 
+	/// <returns>true if the current recording is the last repetition of the last exercise</returns>
+	bool isLastRecording() const {
+		return Repetitions + 1 >= RepeatNTimes && selectedExercises.size() <= 1;
+	}
+
 	/// <returns>true if all repetitions are done</returns>
 	bool stopRecording(std::chrono::duration<double> duration) {
 		m_RecordingLenghts.push_back(duration);
@@ -223,6 +262,12 @@ public:
 	bool LimitFrames{ false };
 	bool LimitTime{ true };
 	bool EstimateSkeleton{ true };
+	bool SegmentSubject{ false };
+	int KeyframeStride{ 10 };
+	bool AdaptiveKeyframes{ false };
+	bool LowResDepth{ true };
+	int LowResDepthScale{ 4 };
+	float PreRollInS{ 0.0f };
 	int RepeatNTimes{ 2 };
 	int Repetitions{ 0 };
 	int TotalExercises{ 0 };
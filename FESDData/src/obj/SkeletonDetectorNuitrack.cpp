@@ -1,9 +1,16 @@
 #include "SkeletonDetectorNuitrack.h"
 
+#include <algorithm>
+#include <chrono>
+#include <memory>
+#include <thread>
 #include <vector>
 
 #include "Error.h"
 #include "utilities/Consts.h"
+#include "utilities/FrameIO.h"
+#include "utilities/FramePool.h"
+#include "utilities/Profiler.h"
 #include "utilities/Utils.h"
 
 using namespace tdv::nuitrack;
@@ -45,6 +52,7 @@ SkeletonDetectorNuitrack::SkeletonDetectorNuitrack(Logger::Logger* logger, std::
 
 SkeletonDetectorNuitrack::~SkeletonDetectorNuitrack()
 {
+	stopPreRoll();
 	Nuitrack::release();
 }
 
@@ -53,9 +61,24 @@ std::string SkeletonDetectorNuitrack::getFrameName(int frame)
 	return "frame_" + std::to_string(frame);
 }
 
+std::string SkeletonDetectorNuitrack::getDepthFrameName(int frame)
+{
+	return "depth_" + std::to_string(frame);
+}
+
+int SkeletonDetectorNuitrack::getKeyframeIndex(const Json::Value& keyframes, int sample)
+{
+	if (keyframes.isArray() && sample >= 0 && sample < (int)keyframes.size())
+		return keyframes[sample].asInt();
+
+	return sample * 10;
+}
+
 void SkeletonDetectorNuitrack::freeCameras()
 {
+	stopPreRoll();
 	Nuitrack::release();
+	m_Running = false;
 }
 
 
@@ -88,25 +111,44 @@ Json::Value SkeletonDetectorNuitrack::getCameraJson()
 
 	camera["FileName"] = (m_FramePath.parent_path().filename() / m_FramePath.filename()).string();
 
+	// Frames only contain the region around the subject, they are pasted into a frame of the full size when reading
+	camera["Cropped"] = m_CropToSubject;
+	if (m_CropToSubject) {
+		camera["Width"] = m_FrameWidth;
+		camera["Height"] = m_FrameHeight;
+		camera["Regions"] = m_Regions;
+	}
+
+	// Frames which are not listed only have a timestamp and a skeleton, and a downscaled depth frame if the scale is set
+	camera["Keyframes"] = m_Keyframes;
+	camera["LowResDepthScale"] = m_LowResDepthScale;
+
+	// The first frames were captured before the recording started, their timestamps are negative
+	camera["PreRollFrames"] = m_PreRollFrames;
+
 	return camera;
 }
 
 bool SkeletonDetectorNuitrack::startRecording(std::string sessionName)
 {
-	auto devices = Nuitrack::getDeviceList();
-	Nuitrack::setDevice(devices[0]);
+	// Nuitrack keeps running between the recordings of a session, only the output files change
+	if (!m_Running) {
+		auto devices = Nuitrack::getDeviceList();
+		Nuitrack::setDevice(devices[0]);
 
-	// Create Tracker
-	m_ColorSensor = ColorSensor::create();
-	m_DepthSensor = DepthSensor::create();
-	m_SkeletonTracker = SkeletonTracker::create();
+		// Create Tracker
+		m_ColorSensor = ColorSensor::create();
+		m_DepthSensor = DepthSensor::create();
+		m_SkeletonTracker = SkeletonTracker::create();
 
-	try {
-		Nuitrack::run();
-	}
-	catch (const Exception& e) {
-		mp_Logger->log("Error running Nuitrack: " + std::to_string(*e.what()), Logger::Priority::ERR);
-		return false;
+		try {
+			Nuitrack::run();
+		}
+		catch (const Exception& e) {
+			mp_Logger->log("Error running Nuitrack: " + std::to_string(*e.what()), Logger::Priority::ERR);
+			return false;
+		}
+		m_Running = true;
 	}
 
 	m_RecordingPath = m_RecordingDirectory / sessionName;
@@ -116,15 +158,36 @@ bool SkeletonDetectorNuitrack::startRecording(std::string sessionName)
 	std::filesystem::create_directory(m_FramePath);
 
 	m_CSVRec = std::fstream{ m_RecordingPath / "Timestamps.csv", std::ios::out };
-	m_CSVRec << "frame_index,timestamp" << std::endl;
+	m_CSVRec << "frame_index,timestamp,keyframe," << FrameStatistics::getCSVHeader() << std::endl;
 	m_Frame = 0;
+	m_Regions = Json::Value{ Json::arrayValue };
+	m_Keyframes = Json::Value{ Json::arrayValue };
+	m_KeyframeScheduler.reset();
+	m_FrameWriter.start();
+	m_FramesReserved = false;
+	stopPreRoll();
+	m_PreRoll.clear();
+	m_PreRollFrames = 0;
 
 	return true;
 }
 
 bool SkeletonDetectorNuitrack::update(double time_stamp, bool save) {	
+	PROFILE_FUNCTION();
+	cv::Mat colorMat, depthMat;
+	Json::Value people;
+	if (!waitForFrame(colorMat, depthMat, people))
+		return false;
+
+	storeFrame(time_stamp, colorMat, depthMat, people, save);
+	return true;
+}
+
+bool SkeletonDetectorNuitrack::waitForFrame(cv::Mat& colorMat, cv::Mat& depthMat, Json::Value& people)
+{
 	// Update Tracker
 	try {
+		PROFILE_SCOPE("Nuitrack::waitUpdate");
 		Nuitrack::update();
 		Nuitrack::waitUpdate(m_SkeletonTracker);
 	}
@@ -138,38 +201,25 @@ bool SkeletonDetectorNuitrack::update(double time_stamp, bool save) {
 	}
 
 	auto colorFrame = m_ColorSensor->getColorFrame();
-	void* color = (void*)colorFrame->getData();
 	auto depthFrame = m_DepthSensor->getDepthFrame();
-	void* depth = (void*)depthFrame->getData();
 
 	if (colorFrame == nullptr || depthFrame == nullptr) {
 		mp_Logger->log("No Color or depth", Logger::Priority::ERR);
 		return false;
 	}
 
-	cv::Mat colorMat(cv::Size{ colorFrame->getCols(), colorFrame->getRows() }, CV_8UC3, color);
-	colorMat.convertTo(colorMat, CV_16FC3); // Convert to Float matrix to enable merging
-	colorMat /= 255.0; // Normalise values to be between 0 and 1
-	
-	cv::Mat depthMat(cv::Size{ depthFrame->getCols(), depthFrame->getRows() }, CV_16UC1, depth);
-	depthMat.convertTo(depthMat, CV_16FC1);
-	depthMat /= 1000.f; // Convert units to meters
+	// Views of the Nuitrack frames, valid until the next update
+	colorMat = cv::Mat(cv::Size{ colorFrame->getCols(), colorFrame->getRows() }, CV_8UC3, (void*)colorFrame->getData());
+	depthMat = cv::Mat(cv::Size{ depthFrame->getCols(), depthFrame->getRows() }, CV_16UC1, (void*)depthFrame->getData());
 
-	std::vector<cv::Mat> channels;
-	cv::split(colorMat, channels);
-	channels.push_back(depthMat);
-	
-	cv::Mat fin;
-	cv::merge(channels, fin);
-	fin.convertTo(fin, CV_16F);
-	if (save) {
-		m_Frames.push_back(fin);
-	}
+	// Nuitrack depth is in mm, the filtered frame is valid until the next frame as well
+	if (m_DepthFilter.isEnabled())
+		depthMat = cv::Mat(depthMat.size(), CV_16UC1, (void*)m_DepthFilter.apply((const uint16_t*)depthMat.data, depthMat.cols, depthMat.rows, 0.001f));
 
 	// Retrieve Skeleton Data	
 	const std::vector<Skeleton> skeletons = m_SkeletonTracker->getSkeletons()->getSkeletons();
 	
-	Json::Value people{};
+	people = Json::Value{ };
 	for (const Skeleton& skeleton : skeletons) {
 		Json::Value person_json;
 		Json::Value skeleton_json;
@@ -199,46 +249,289 @@ bool SkeletonDetectorNuitrack::update(double time_stamp, bool save) {
 		person_json["Skeleton"] = skeleton_json;
 		people.append(person_json);
 	}
+
+	return true;
+}
+
+void SkeletonDetectorNuitrack::storeFrame(double time_stamp, cv::Mat colorMat, cv::Mat depthMat, const Json::Value& people, bool save)
+{
+	PROFILE_FUNCTION();
+	const void* depth = depthMat.data;
+	m_FrameWidth = depthMat.cols;
+	m_FrameHeight = depthMat.rows;
+
+	// The first live frame tells the size of the frames
+	if (save && !m_FramesReserved)
+		reserveFrames(colorMat, depthMat);
+
+	// Decided on the whole frame, so the motion of the subject is compared between the same regions
+	const bool keyframe = save && m_KeyframeScheduler.update(colorMat);
+
+	// Only the region around the subject is converted and stored, the whole frame if the subject was not found
+	const uint8_t* mask = nullptr;
+	cv::Rect roi{ 0, 0, depthMat.cols, depthMat.rows };
+	if (m_CropToSubject && m_BackgroundModel.isReady() && colorMat.size() == depthMat.size()) {
+		mask = m_BackgroundModel.segment((const uint16_t*)depth, depthMat.cols, depthMat.rows, 0.001f).data();
+		auto region = m_BackgroundModel.getRegion();
+		if (!region.empty())
+			roi = { region.X, region.Y, region.Width, region.Height };
+
+		colorMat = colorMat(roi);
+		depthMat = depthMat(roi);
+	}
+
+	// Every saved frame has a region, the whole frame while the background is not learned yet, so the regions stay aligned with the frames
+	if (save && m_CropToSubject) {
+		Json::Value region_json;
+		region_json.append(roi.x);
+		region_json.append(roi.y);
+		region_json.append(roi.width);
+		region_json.append(roi.height);
+		m_Regions.append(region_json);
+	}
+
+	if (save)
+		m_Statistics.compute((const uint16_t*)depth, m_FrameWidth, m_FrameHeight, 0.001f, m_Intrinsics, mask);
+
+	if (keyframe) {
+		// Stored as captured, depth in mm and colour in 8 bit. The writer copies the planes, so they can point into the Nuitrack frames
+		std::vector<FrameIO::Plane> planes{ { FrameIO::PlaneId::Depth, depthMat, 0.001f }, { FrameIO::PlaneId::Color, colorMat, 1.0f / 255.0f } };
+		if (mask)
+			planes.push_back({ FrameIO::PlaneId::Mask, cv::Mat(m_FrameHeight, m_FrameWidth, CV_8UC1, (void*)mask)(roi), 1.0f });
+
+		m_FrameWriter.write(m_FramePath / (getFrameName(m_Frame) + ".bin"), planes);
+		m_Keyframes.append(m_Frame);
+	}
+	else if (save && m_LowResDepthScale > 1) {
+		const cv::Size size{ std::max(1, cvRound(depthMat.cols / (double)m_LowResDepthScale)), std::max(1, cvRound(depthMat.rows / (double)m_LowResDepthScale)) };
+		if (m_LowResDepth.cols < size.width || m_LowResDepth.rows < size.height)
+			m_LowResDepth = FramePool::getInstance().acquire(size.height, size.width, CV_16UC1);
+
+		// Kept in mm, nearest neighbour so no depth is invented at the edges of the body. The size of the region changes from frame to frame,
+		// it is resized into a part of the buffer instead of allocating a new one
+		cv::Mat lowResDepth = m_LowResDepth(cv::Rect{ 0, 0, size.width, size.height });
+		cv::resize(depthMat, lowResDepth, size, 0.0, 0.0, cv::INTER_NEAREST);
+		m_FrameWriter.write(m_FramePath / (getDepthFrameName(m_Frame) + ".bin"), { { FrameIO::PlaneId::Depth, lowResDepth, 0.001f } });
+	}
+
 	m_Skeletons.append(people);
 
 	if (save) {
-		m_CSVRec << m_Frame << "," << time_stamp << std::endl;
+		m_CSVRec << m_Frame << "," << time_stamp << "," << keyframe << "," << m_Statistics.getResult().toCSV() << std::endl;
 		m_Frame += 1;
 	}
+}
 
-	return true;
+void SkeletonDetectorNuitrack::setPreRoll(float seconds)
+{
+	stopPreRoll();
+	m_PreRoll.getParameters().Seconds = seconds;
+	m_PreRoll.clear();
 }
 
-std::string SkeletonDetectorNuitrack::stopRecording()
+void SkeletonDetectorNuitrack::startPreRoll()
 {
-	m_CSVRec.close();
+	stopPreRoll();
+	if (!m_Running || (m_PreRoll.getParameters().Seconds <= 0.0f && !m_BackgroundModel.isLearning()))
+		return;
 
-	for (int i = 0; i < m_Frames.size(); i++) {
-		std::cout << i << "/" << m_Frames.size() << " Frames stored!\r";
-		std::ofstream fs((m_FramePath / (getFrameName(i) + ".bin")).string(), std::fstream::binary);
+	m_PreRoll.clear();
+	m_PreRollThread = std::jthread([this](std::stop_token stop) { runPreRoll(stop); });
+}
 
-		// Header
-		int type = m_Frames[i].type();
-		int channels = m_Frames[i].channels();
-		fs.write((char*)&m_Frames[i].rows, sizeof(int));    // rows
-		fs.write((char*)&m_Frames[i].cols, sizeof(int));    // cols
-		fs.write((char*)&type, sizeof(int));				// type
-		fs.write((char*)&channels, sizeof(int));    // channels
+void SkeletonDetectorNuitrack::stopPreRoll()
+{
+	if (!m_PreRollThread.joinable())
+		return;
 
-		// Data
-		if (m_Frames[i].isContinuous())
-		{
-			fs.write(m_Frames[i].ptr<char>(0), (m_Frames[i].dataend - m_Frames[i].datastart));
+	m_PreRollThread.request_stop();
+	m_PreRollThread.join();
+}
+
+void SkeletonDetectorNuitrack::runPreRoll(std::stop_token stop)
+{
+	PROFILE_THREAD("Pre-Roll");
+	while (!stop.stop_requested()) {
+		// Without pre-roll only the depth is needed
+		if (m_PreRoll.getParameters().Seconds <= 0.0f) {
+			if (!learnBackground())
+				std::this_thread::sleep_for(std::chrono::milliseconds(10));
+			continue;
 		}
-		else
-		{
-			int rowsz = CV_ELEM_SIZE(type) * m_Frames[i].cols;
-			for (int r = 0; r < m_Frames[i].rows; ++r)
-			{
-				fs.write(m_Frames[i].ptr<char>(r), rowsz);
-			}
+
+		cv::Mat colorMat, depthMat;
+		Json::Value people;
+		if (!waitForFrame(colorMat, depthMat, people)) {
+			std::this_thread::sleep_for(std::chrono::milliseconds(10));
+			continue;
 		}
-		/*cv::FileStorage frameStorage ((m_FramePath / (getFrameName(i) + ".yml")).string(), cv::FileStorage::WRITE);
+
+		// The countdown frames are also the ones the background is learned from, Nuitrack depth is in mm
+		if (m_BackgroundModel.isLearning())
+			m_BackgroundModel.learn((const uint16_t*)depthMat.data, depthMat.cols, depthMat.rows, 0.001f);
+
+		const double time_stamp = std::chrono::duration<double>(std::chrono::system_clock::now().time_since_epoch()).count();
+		m_PreRoll.push(time_stamp, colorMat, depthMat, people);
+	}
+}
+
+int SkeletonDetectorNuitrack::flushPreRoll(double start_time)
+{
+	PROFILE_FUNCTION();
+	stopPreRoll();
+
+	const auto dropped = m_PreRoll.getDropped();
+	const double duration = m_PreRoll.getDuration();
+	auto frames = m_PreRoll.take();
+
+	// Only the bookkeeping happens here, the keyframes are chosen by the stride alone. Their statistics are left empty,
+	// the frames are only decoded on the I/O thread.
+	const int stride = std::max(1, m_KeyframeScheduler.getParameters().Stride);
+	const int scale = m_LowResDepthScale;
+	for (int i = 0; i < frames.size(); i++) {
+		auto encoded = std::make_shared<PreRollBuffer::EncodedFrame>(std::move(frames[i]));
+		const bool keyframe = i % stride == 0;
+
+		if (keyframe) {
+			m_FrameWriter.write(m_FramePath / (getFrameName(m_Frame) + ".bin"), [encoded]() {
+				PreRollBuffer::Frame frame;
+				PreRollBuffer::decode(*encoded, frame);
+				return std::vector<FrameIO::Plane>{ { FrameIO::PlaneId::Depth, frame.Depth, 0.001f }, { FrameIO::PlaneId::Color, frame.Color, 1.0f / 255.0f } };
+			});
+			m_Keyframes.append(m_Frame);
+		}
+		else if (scale > 1) {
+			m_FrameWriter.write(m_FramePath / (getDepthFrameName(m_Frame) + ".bin"), [encoded, scale]() {
+				PreRollBuffer::Frame frame;
+				PreRollBuffer::decode(*encoded, frame, false);
+
+				cv::Mat lowResDepth;
+				cv::resize(frame.Depth, lowResDepth, { }, 1.0 / scale, 1.0 / scale, cv::INTER_NEAREST);
+				return std::vector<FrameIO::Plane>{ { FrameIO::PlaneId::Depth, lowResDepth, 0.001f } };
+			});
+		}
+
+		// Stored uncropped, the background was still being learned
+		if (m_CropToSubject) {
+			Json::Value region_json;
+			region_json.append(0);
+			region_json.append(0);
+			region_json.append(encoded->DepthSize.width);
+			region_json.append(encoded->DepthSize.height);
+			m_Regions.append(region_json);
+		}
+
+		m_Skeletons.append(encoded->Data);
+		m_CSVRec << m_Frame << "," << encoded->Timestamp - start_time << "," << keyframe << "," << FrameStatistics{ }.toCSV() << std::endl;
+		m_Frame += 1;
+	}
+
+	m_PreRollFrames = (int)frames.size();
+	if (m_PreRollFrames > 0)
+		mp_Logger->log("Recording " + std::to_string(m_PreRollFrames) + " frames (" + std::to_string(duration) + " s) from before the start");
+	if (dropped > 0)
+		mp_Logger->log(std::to_string(dropped) + " pre-roll frames were dropped to stay within the memory budget", Logger::Priority::WARN);
+
+	return m_PreRollFrames;
+}
+
+void SkeletonDetectorNuitrack::setRecordingPolicy(KeyframeScheduler::Parameters keyframes, int lowResDepthScale, int expectedFrames)
+{
+	m_KeyframeScheduler = KeyframeScheduler{ keyframes };
+	m_LowResDepthScale = lowResDepthScale;
+	m_ExpectedFrames = expectedFrames;
+}
+
+void SkeletonDetectorNuitrack::reserveFrames(const cv::Mat& color, const cv::Mat& depth)
+{
+	m_FramesReserved = true;
+	std::vector<FrameIO::Plane> keyframe{ { FrameIO::PlaneId::Depth, depth }, { FrameIO::PlaneId::Color, color } };
+	if (m_CropToSubject)
+		keyframe.push_back({ FrameIO::PlaneId::Mask, cv::Mat(depth.size(), CV_8UC1) });
+	const size_t keyframeBytes = FrameIO::getPlanarSize(keyframe);
+
+	size_t depthBytes = 0;
+	if (m_LowResDepthScale > 1) {
+		// Large enough for the whole frame, the regions of cropped frames use a part of it
+		const int scale = m_LowResDepthScale;
+		m_LowResDepth = FramePool::getInstance().acquire((depth.rows + scale - 1) / scale, (depth.cols + scale - 1) / scale, CV_16UC1);
+		depthBytes = FrameIO::getPlanarSize({ { FrameIO::PlaneId::Depth, m_LowResDepth } });
+	}
+
+	// Buffers for the first two seconds, the writer allocates more up to its budget if the disk falls behind
+	const int stride = std::max(1, m_KeyframeScheduler.getParameters().Stride);
+	const int buffered = 2 * FramesPerSecond;
+	m_FrameWriter.reserve(keyframeBytes, (buffered + stride - 1) / stride);
+	if (depthBytes > 0)
+		m_FrameWriter.reserve(depthBytes, buffered);
+
+	if (m_ExpectedFrames <= 0)
+		return;
+
+	const int keyframes = (m_ExpectedFrames + stride - 1) / stride;
+	const uint64_t sessionBytes = (uint64_t)keyframeBytes * keyframes + (uint64_t)depthBytes * (m_ExpectedFrames - keyframes);
+
+	std::error_code ec;
+	const auto space = std::filesystem::space(m_FramePath, ec);
+	if (!ec && space.available < sessionBytes)
+		mp_Logger->log("The session needs about " + std::to_string(sessionBytes >> 20) + " MB but only " + std::to_string(space.available >> 20) + " MB are free", Logger::Priority::WARN);
+}
+
+void SkeletonDetectorNuitrack::startBackgroundLearning()
+{
+	m_BackgroundModel.startLearning();
+}
+
+bool SkeletonDetectorNuitrack::learnBackground()
+{
+	PROFILE_FUNCTION();
+	if (!m_BackgroundModel.isLearning())
+		return false;
+
+	try {
+		Nuitrack::update();
+		Nuitrack::waitUpdate(m_DepthSensor);
+	}
+	catch (const Exception& ex) {
+		mp_Logger->log(ex.what(), Logger::Priority::ERR);
+		return false;
+	}
+
+	auto depthFrame = m_DepthSensor->getDepthFrame();
+	if (depthFrame == nullptr)
+		return false;
+
+	// Nuitrack depth is in mm, learned from the same filtered depth that is segmented later
+	const uint16_t* depth = depthFrame->getData();
+	if (m_DepthFilter.isEnabled())
+		depth = m_DepthFilter.apply(depth, depthFrame->getCols(), depthFrame->getRows(), 0.001f);
+
+	m_BackgroundModel.learn(depth, depthFrame->getCols(), depthFrame->getRows(), 0.001f);
+	return true;
+}
+
+void SkeletonDetectorNuitrack::finishBackgroundLearning()
+{
+	if (!m_BackgroundModel.isLearning())
+		return;
+
+	m_BackgroundModel.finishLearning();
+	mp_Logger->log("Learned the background from " + std::to_string(m_BackgroundModel.getLearnedFrames()) + " frames");
+}
+
+std::string SkeletonDetectorNuitrack::stopRecording()
+{
+	PROFILE_FUNCTION();
+	m_CSVRec.close();
+
+	// Only the frames still queued are written here, the writer keeps its buffers for the next recording
+	m_FrameWriter.stop();
+	const auto writer = m_FrameWriter.getStatistics();
+	if (writer.Failed > 0)
+		mp_Logger->log(std::to_string(writer.Failed) + " frames could not be written", Logger::Priority::ERR);
+
+	/*for (int i = 0; i < m_Frames.size(); i++) {
+		cv::FileStorage frameStorage ((m_FramePath / (getFrameName(i) + ".yml")).string(), cv::FileStorage::WRITE);
 		try {
 			frameStorage.write("frame", m_Frames[i]);
 		}
@@ -246,9 +539,8 @@ std::string SkeletonDetectorNuitrack::stopRecording()
 		{
 			mp_Logger->log(e.msg, Logger::Priority::ERR);
 		}
-		frameStorage.release();*/
-	}
-	m_Frames.clear();
+		frameStorage.release();
+	}*/
 
 	mp_Logger->log("All frames stored!");
 
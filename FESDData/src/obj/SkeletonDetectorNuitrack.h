@@ -1,22 +1,40 @@
 #pragma once
 #include <filesystem>
 #include <fstream>
+#include <thread>
+#include <utility>
+#include <vector>
 
 #include <glm/glm.hpp>
 #include <nuitrack/Nuitrack.h>
 #include <opencv2/opencv.hpp>
 #include <json/json.h>
 
+#include "BackgroundModel.h"
+#include "DepthFilter.h"
+#include "DepthStatistics.h"
+#include "KeyframeTracker.h"
 #include "Logger.h"
+#include "PreRollBuffer.h"
+#include "utilities/FrameIO.h"
+#include "utilities/FrameWriter.h"
 
 class SkeletonDetectorNuitrack
 {
 public:
+	static constexpr int FramesPerSecond{ 30 };	// Of the default Nuitrack configuration
+
 	SkeletonDetectorNuitrack(Logger::Logger* logger, glm::mat3 intrinsics);
 	SkeletonDetectorNuitrack(Logger::Logger* logger, std::string recordingPath, std::string camera_type);
 	~SkeletonDetectorNuitrack();
 
 	static std::string getFrameName(int frame);
+	static std::string getDepthFrameName(int frame);
+	/// <summary>
+	/// Index of the recorded frame a sample of the dataset is stored in, recordings without a keyframe index store every 10th frame
+	/// </summary>
+	/// <param name="keyframes">"Keyframes" of the camera json</param>
+	static int getKeyframeIndex(const Json::Value& keyframes, int sample);
 	void freeCameras();
 
 	static std::string getJointName(int joint_id);
@@ -26,24 +44,110 @@ public:
 	bool startRecording(std::string sessionName);
 	bool update(double times_tamp, bool save = true);
 	std::string stopRecording();
+
+	/// <summary>
+	/// Learn the background from the depth frames until finishBackgroundLearning, the frames are captured by startPreRoll
+	/// </summary>
+	void startBackgroundLearning();
+	void finishBackgroundLearning();
+	/// <summary>
+	/// Only store the region around the subject of every frame, the region of every frame is part of the camera json
+	/// </summary>
+	void setCropToSubject(bool crop) { m_CropToSubject = crop; }
+	/// <summary>
+	/// Filter the depth before it is segmented and stored, with the settings of the depth camera Nuitrack replaces
+	/// </summary>
+	void setDepthFilter(DepthFilter::Parameters params) { m_DepthFilter = DepthFilter{ params }; }
+	/// <summary>
+	/// Only keyframes are stored with the full colour and depth, the other frames keep their timestamp, statistics and skeleton.
+	/// The indices of the keyframes are part of the camera json.
+	/// </summary>
+	/// <param name="lowResDepthScale">Frames in between keyframes store their depth downscaled by this factor, 0 to not store them</param>
+	/// <param name="expectedFrames">Length of the session the disk space is checked for, 0 if it is not limited</param>
+	void setRecordingPolicy(KeyframeScheduler::Parameters keyframes, int lowResDepthScale, int expectedFrames = 0);
+
+	FrameWriter::Statistics getWriterStatistics() const { return m_FrameWriter.getStatistics(); }
+
+	/// <summary>
+	/// Keep the last seconds before the recording starts, 0 to disable
+	/// </summary>
+	void setPreRoll(float seconds);
+	/// <summary>
+	/// Capture frames on a thread of its own during the countdown, into the pre-roll buffer and the background model.
+	/// Does nothing if neither the pre-roll nor the background learning is enabled.
+	/// </summary>
+	void startPreRoll();
+	/// <summary>
+	/// Stop capturing, has to be called before Nuitrack is used by the calling thread again
+	/// </summary>
+	void stopPreRoll();
+	/// <summary>
+	/// Stop capturing and store the frames of the pre-roll buffer as the first frames of the recording. They are decoded and written
+	/// on the I/O thread of the frame writer, the number of pre-roll frames is part of the camera json.
+	/// </summary>
+	/// <param name="start_time">Start of the recording in seconds since epoch, the clock of the pre-roll timestamps</param>
+	/// <returns>Number of frames stored</returns>
+	int flushPreRoll(double start_time);
 private:
+	/// <summary>
+	/// Wait for the next frame of Nuitrack, the matrices point into the Nuitrack frames
+	/// </summary>
+	bool waitForFrame(cv::Mat& colorMat, cv::Mat& depthMat, Json::Value& people);
+	/// <summary>
+	/// Store a frame and its skeletons according to the recording policy
+	/// </summary>
+	void storeFrame(double time_stamp, cv::Mat colorMat, cv::Mat depthMat, const Json::Value& people, bool save);
+	/// <summary>
+	/// Allocate the buffers of the frame writer for frames of this size and check the disk space of the session
+	/// </summary>
+	void reserveFrames(const cv::Mat& color, const cv::Mat& depth);
+	void runPreRoll(std::stop_token stop);
+	bool learnBackground();
+
 	Logger::Logger* mp_Logger;
 
 	std::filesystem::path m_RecordingPath;
 	std::filesystem::path m_FramePath;
 
+	bool m_Running{ false };	// Set once the sensors are created, they are kept until freeCameras
 	int m_Frame{ 0 };
+	bool m_FramesReserved{ false };
 	float m_MetersPerUnit{ };
 
 	std::fstream m_CSVRec{ };
 	Json::Value m_Skeletons{ };
-	std::vector<cv::Mat> m_Frames{ };
+	FrameWriter m_FrameWriter{ };	// Keyframes and low resolution depth are written while recording
+	cv::Mat m_LowResDepth{ };		// From the frame pool, sized for the whole frame in reserveFrames
 	glm::mat3 m_Intrinsics{ };
 
+	// Recording policy, by default every frame is a keyframe
+	KeyframeScheduler m_KeyframeScheduler{ KeyframeScheduler::Parameters{ 1, false } };
+	int m_LowResDepthScale{ 0 };
+	int m_ExpectedFrames{ 0 };
+	Json::Value m_Keyframes{ };
+
+	// Last seconds before the start of the recording
+	PreRollBuffer m_PreRoll{ };
+	DepthFilter m_DepthFilter{ };
+	int m_PreRollFrames{ 0 };
+
+	// Subject segmentation
+	BackgroundModel m_BackgroundModel{ };
+	bool m_CropToSubject{ false };
+	int m_FrameWidth{ 0 };
+	int m_FrameHeight{ 0 };
+	Json::Value m_Regions{ };
+
+	// Written next to the timestamp of every frame
+	DepthStatistics m_Statistics{ };
+
     // Skeleton Tracker
     tdv::nuitrack::ColorSensor::Ptr m_ColorSensor;
     tdv::nuitrack::DepthSensor::Ptr m_DepthSensor;
     tdv::nuitrack::SkeletonTracker::Ptr m_SkeletonTracker;
     tdv::nuitrack::SkeletonData::Ptr m_SkeletonData;
+
+	// Last member, it is stopped before anything it uses is destroyed
+	std::jthread m_PreRollThread{ };
 };
 
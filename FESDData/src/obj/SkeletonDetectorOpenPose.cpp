@@ -7,6 +7,7 @@
 
 #include "Error.h"
 #include "utilities/Consts.h"
+#include "utilities/Profiler.h"
 #include "utilities/Utils.h"
 
 SkeletonDetectorOpenPose::SkeletonDetectorOpenPose(Logger::Logger* logger) : mp_Logger(logger)
@@ -18,6 +19,7 @@ SkeletonDetectorOpenPose::SkeletonDetectorOpenPose(Logger::Logger* logger) : mp_
 
 op::Array<float> SkeletonDetectorOpenPose::calculateSkeleton(cv::Mat frame_to_process)
 {
+    PROFILE_FUNCTION();
     const op::Matrix imageToProcess = OP_CV2OPCONSTMAT(frame_to_process);
     auto datumProcessed = m_OPWrapper.emplaceAndPop(imageToProcess);
     if (datumProcessed != nullptr) {
@@ -32,8 +34,9 @@ op::Array<float> SkeletonDetectorOpenPose::calculateSkeleton(cv::Mat frame_to_pr
     }
 }
 
-void SkeletonDetectorOpenPose::drawSkeleton(cv::Mat& frame_to_process, float score_threshold, bool show_uncertainty)
+Json::Value SkeletonDetectorOpenPose::drawSkeleton(cv::Mat& frame_to_process, float score_threshold, bool show_uncertainty)
 {
+    PROFILE_FUNCTION();
     auto key_points = calculateSkeleton(frame_to_process);
 
     const auto numberPeopleDetected = key_points.getSize(0);
@@ -57,18 +60,76 @@ void SkeletonDetectorOpenPose::drawSkeleton(cv::Mat& frame_to_process, float sco
             }
         }
     }
+
+    return getPeople(key_points);
 }
 
 void SkeletonDetectorOpenPose::startRecording(std::string sessionName)
 {
     m_RecordingPath = m_RecordingDirectory / sessionName / "OPSkeleton.json";
     m_Skeletons.clear();
+
+    m_QueuedFrames = 0;
+    m_NextQueued = 0;
+    m_NextStored = 0;
+    m_Finished.clear();
 }
 
 void SkeletonDetectorOpenPose::saveFrame(cv::Mat frame_to_process)
 {
-    auto key_points = calculateSkeleton(frame_to_process);
+    PROFILE_FUNCTION();
+    m_Skeletons.append(getPeople(calculateSkeleton(frame_to_process)));
+}
+
+void SkeletonDetectorOpenPose::queueFrame(const cv::Mat& frame_to_process)
+{
+    PROFILE_FUNCTION();
+    while (m_QueuedFrames >= m_FramesInFlight && popFrame()) { }
+
+    // The frame is copied, the camera reuses its buffer for the next frame while this one is still in flight
+    const cv::Mat frame = frame_to_process.clone();
+    const op::Matrix imageToProcess = OP_CV2OPCONSTMAT(frame);
+
+    auto datums = std::make_shared<std::vector<std::shared_ptr<op::Datum>>>();
+    datums->emplace_back(std::make_shared<op::Datum>());
+    datums->at(0)->cvInputData = imageToProcess;
+    datums->at(0)->frameNumber = m_NextQueued;
 
+    if (!m_OPWrapper.waitAndEmplace(datums)) {
+        mp_Logger->log("Frame could not be queued.", Logger::Priority::ERR);
+        m_Finished[m_NextQueued++] = Json::Value{ };
+        return;
+    }
+
+    m_NextQueued++;
+    m_QueuedFrames++;
+}
+
+bool SkeletonDetectorOpenPose::popFrame()
+{
+    PROFILE_FUNCTION();
+    std::shared_ptr<std::vector<std::shared_ptr<op::Datum>>> datums;
+    if (!m_OPWrapper.waitAndPop(datums) || datums == nullptr || datums->empty()) {
+        mp_Logger->log("Frame could not be processed.", Logger::Priority::ERR);
+        return false;
+    }
+
+    m_QueuedFrames--;
+    const auto& datum = datums->at(0);
+    m_Finished[datum->frameNumber] = getPeople(datum->poseKeypoints);
+
+    // Results are stored in the order of the frames, even if the wrapper finishes them out of order
+    for (auto it = m_Finished.find(m_NextStored); it != m_Finished.end(); it = m_Finished.find(m_NextStored)) {
+        m_Skeletons.append(it->second);
+        m_Finished.erase(it);
+        m_NextStored++;
+    }
+
+    return true;
+}
+
+Json::Value SkeletonDetectorOpenPose::getPeople(const op::Array<float>& key_points)
+{
     const auto numberPeopleDetected = key_points.getSize(0);
     const auto numberBodyParts = key_points.getSize(1);
 
@@ -95,11 +156,30 @@ void SkeletonDetectorOpenPose::saveFrame(cv::Mat frame_to_process)
         p["Skeleton"] = skeleton;
         people.append(p);
     }
-    m_Skeletons.append(people);
+    return people;
+}
+
+Json::Value& SkeletonDetectorOpenPose::finishFrames()
+{
+    PROFILE_FUNCTION();
+    while (m_QueuedFrames > 0 && popFrame()) { }
+
+    // Frames which got lost keep their place, so the skeletons stay aligned with the frames
+    for (; m_NextStored < m_NextQueued; m_NextStored++) {
+        auto it = m_Finished.find(m_NextStored);
+        m_Skeletons.append(it != m_Finished.end() ? it->second : Json::Value{ });
+    }
+    m_Finished.clear();
+    m_QueuedFrames = 0;
+
+    return m_Skeletons;
 }
 
 std::string SkeletonDetectorOpenPose::stopRecording()
 {
+    PROFILE_FUNCTION();
+    finishFrames();
+
     std::fstream configJson(m_RecordingPath, std::ios::out | std::ios::trunc);
     Json::Value root;
     root["Skeletons"] = m_Skeletons;
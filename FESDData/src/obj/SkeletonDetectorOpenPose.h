@@ -1,5 +1,7 @@
 #pragma once
+#include <algorithm>
 #include <filesystem>
+#include <map>
 
 #include <openpose/headers.hpp>
 #include <openpose/filestream/fileStream.hpp>
@@ -15,17 +17,47 @@ public:
 	SkeletonDetectorOpenPose(Logger::Logger *logger);
 
 	op::Array<float> calculateSkeleton(cv::Mat frame_to_process);
-	void drawSkeleton(cv::Mat &frame_to_process, float score_threshold = 0.0f, bool show_uncertainty = false);
+	/// <summary>
+	/// Detect and draw the skeletons into the frame
+	/// </summary>
+	/// <returns>The detected people, see getPeople</returns>
+	Json::Value drawSkeleton(cv::Mat &frame_to_process, float score_threshold = 0.0f, bool show_uncertainty = false);
 
 	void startRecording(std::string sessionName);
 	void saveFrame(cv::Mat frame_to_process);
+	/// <summary>
+	/// Queue a frame into the wrapper without waiting for its result, at most getFramesInFlight frames are processed at once.
+	/// The results are stored in the order the frames were queued, stopRecording waits for the remaining ones.
+	/// </summary>
+	void queueFrame(const cv::Mat& frame_to_process);
+	/// <summary>
+	/// Wait for all frames in flight
+	/// </summary>
+	/// <returns>The skeletons of all frames so far, they can be edited before stopRecording writes them</returns>
+	Json::Value& finishFrames();
 	std::string stopRecording();
+
+	int getFramesInFlight() const { return m_FramesInFlight; }
+	void setFramesInFlight(int frames) { m_FramesInFlight = std::max(1, frames); }
 private:
+	static Json::Value getPeople(const op::Array<float>& key_points);
+	/// <summary>
+	/// Wait for one result of the wrapper and store all results that are next in order
+	/// </summary>
+	bool popFrame();
+
 	Logger::Logger *mp_Logger;
 
 	op::Wrapper m_OPWrapper{ op::ThreadManagerMode::Asynchronous };
 	std::filesystem::path m_RecordingPath;
 
 	Json::Value m_Skeletons{ };
+
+	// Pipelined processing
+	int m_FramesInFlight{ 4 };
+	int m_QueuedFrames{ 0 };
+	unsigned long long m_NextQueued{ 0 };
+	unsigned long long m_NextStored{ 0 };
+	std::map<unsigned long long, Json::Value> m_Finished{ };	// Results which arrived before the ones of earlier frames
 };
 
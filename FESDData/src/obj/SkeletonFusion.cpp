@@ -0,0 +1,258 @@
+#include "SkeletonFusion.h"
+
+#include <algorithm>
+#include <cmath>
+#include <limits>
+#include <tuple>
+
+#include <glm/gtc/matrix_access.hpp>
+
+#include "utilities/Profiler.h"
+
+glm::mat4 SkeletonFusion::View::getProjection() const
+{
+    // The point cloud flips both image axes, a pixel (u, v) of the depth frame looks along ((W - 1 - u - cx) / fx, (H - 1 - v - cy) / fy, 1)
+    const float fx = Intrinsics.x, fy = Intrinsics.y, cx = Intrinsics.z, cy = Intrinsics.w;
+
+    glm::mat4 intrinsics{ 1.0f };
+    intrinsics[0][0] = -fx;
+    intrinsics[1][1] = -fy;
+    intrinsics[2][0] = DepthSize.x - 1.0f - cx;
+    intrinsics[2][1] = DepthSize.y - 1.0f - cy;
+
+    return intrinsics * glm::inverse(Model);
+}
+
+void SkeletonFusion::setViews(std::vector<View> views)
+{
+    m_Views = std::move(views);
+
+    m_Projections.clear();
+    for (const auto& view : m_Views)
+        m_Projections.push_back(view.getProjection());
+}
+
+SkeletonFusion::FusedJoint SkeletonFusion::triangulate(std::vector<Observation> observations) const
+{
+    FusedJoint fused;
+
+    while (!observations.empty()) {
+        // Normal equations of the weighted linear system, the 2D rows are divided by the focal length so they are metric like the depth rows
+        glm::dmat3 normal{ 0.0 };
+        glm::dvec3 rhs{ 0.0 };
+
+        auto addRow = [&](glm::dvec4 row, double weight) {
+            const glm::dvec3 a{ row };
+            normal += weight * glm::outerProduct(a, a);
+            rhs -= weight * a * row.w;
+        };
+
+        for (const auto& observation : observations) {
+            const auto& view = m_Views[observation.View];
+            const glm::dmat4 projection{ m_Projections[observation.View] };
+            const glm::dvec4 p0 = glm::row(projection, 0), p1 = glm::row(projection, 1), p2 = glm::row(projection, 2);
+
+            const glm::dvec2 pixel{ view.toDepthPixel(observation.Pixel) };
+            const double weight = (double)observation.Score * observation.Score;
+            addRow((pixel.x * p2 - p0) / (double)view.Intrinsics.x, weight);
+            addRow((pixel.y * p2 - p1) / (double)view.Intrinsics.y, weight);
+
+            if (observation.Depth > 0.0f) {
+                const glm::vec3 direction{ (view.DepthSize.x - 1.0f - (float)pixel.x - view.Intrinsics.z) / view.Intrinsics.x,
+                                           (view.DepthSize.y - 1.0f - (float)pixel.y - view.Intrinsics.w) / view.Intrinsics.y, 1.0f };
+                const glm::dvec3 point{ view.Model * glm::vec4(direction * observation.Depth, 1.0f) };
+                const double depthWeight = weight * m_Params.DepthWeight * m_Params.DepthWeight;
+                for (int axis = 0; axis < 3; axis++) {
+                    glm::dvec4 row{ 0.0 };
+                    row[axis] = 1.0;
+                    row.w = -point[axis];
+                    addRow(row, depthWeight);
+                }
+            }
+        }
+
+        if (std::abs(glm::determinant(normal)) < 1e-12)
+            return fused;
+
+        const glm::dvec3 position = glm::inverse(normal) * rhs;
+
+        // Reprojection error per view in pixels of the detection image
+        std::vector<double> errors(m_Views.size(), 0.0);
+        std::vector<int> counts(m_Views.size(), 0);
+        for (const auto& observation : observations) {
+            const auto& view = m_Views[observation.View];
+            const glm::dvec4 projected = glm::dmat4{ m_Projections[observation.View] } * glm::dvec4(position, 1.0);
+            if (projected.z <= 0.0) {
+                errors[observation.View] = std::numeric_limits<double>::max();
+                counts[observation.View] = 1;
+                continue;
+            }
+
+            const glm::vec2 pixel = view.toImagePixel({ (float)(projected.x / projected.z), (float)(projected.y / projected.z) });
+            errors[observation.View] += glm::distance(pixel, observation.Pixel);
+            counts[observation.View]++;
+        }
+
+        int worst = -1, views = 0;
+        double error = 0.0;
+        for (int view = 0; view < m_Views.size(); view++) {
+            if (counts[view] == 0)
+                continue;
+
+            views++;
+            errors[view] /= counts[view];
+            error += errors[view];
+            if (worst < 0 || errors[view] > errors[worst])
+                worst = view;
+        }
+
+        // Drop the worst view while the others can still constrain the joint
+        if (errors[worst] > m_Params.MaxReprojectionError && views > 2) {
+            std::erase_if(observations, [worst](const auto& observation) { return observation.View == worst; });
+            continue;
+        }
+
+        fused.Position = glm::vec3(position);
+        fused.Views = views;
+        fused.Error = (float)(error / views);
+        fused.Valid = errors[worst] <= m_Params.MaxReprojectionError;
+        return fused;
+    }
+
+    return fused;
+}
+
+std::vector<SkeletonFusion::Observation> SkeletonFusion::getObservations(int view, const Json::Value& person) const
+{
+    std::vector<Observation> observations;
+    for (const auto& joint : person["Skeleton"]) {
+        auto& observation = observations.emplace_back();
+        observation.View = view;
+
+        // Joints below the minimal score stay in the list with a score of 0 so the index matches the joint
+        const float score = joint["score"].asFloat();
+        if (score < m_Params.MinScore || !joint.get("valid", true).asBool())
+            continue;
+
+        observation.Pixel = { joint["u"].asFloat(), joint["v"].asFloat() };
+        observation.Score = score;
+        observation.Depth = joint.get("d", 0.0f).asFloat();
+    }
+
+    return observations;
+}
+
+float SkeletonFusion::getMatchError(const std::vector<Observation>& skeletonA, const std::vector<Observation>& skeletonB) const
+{
+    const size_t joints = std::min(skeletonA.size(), skeletonB.size());
+    float error = 0.0f;
+    int shared = 0;
+
+    for (size_t joint = 0; joint < joints; joint++) {
+        if (skeletonA[joint].Score <= 0.0f || skeletonB[joint].Score <= 0.0f)
+            continue;
+
+        auto fused = triangulate({ skeletonA[joint], skeletonB[joint] });
+        if (fused.Views < 2)
+            continue;
+
+        error += fused.Error;
+        shared++;
+    }
+
+    return shared < 3 ? -1.0f : error / shared;
+}
+
+Json::Value SkeletonFusion::fuse(const std::vector<Json::Value>& people) const
+{
+    PROFILE_FUNCTION();
+    // Every cluster is one person, a list of (view, index of the person in the view)
+    std::vector<std::vector<std::pair<int, int>>> clusters;
+
+    const int views = (int)std::min(people.size(), m_Views.size());
+    std::vector<std::vector<std::vector<Observation>>> skeletons(views);
+    for (int view = 0; view < views; view++) {
+        for (const auto& person : people[view])
+            skeletons[view].push_back(getObservations(view, person));
+    }
+
+    for (int view = 0; view < views; view++) {
+        const auto& candidates = skeletons[view];
+        std::vector<std::tuple<float, int, int>> matches;	// Error, cluster, person
+
+        for (int cluster = 0; cluster < clusters.size(); cluster++) {
+            for (int person = 0; person < (int)candidates.size(); person++) {
+                float best = std::numeric_limits<float>::max();
+                for (const auto& [member_view, member] : clusters[cluster]) {
+                    const float error = getMatchError(skeletons[member_view][member], candidates[person]);
+                    if (error >= 0.0f)
+                        best = std::min(best, error);
+                }
+
+                if (best <= m_Params.MaxMatchError)
+                    matches.emplace_back(best, cluster, person);
+            }
+        }
+
+        // Greedy, the best matches first and every person and cluster only once
+        std::sort(matches.begin(), matches.end());
+        std::vector<bool> clusterUsed(clusters.size(), false), personUsed(candidates.size(), false);
+        for (const auto& [error, cluster, person] : matches) {
+            if (clusterUsed[cluster] || personUsed[person])
+                continue;
+
+            clusters[cluster].emplace_back(view, person);
+            clusterUsed[cluster] = true;
+            personUsed[person] = true;
+        }
+
+        for (int person = 0; person < (int)candidates.size(); person++) {
+            if (!personUsed[person])
+                clusters.push_back({ { view, person } });
+        }
+    }
+
+    Json::Value fused_people{ Json::arrayValue };
+    for (const auto& cluster : clusters) {
+        int joints = 0;
+        Json::Value views_json;
+        for (const auto& [view, person] : cluster) {
+            joints = std::max(joints, (int)skeletons[view][person].size());
+            views_json.append(view);
+        }
+
+        Json::Value skeleton;
+        int valid = 0;
+        for (int joint = 0; joint < joints; joint++) {
+            std::vector<Observation> observations;
+            for (const auto& [view, person] : cluster) {
+                const auto& skeleton = skeletons[view][person];
+                if (joint < (int)skeleton.size() && skeleton[joint].Score > 0.0f)
+                    observations.push_back(skeleton[joint]);
+            }
+
+            const auto result = triangulate(observations);
+            Json::Value joint_json;
+            joint_json["i"] = joint;
+            joint_json["valid"] = result.Valid;
+            joint_json["x"] = result.Position.x;
+            joint_json["y"] = result.Position.y;
+            joint_json["z"] = result.Position.z;
+            joint_json["error"] = result.Error;
+            joint_json["views"] = result.Views;
+            skeleton.append(joint_json);
+
+            valid += result.Valid;
+        }
+
+        if (valid == 0)
+            continue;
+
+        Json::Value person_json;
+        person_json["Views"] = views_json;
+        person_json["Skeleton"] = skeleton;
+        fused_people.append(person_json);
+    }
+
+    return fused_people;
+}
@@ -0,0 +1,91 @@
+#pragma once
+#include <vector>
+
+#include <glm/glm.hpp>
+#include <json/json.h>
+
+/// <summary>
+/// Fuses the skeletons seen by several calibrated cameras into one 3D skeleton per person.
+/// Every joint is triangulated by weighted linear least squares (DLT) from the 2D detections of all views, a depth measured at the joint
+/// adds the 3D point as a further constraint. The view with the largest reprojection error is dropped and the joint solved again until
+/// all views agree. People are matched across views by the reprojection error of their triangulated joints.
+/// </summary>
+class SkeletonFusion
+{
+public:
+	struct Parameters
+	{
+		float MinScore{ 0.1f };				// Joints with a lower score are ignored
+		float MaxReprojectionError{ 15.0f };	// Views with a larger error are rejected as outliers (in px)
+		float MaxMatchError{ 40.0f };		// Mean reprojection error up to which two skeletons are the same person (in px)
+		float DepthWeight{ 0.5f };			// Weight of a measured depth relative to a 2D detection of the same score
+	};
+
+	/// <summary>
+	/// Camera of the rig in the conventions of the point cloud, the depth frame is rotated by 180 degrees (see PointCloud::streamDepth)
+	/// </summary>
+	struct View
+	{
+		glm::vec4 Intrinsics{ };	// fx, fy, cx, cy of the depth frame
+		glm::vec2 DepthSize{ };		// Resolution of the depth frame
+		glm::vec2 ImageSize{ };		// Resolution of the image the joints were detected in
+		glm::mat4 Model{ 1.0f };	// From the camera into the common frame, PointCloud::getCameraModel
+
+		/// <summary>
+		/// Projection from the common frame into pixels of the depth frame
+		/// </summary>
+		glm::mat4 getProjection() const;
+		glm::vec2 toDepthPixel(glm::vec2 pixel) const { return pixel * DepthSize / ImageSize; }
+		glm::vec2 toImagePixel(glm::vec2 pixel) const { return pixel * ImageSize / DepthSize; }
+	};
+
+	struct Observation
+	{
+		int View{ 0 };
+		glm::vec2 Pixel{ };		// In the image the joint was detected in
+		float Score{ 0.0f };
+		float Depth{ 0.0f };	// Measured depth at the joint (in m), 0 if unknown
+	};
+
+	struct FusedJoint
+	{
+		glm::vec3 Position{ };
+		float Error{ 0.0f };	// Mean reprojection error of the used views (in px)
+		int Views{ 0 };
+		bool Valid{ false };
+	};
+
+	SkeletonFusion() = default;
+	explicit SkeletonFusion(Parameters params) : m_Params(params) { }
+
+	Parameters& getParameters() { return m_Params; }
+
+	void setViews(std::vector<View> views);
+	const std::vector<View>& getViews() const { return m_Views; }
+
+	/// <summary>
+	/// Triangulate a single joint, views are rejected while their reprojection error is too large and at least two remain
+	/// </summary>
+	FusedJoint triangulate(std::vector<Observation> observations) const;
+
+	/// <summary>
+	/// Fuse the skeletons of one synchronized frameset
+	/// </summary>
+	/// <param name="people">One entry per view, the people in the format of SkeletonDetectorOpenPose (u, v, score and optionally d per joint)</param>
+	/// <returns>One skeleton per person with the fused position (x, y, z) and the reprojection error of every joint</returns>
+	Json::Value fuse(const std::vector<Json::Value>& people) const;
+private:
+	/// <summary>
+	/// One observation per joint of the person, joints that are not usable have a score of 0
+	/// </summary>
+	std::vector<Observation> getObservations(int view, const Json::Value& person) const;
+	/// <summary>
+	/// Mean reprojection error of two skeletons seen from different views, negative if they share too few joints
+	/// </summary>
+	float getMatchError(const std::vector<Observation>& skeletonA, const std::vector<Observation>& skeletonB) const;
+
+	Parameters m_Params{ };
+
+	std::vector<View> m_Views{ };
+	std::vector<glm::mat4> m_Projections{ };
+};
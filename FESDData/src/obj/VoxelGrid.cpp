@@ -0,0 +1,200 @@
+#include "VoxelGrid.h"
+
+#include <algorithm>
+#include <cmath>
+#include <execution>
+#include <numeric>
+
+#include "utilities/Profiler.h"
+
+namespace {
+constexpr uint64_t EmptyKey{ ~0ull };
+constexpr int KeyBits{ 21 };
+constexpr int64_t KeyMax{ ((int64_t)1 << KeyBits) - 1 };
+constexpr int64_t KeyOffset{ (int64_t)1 << (KeyBits - 1) };
+
+/// Finaliser of MurmurHash3, voxel keys of neighbouring voxels only differ in a few bits
+inline uint64_t hashKey(uint64_t key)
+{
+    key ^= key >> 33;
+    key *= 0xff51afd7ed558ccdull;
+    key ^= key >> 33;
+    key *= 0xc4ceb9fe1a85ec53ull;
+    key ^= key >> 33;
+    return key;
+}
+}
+
+uint64_t VoxelGrid::getKey(const glm::vec3& p) const
+{
+    const float inverseLeafSize = 1.0f / m_LeafSize;
+    auto ix = std::clamp((int64_t)std::floor(p.x * inverseLeafSize) + KeyOffset, (int64_t)0, KeyMax);
+    auto iy = std::clamp((int64_t)std::floor(p.y * inverseLeafSize) + KeyOffset, (int64_t)0, KeyMax);
+    auto iz = std::clamp((int64_t)std::floor(p.z * inverseLeafSize) + KeyOffset, (int64_t)0, KeyMax);
+
+    return ((uint64_t)ix << (2 * KeyBits)) | ((uint64_t)iy << KeyBits) | (uint64_t)iz;
+}
+
+void VoxelGrid::Shard::reset(size_t capacity)
+{
+    size_t size = 64;
+    while (size < capacity)
+        size <<= 1;
+
+    Slots.assign(size, { EmptyKey, glm::vec3{ 0.0f }, 0, 0 });
+    Occupied = 0;
+}
+
+void VoxelGrid::Shard::insert(const Binned& b)
+{
+    // Keep the load factor below 0.5
+    if (2 * (Occupied + 1) > Slots.size())
+        grow();
+
+    const size_t mask = Slots.size() - 1;
+
+    // The low bits of the hash select the shard, use the higher ones for the slot
+    size_t i = (hashKey(b.Key) >> 6) & mask;
+    while (Slots[i].Key != EmptyKey && Slots[i].Key != b.Key)
+        i = (i + 1) & mask;
+
+    auto& slot = Slots[i];
+    if (slot.Key == EmptyKey) {
+        slot.Key = b.Key;
+        slot.Index = b.Index;
+        Occupied++;
+    }
+
+    slot.Sum += b.Point;
+    slot.Count++;
+}
+
+void VoxelGrid::Shard::grow()
+{
+    auto old = std::move(Slots);
+    Slots.assign(old.size() * 2, { EmptyKey, glm::vec3{ 0.0f }, 0, 0 });
+
+    const size_t mask = Slots.size() - 1;
+    for (const auto& slot : old) {
+        if (slot.Key == EmptyKey)
+            continue;
+
+        size_t i = (hashKey(slot.Key) >> 6) & mask;
+        while (Slots[i].Key != EmptyKey)
+            i = (i + 1) & mask;
+
+        Slots[i] = slot;
+    }
+}
+
+const VoxelCloud& VoxelGrid::filter(const Point* points, int count)
+{
+    return filter(count, count, [points](int i, int, int, glm::vec3& p) {
+        if (points[i].Depth <= 0.0f)
+            return false;
+
+        p = points[i].getPoint();
+        return true;
+    });
+}
+
+const VoxelCloud& VoxelGrid::filter(const uint16_t* depth, int width, int height, float metersPerUnit, const glm::mat3& intrinsics)
+{
+    // Same layout as DepthCamera::getIntrinsics
+    const float fx = intrinsics[0][0];
+    const float fy = intrinsics[1][1];
+    const float cx = intrinsics[0][2];
+    const float cy = intrinsics[1][2];
+
+    // Same points as PointCloud::streamDepth, so both overloads give the same voxels
+    return filter(width * height, width, [=](int i, int u, int v, glm::vec3& p) {
+        const auto d = depth[Point::getDepthIndex(i, width, height)];
+        if (d == 0)
+            return false;
+
+        const float z = d * metersPerUnit;
+        const auto ray = Point::getPositionFunction(u, v, fx, fy, cx, cy);
+        p = { ray[0] * z, ray[1] * z, z };
+        return true;
+    });
+}
+
+template<typename PointAt>
+const VoxelCloud& VoxelGrid::filter(int count, int width, PointAt pointAt)
+{
+    PROFILE_FUNCTION();
+
+    const int blockCount = (count + PixelsPerBlock - 1) / PixelsPerBlock;
+    if (m_Bins.size() < (size_t)blockCount * ShardCount)
+        m_Bins.resize((size_t)blockCount * ShardCount);
+
+    // Bin the valid points of every block by the shard of their voxel
+    std::vector<int> blocks(blockCount);
+    std::iota(blocks.begin(), blocks.end(), 0);
+
+    std::for_each(std::execution::par, blocks.begin(), blocks.end(), [&](int block) {
+        auto bins = &m_Bins[(size_t)block * ShardCount];
+        for (int shard = 0; shard < ShardCount; shard++)
+            bins[shard].clear();
+
+        int begin = block * PixelsPerBlock;
+        int end = std::min(count, begin + PixelsPerBlock);
+        int u = begin % width;
+        int v = begin / width;
+
+        glm::vec3 p;
+        for (int i = begin; i < end; i++) {
+            if (pointAt(i, u, v, p)) {
+                auto key = getKey(p);
+                bins[hashKey(key) & (ShardCount - 1)].push_back({ key, p, (uint32_t)i });
+            }
+
+            if (++u == width) {
+                u = 0;
+                v++;
+            }
+        }
+    });
+
+    // Accumulate every shard in its own open addressing table
+    std::vector<int> shards(ShardCount);
+    std::iota(shards.begin(), shards.end(), 0);
+
+    std::for_each(std::execution::par, shards.begin(), shards.end(), [&](int s) {
+        auto& shard = m_Shards[s];
+
+        // Start with the size of the last frame, the table grows if the scene got more detailed
+        shard.reset(2 * shard.Occupied + 2);
+
+        for (int block = 0; block < blockCount; block++) {
+            for (const auto& b : m_Bins[(size_t)block * ShardCount + s])
+                shard.insert(b);
+        }
+    });
+
+    // Gather the centroids of all shards
+    std::vector<size_t> offsets(ShardCount + 1, 0);
+    for (int s = 0; s < ShardCount; s++)
+        offsets[s + 1] = offsets[s] + m_Shards[s].Occupied;
+
+    m_Result.Centroids.resize(offsets.back());
+    m_Result.Counts.resize(offsets.back());
+    m_Result.SourceIndices.resize(offsets.back());
+
+    std::for_each(std::execution::par, shards.begin(), shards.end(), [&](int s) {
+        const auto& shard = m_Shards[s];
+        size_t out = offsets[s];
+
+        for (const auto& slot : shard.Slots) {
+            if (slot.Key == EmptyKey)
+                continue;
+
+            m_Result.Centroids[out] = slot.Sum / (float)slot.Count;
+            m_Result.Counts[out] = slot.Count;
+            m_Result.SourceIndices[out] = slot.Index;
+            out++;
+        }
+    });
+
+    return m_Result;
+}
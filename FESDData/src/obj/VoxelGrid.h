@@ -0,0 +1,87 @@
+#pragma once
+#include <cstdint>
+#include <vector>
+
+#include <glm/glm.hpp>
+
+#include "Point.h"
+
+/// <summary>
+/// Result of a voxel grid filter, one entry per occupied voxel
+/// </summary>
+struct VoxelCloud
+{
+	std::vector<glm::vec3> Centroids;
+	std::vector<uint32_t> Counts;
+	// Index of one pixel inside each voxel, can be used as index buffer to render the cloud at a reduced LOD
+	std::vector<uint32_t> SourceIndices;
+
+	size_t size() const { return Centroids.size(); }
+};
+
+/// <summary>
+/// Multithreaded voxel grid downsampler working directly on depth images.
+/// Pixels without depth are skipped. Valid points are binned by the hash of their voxel into shards, every shard is then
+/// reduced into centroids in its own open addressing table, so no two threads ever touch the same voxel.
+/// The scratch buffers are kept between calls, filtering the same resolution again does not allocate.
+/// </summary>
+class VoxelGrid
+{
+public:
+	explicit VoxelGrid(float leafSize = 0.01f) : m_LeafSize(leafSize) { }
+
+	void setLeafSize(float leafSize) { m_LeafSize = leafSize; }
+	float getLeafSize() const { return m_LeafSize; }
+
+	/// <summary>
+	/// Downsample the vertex data of one camera as produced by PointCloud::streamDepth
+	/// </summary>
+	const VoxelCloud& filter(const Point* points, int count);
+
+	/// <summary>
+	/// Downsample a raw depth image, into the same points PointCloud::streamDepth produces from it
+	/// </summary>
+	/// <param name="intrinsics">Camera matrix (fx, fy, cx, cy) as returned by DepthCamera::getIntrinsics</param>
+	const VoxelCloud& filter(const uint16_t* depth, int width, int height, float metersPerUnit, const glm::mat3& intrinsics);
+
+	const VoxelCloud& getResult() const { return m_Result; }
+private:
+	static constexpr int ShardCount{ 64 };
+	static constexpr int PixelsPerBlock{ 16384 };
+
+	struct Binned
+	{
+		uint64_t Key;
+		glm::vec3 Point;
+		uint32_t Index;
+	};
+
+	struct Slot
+	{
+		uint64_t Key;
+		glm::vec3 Sum;
+		uint32_t Count;
+		uint32_t Index;
+	};
+
+	struct Shard
+	{
+		std::vector<Slot> Slots;
+		size_t Occupied{ 0 };
+
+		void reset(size_t capacity);
+		void insert(const Binned& b);
+		void grow();
+	};
+
+	template<typename PointAt>
+	const VoxelCloud& filter(int count, int width, PointAt pointAt);
+
+	uint64_t getKey(const glm::vec3& p) const;
+
+	float m_LeafSize;
+
+	std::vector<std::vector<Binned>> m_Bins;	// Block major, ShardCount bins per block
+	std::vector<Shard> m_Shards = std::vector<Shard>(ShardCount);
+	VoxelCloud m_Result;
+};
@@ -0,0 +1,153 @@
+#include "CalibrationStore.h"
+
+#include <algorithm>
+#include <cctype>
+#include <fstream>
+
+/// 
+/// Calibration
+/// 
+
+Calibration Calibration::fromCamera(const DepthCamera* camera)
+{
+    Calibration calibration;
+    calibration.Serial = camera->getSerial();
+    calibration.Name = camera->getCameraName();
+    calibration.Width = camera->getDepthStreamWidth();
+    calibration.Height = camera->getDepthStreamHeight();
+    calibration.Intrinsics = camera->getIntrinsics();
+    calibration.MetersPerUnit = camera->getMetersPerUnit();
+
+    return calibration;
+}
+
+std::optional<Calibration> Calibration::fromJson(const Json::Value& json)
+{
+    if (!json.isMember("Serial") || !json.isMember("Fx") || !json.isMember("Width"))
+        return std::nullopt;
+
+    Calibration calibration;
+    calibration.Serial = json["Serial"].asString();
+    calibration.Name = json["Name"].asString();
+    calibration.Width = json["Width"].asUInt();
+    calibration.Height = json["Height"].asUInt();
+
+    calibration.Intrinsics = glm::mat3{ 1.0f };
+    calibration.Intrinsics[0][0] = json["Fx"].asFloat();
+    calibration.Intrinsics[1][1] = json["Fy"].asFloat();
+    calibration.Intrinsics[0][2] = json["Cx"].asFloat();
+    calibration.Intrinsics[1][2] = json["Cy"].asFloat();
+    calibration.MetersPerUnit = json["MeterPerUnit"].asFloat();
+
+    if (json.isMember("Reference")) {
+        calibration.Reference = json["Reference"].asString();
+        calibration.Rotation = json["Rotation"];
+        calibration.Translation = json["Translation"];
+    }
+
+    calibration.Timestamp = json["Timestamp"].asInt64();
+
+    return calibration;
+}
+
+Calibration::operator Json::Value() const
+{
+    Json::Value json;
+    json["Serial"] = Serial;
+    json["Name"] = Name;
+    json["Width"] = Width;
+    json["Height"] = Height;
+
+    // Same keys as the camera entries of a session
+    json["Fx"] = Intrinsics[0][0];
+    json["Fy"] = Intrinsics[1][1];
+    json["Cx"] = Intrinsics[0][2];
+    json["Cy"] = Intrinsics[1][2];
+    json["MeterPerUnit"] = MetersPerUnit;
+
+    if (hasExtrinsics()) {
+        json["Reference"] = Reference;
+        json["Rotation"] = Rotation;
+        json["Translation"] = Translation;
+    }
+
+    json["Timestamp"] = (Json::Int64)Timestamp;
+
+    return json;
+}
+
+/// 
+/// Store
+/// 
+
+std::filesystem::path CalibrationStore::getPath(const std::string& serial) const
+{
+    // URIs contain characters that are not allowed in file names
+    std::string fileName = serial;
+    std::ranges::replace_if(fileName, [](char c) { return !std::isalnum((unsigned char)c) && c != '-' && c != '_'; }, '_');
+
+    return m_Directory / (fileName + ".json");
+}
+
+std::optional<Calibration> CalibrationStore::load(const DepthCamera* camera) const
+{
+    auto serial = camera->getSerial();
+    if (serial.empty())
+        return std::nullopt;
+
+    std::ifstream file(getPath(serial));
+    if (!file.is_open())
+        return std::nullopt;
+
+    Json::Value json;
+    Json::CharReaderBuilder builder;
+    std::string errors;
+    if (!Json::parseFromStream(builder, file, &json, &errors))
+        return std::nullopt;
+
+    auto calibration = Calibration::fromJson(json);
+
+    // A calibration of a different stream mode does not apply
+    if (!calibration || calibration->Serial != serial ||
+        calibration->Width != camera->getDepthStreamWidth() || calibration->Height != camera->getDepthStreamHeight())
+        return std::nullopt;
+
+    return calibration;
+}
+
+bool CalibrationStore::save(Calibration calibration, bool stampExtrinsics) const
+{
+    if (calibration.Serial.empty())
+        return false;
+
+    if (stampExtrinsics && calibration.hasExtrinsics())
+        calibration.Timestamp = std::chrono::duration_cast<std::chrono::seconds>(std::chrono::system_clock::now().time_since_epoch()).count();
+
+    std::error_code ec;
+    std::filesystem::create_directories(m_Directory, ec);
+
+    // Write to a temporary file first so a crash never leaves a truncated calibration behind
+    auto path = getPath(calibration.Serial);
+    auto tmpPath = path;
+    tmpPath += ".tmp";
+
+    {
+        std::ofstream file(tmpPath, std::ios::out | std::ios::trunc);
+        if (!file.is_open())
+            return false;
+
+        Json::StreamWriterBuilder builder;
+        file << Json::writeString(builder, (Json::Value)calibration);
+        if (!file.good())
+            return false;
+    }
+
+    std::filesystem::rename(tmpPath, path, ec);
+    return !ec;
+}
+
+bool CalibrationStore::isFresh(const Calibration& calibration) const
+{
+    auto now = std::chrono::duration_cast<std::chrono::seconds>(std::chrono::system_clock::now().time_since_epoch()).count();
+    return now - calibration.Timestamp <= std::chrono::duration_cast<std::chrono::seconds>(m_MaxAge).count();
+}
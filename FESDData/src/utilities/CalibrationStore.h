@@ -0,0 +1,72 @@
+#pragma once
+#include <chrono>
+#include <cstdint>
+#include <filesystem>
+#include <optional>
+#include <string>
+
+#include <glm/glm.hpp>
+#include <json/json.h>
+
+#include "cameras/DepthCamera.h"
+#include "utilities/Consts.h"
+
+/// <summary>
+/// Calibration of one device as stored in the calibration directory
+/// </summary>
+struct Calibration
+{
+	std::string Serial{ };
+	std::string Name{ };
+	unsigned int Width{ 0 };
+	unsigned int Height{ 0 };
+	glm::mat3 Intrinsics{ 1.0f };
+	float MetersPerUnit{ 0.001f };
+
+	// Extrinsics relative to the reference device, in the format of PointCloud::getRotation/getTranslation
+	std::string Reference{ };
+	Json::Value Rotation{ };
+	Json::Value Translation{ };
+
+	int64_t Timestamp{ 0 };	// Seconds since epoch of the last registration of the extrinsics, 0 without extrinsics
+
+	bool hasExtrinsics() const { return !Reference.empty(); }
+
+	static Calibration fromCamera(const DepthCamera* camera);
+	static std::optional<Calibration> fromJson(const Json::Value& json);
+	explicit operator Json::Value() const;
+};
+
+/// <summary>
+/// Per device calibrations keyed by serial number (or URI), one JSON file per device.
+/// Lets the application start with the intrinsics and extrinsics of the last session instead of aligning the cameras again.
+/// </summary>
+class CalibrationStore
+{
+public:
+	explicit CalibrationStore(std::filesystem::path directory = m_CalibrationDirectory, std::chrono::hours maxAge = std::chrono::hours{ 24 * 30 })
+		: m_Directory(std::move(directory)), m_MaxAge(maxAge) { }
+
+	/// <summary>
+	/// Calibration of the camera if one exists for its serial and stream resolution
+	/// </summary>
+	std::optional<Calibration> load(const DepthCamera* camera) const;
+
+	/// <summary>
+	/// Store the calibration, the timestamp is only renewed if the extrinsics were just registered or saved by the user
+	/// </summary>
+	/// <returns>False if the file could not be written</returns>
+	bool save(Calibration calibration, bool stampExtrinsics = false) const;
+
+	/// <summary>
+	/// Extrinsics older than the maximum age are not trusted anymore, rigs get moved
+	/// </summary>
+	bool isFresh(const Calibration& calibration) const;
+
+	const std::filesystem::path& getDirectory() const { return m_Directory; }
+private:
+	std::filesystem::path getPath(const std::string& serial) const;
+
+	std::filesystem::path m_Directory;
+	std::chrono::hours m_MaxAge;
+};
@@ -4,4 +4,5 @@
 
 // TODO: Create file that reads and stores this
 static const std::filesystem::path m_RecordingDirectory{ "D:\\Recordings" };
-constexpr int READ_WAIT_TIMEOUT = 1000;
\ No newline at end of file
+constexpr int READ_WAIT_TIMEOUT = 1000;
+static const std::filesystem::path m_CalibrationDirectory{ "models/cameraParameters" };
@@ -9,13 +9,14 @@
 #include <json/json.h>
 
 #include "Consts.h"
+#include "FrameIO.h"
 
-void convertRecordings(std::vector<Json::Value> recordings, bool delete_old = false)  {
+void convertRecordings(std::vector<Json::Value> recordings, bool delete_old = false, const std::filesystem::path& recordingDirectory = m_RecordingDirectory)  {
 	int irec = 0;
 
 	for (auto rec : recordings) {
 		std::cout << 100 * ((float)irec++ / (float)recordings.size()) << "% Done!                                " << std::endl;
-		std::filesystem::path frames = m_RecordingDirectory / std::filesystem::path{ rec["Cameras"][0]["FileName"].asString() };
+		std::filesystem::path frames = recordingDirectory / std::filesystem::path{ rec["Cameras"][0]["FileName"].asString() };
 		int iframe = 0;
 		for (const auto& entry : std::filesystem::directory_iterator(frames))
 		{
@@ -29,29 +30,7 @@ void convertRecordings(std::vector<Json::Value> recordings, bool delete_old = fa
 
 				auto bin_path = entry.path();
 				bin_path.replace_extension(".bin");
-				std::ofstream fs(bin_path, std::fstream::binary);
-
-				// Header
-				int type = frame.type();
-				int channels = frame.channels();
-				fs.write((char*)&frame.rows, sizeof(int));		// rows
-				fs.write((char*)&frame.cols, sizeof(int));		// cols
-				fs.write((char*)&type, sizeof(int));			// type
-				fs.write((char*)&channels, sizeof(int));    // channels
-
-				// Data
-				if (frame.isContinuous())
-				{
-					fs.write(frame.ptr<char>(0), (frame.dataend - frame.datastart));
-				}
-				else
-				{
-					int rowsz = CV_ELEM_SIZE(type) * frame.cols;
-					for (int r = 0; r < frame.rows; ++r)
-					{
-						fs.write(frame.ptr<char>(r), rowsz);
-					}
-				}
+				FrameIO::writeFrame(bin_path, frame);
 
 				if (delete_old) {
 					std::remove(entry.path().string().c_str());
@@ -59,22 +38,15 @@ void convertRecordings(std::vector<Json::Value> recordings, bool delete_old = fa
 			}
 			else if (entry.path().extension() == ".bin") {
 				std::cout << iframe++ << "/" << rec["Frames"].asInt() << " Frames stored!\r";
-				std::ifstream fin(entry.path(), std::fstream::binary);
-
-				// Header
-				int rows, cols, type, channels;
-				fin.read((char*)&rows, sizeof(int));         // rows
-				fin.read((char*)&cols, sizeof(int));         // cols
-				fin.read((char*)&type, sizeof(int));         // type
-				fin.read((char*)&channels, sizeof(int));     // channels
-				if (type == CV_16F) {
+				cv::Mat mat = FrameIO::readFrame(entry.path());
+				if (mat.empty()) {
+					std::cout << "Could not read " << entry.path() << std::endl;
+					continue;
+				}
+				if (mat.depth() == CV_16F) {
 					std::cout << "Already converted!" << std::endl;
 					continue;
 				}
-				// Data
-				cv::Mat mat(rows, cols, type);
-				fin.read((char*)mat.data, CV_ELEM_SIZE(type) * rows * cols);
-				fin.close();
 				std::remove(entry.path().string().c_str());
 				mat.convertTo(mat, CV_16F);
 
@@ -84,29 +56,7 @@ void convertRecordings(std::vector<Json::Value> recordings, bool delete_old = fa
 
 				auto bin_path = entry.path();
 				bin_path.replace_extension(".bin");
-				std::ofstream fout(bin_path, std::fstream::binary);
-
-				// Header
-				type = mat.type();
-				channels = mat.channels();
-				fout.write((char*)&mat.rows, sizeof(int));		// rows
-				fout.write((char*)&mat.cols, sizeof(int));		// cols
-				fout.write((char*)&type, sizeof(int));			// type
-				fout.write((char*)&channels, sizeof(int));    // channels
-
-				// Data
-				if (mat.isContinuous())
-				{
-					fout.write(mat.ptr<char>(0), (mat.dataend - mat.datastart));
-				}
-				else
-				{
-					int rowsz = CV_ELEM_SIZE(type) * mat.cols;
-					for (int r = 0; r < mat.rows; ++r)
-					{
-						fout.write(mat.ptr<char>(r), rowsz);
-					}
-				}
+				FrameIO::writeFrame(bin_path, mat);
 			}
 		}
 	}
@@ -0,0 +1,325 @@
+#include "FrameIO.h"
+
+#include <algorithm>
+#include <cstring>
+#include <fstream>
+
+#include "FramePacking.h"
+#include "FramePool.h"
+
+namespace {
+struct FileHeader
+{
+    uint32_t Magic;
+    uint32_t Version;
+    uint32_t Planes;
+    uint32_t HeaderSize;
+};
+
+struct PlaneHeader
+{
+    uint32_t Id;
+    int32_t Rows;
+    int32_t Cols;
+    int32_t Type;
+    float Scale;
+    uint32_t Reserved;
+    uint64_t Offset;
+    uint64_t Size;
+};
+static_assert(sizeof(FileHeader) == 16 && sizeof(PlaneHeader) == 40, "The layout is read by FESDModel");
+
+constexpr uint32_t MaxPlanes{ 16 };
+
+uint64_t getFileSize(std::ifstream& fs)
+{
+    const auto position = fs.tellg();
+    fs.seekg(0, std::ios::end);
+    const auto size = fs.tellg();
+    fs.seekg(position);
+    return size < 0 ? 0 : (uint64_t)size;
+}
+
+bool readHeaders(std::ifstream& fs, std::vector<PlaneHeader>& planes, uint64_t& headerSize)
+{
+    FileHeader header{ };
+    fs.read((char*)&header, sizeof(header));
+    if (!fs.good() || header.Magic != FrameIO::Magic || header.Version != FrameIO::Version)
+        return false;
+
+    // The header size follows from the number of planes, anything else is a corrupt file
+    if (header.Planes > MaxPlanes || header.HeaderSize != sizeof(FileHeader) + header.Planes * sizeof(PlaneHeader))
+        return false;
+
+    headerSize = header.HeaderSize;
+    planes.resize(header.Planes);
+    fs.read((char*)planes.data(), planes.size() * sizeof(PlaneHeader));
+    return fs.good();
+}
+
+// Type every plane is written with, see FrameIO::PlaneId
+int getPlaneType(uint32_t id)
+{
+    switch ((FrameIO::PlaneId)id) {
+    case FrameIO::PlaneId::Depth: return CV_16UC1;
+    case FrameIO::PlaneId::Color: return CV_8UC3;
+    case FrameIO::PlaneId::Mask: return CV_8UC1;
+    default: return -1;
+    }
+}
+
+// A plane is only read if its header agrees with the type of its id and its data lies behind the headers and within the file
+bool isValid(const PlaneHeader& plane, uint64_t headerSize, uint64_t fileSize)
+{
+    if (plane.Rows <= 0 || plane.Cols <= 0 || plane.Type != getPlaneType(plane.Id))
+        return false;
+
+    const uint64_t size = (uint64_t)plane.Rows * (uint64_t)plane.Cols * CV_ELEM_SIZE(plane.Type);
+    return plane.Size == size
+        && plane.Offset >= headerSize
+        && plane.Offset % FrameIO::PlaneAlignment == 0
+        && plane.Offset <= fileSize && plane.Size <= fileSize - plane.Offset;
+}
+
+// Header of the file and of every plane, the planes are placed one after another at aligned offsets
+FileHeader getHeaders(const std::vector<FrameIO::Plane>& planes, std::vector<PlaneHeader>& headers, uint64_t& size)
+{
+    FileHeader header{ FrameIO::Magic, FrameIO::Version, (uint32_t)planes.size(), (uint32_t)(sizeof(FileHeader) + planes.size() * sizeof(PlaneHeader)) };
+
+    headers.clear();
+    uint64_t offset = header.HeaderSize;
+    for (const auto& plane : planes) {
+        offset = (offset + FrameIO::PlaneAlignment - 1) / FrameIO::PlaneAlignment * FrameIO::PlaneAlignment;
+        const uint64_t planeSize = (uint64_t)plane.Data.total() * plane.Data.elemSize();
+        headers.push_back({ (uint32_t)plane.Id, plane.Data.rows, plane.Data.cols, plane.Data.type(), plane.Scale, 0, offset, planeSize });
+        offset += planeSize;
+    }
+    size = offset;
+
+    return header;
+}
+
+// Frames of version 1 are interleaved FP16 RGB-D, colour in [0, 1] and depth in m
+std::vector<FrameIO::Plane> splitFrame(const cv::Mat& frame, const std::vector<FrameIO::PlaneId>& ids)
+{
+    std::vector<FrameIO::Plane> planes;
+    for (auto id : ids) {
+        auto& plane = planes.emplace_back();
+        plane.Id = id;
+        if (frame.channels() != 4)
+            continue;
+
+        cv::Mat channels;
+        if (id == FrameIO::PlaneId::Depth) {
+            cv::extractChannel(frame, channels, 3);
+            channels.convertTo(plane.Data, CV_16U, 1000.0);
+            plane.Scale = 0.001f;
+        }
+        else if (id == FrameIO::PlaneId::Color) {
+            static const int fromTo[]{ 0, 0, 1, 1, 2, 2 };
+            channels.create(frame.size(), CV_MAKETYPE(frame.depth(), 3));
+            cv::mixChannels(&frame, 1, &channels, 1, fromTo, 3);
+            channels.convertTo(plane.Data, CV_8U, 255.0);
+            plane.Scale = 1.0f / 255.0f;
+        }
+    }
+    return planes;
+}
+}
+
+namespace FrameIO {
+size_t writeFrame(const std::filesystem::path& path, const cv::Mat& frame)
+{
+    std::ofstream fs(path, std::fstream::binary);
+    if (!fs.is_open())
+        return 0;
+
+    // Header
+    int type = frame.type();
+    int channels = frame.channels();
+    fs.write((char*)&frame.rows, sizeof(int));  // rows
+    fs.write((char*)&frame.cols, sizeof(int));  // cols
+    fs.write((char*)&type, sizeof(int));        // type
+    fs.write((char*)&channels, sizeof(int));    // channels
+
+    // Data
+    int rowsz = CV_ELEM_SIZE(type) * frame.cols;
+    if (frame.isContinuous())
+    {
+        fs.write(frame.ptr<char>(0), (size_t)rowsz * frame.rows);
+    }
+    else
+    {
+        for (int r = 0; r < frame.rows; ++r)
+        {
+            fs.write(frame.ptr<char>(r), rowsz);
+        }
+    }
+
+    if (!fs.good())
+        return 0;
+
+    return 4 * sizeof(int) + (size_t)rowsz * frame.rows;
+}
+
+cv::Mat readFrame(const std::filesystem::path& path)
+{
+    if (isPlanar(path)) {
+        auto planes = readPlanes(path, { PlaneId::Color, PlaneId::Depth });
+        if (planes[0].Data.empty() || planes[1].Data.empty())
+            return {};
+
+        cv::Mat frame;
+        FramePacking::packRGBD(planes[0].Data, planes[1].Data, planes[1].Scale, frame);
+        return frame;
+    }
+
+    std::ifstream fs(path, std::fstream::binary);
+    if (!fs.is_open())
+        return {};
+
+    // Header
+    int rows, cols, type, channels;
+    fs.read((char*)&rows, sizeof(int));         // rows
+    fs.read((char*)&cols, sizeof(int));         // cols
+    fs.read((char*)&type, sizeof(int));         // type
+    fs.read((char*)&channels, sizeof(int));     // channels
+
+    // The type has to be a valid OpenCV type with this number of channels, and the data has to be part of the file
+    if (!fs.good() || rows <= 0 || cols <= 0 || type != CV_MAT_TYPE(type) || channels != CV_MAT_CN(type))
+        return {};
+
+    const uint64_t size = (uint64_t)rows * (uint64_t)cols * CV_ELEM_SIZE(type);
+    if (size + 4 * sizeof(int) > getFileSize(fs))
+        return {};
+
+    // Data, the buffer returns to the pool once the frame is released
+    cv::Mat mat = FramePool::getInstance().acquire(rows, cols, type);
+    fs.read((char*)mat.data, (size_t)CV_ELEM_SIZE(type) * rows * cols);
+
+    if (!fs.good())
+        return {};
+
+    return mat;
+}
+
+size_t writePlanes(const std::filesystem::path& path, const std::vector<Plane>& planes)
+{
+    std::ofstream fs(path, std::fstream::binary);
+    if (!fs.is_open())
+        return 0;
+
+    std::vector<PlaneHeader> headers;
+    uint64_t size = 0;
+    const FileHeader header = getHeaders(planes, headers, size);
+
+    fs.write((char*)&header, sizeof(header));
+    fs.write((char*)headers.data(), headers.size() * sizeof(PlaneHeader));
+
+    static const char padding[PlaneAlignment]{ };
+    uint64_t position = header.HeaderSize;
+    for (int i = 0; i < planes.size(); i++) {
+        fs.write(padding, headers[i].Offset - position);
+
+        const auto& data = planes[i].Data;
+        const size_t rowsz = data.cols * data.elemSize();
+        if (data.isContinuous()) {
+            fs.write(data.ptr<char>(0), headers[i].Size);
+        }
+        else {
+            for (int r = 0; r < data.rows; ++r)
+                fs.write(data.ptr<char>(r), rowsz);
+        }
+        position = headers[i].Offset + headers[i].Size;
+    }
+
+    if (!fs.good())
+        return 0;
+
+    return position;
+}
+
+size_t writePlanes(char* buffer, size_t capacity, const std::vector<Plane>& planes)
+{
+    std::vector<PlaneHeader> headers;
+    uint64_t size = 0;
+    const FileHeader header = getHeaders(planes, headers, size);
+    if (size > capacity)
+        return 0;
+
+    std::memcpy(buffer, &header, sizeof(header));
+    std::memcpy(buffer + sizeof(header), headers.data(), headers.size() * sizeof(PlaneHeader));
+
+    uint64_t position = header.HeaderSize;
+    for (int i = 0; i < planes.size(); i++) {
+        std::memset(buffer + position, 0, headers[i].Offset - position);
+
+        // Regions of a larger frame are copied row by row
+        const auto& data = planes[i].Data;
+        const size_t rowsz = data.cols * data.elemSize();
+        if (data.isContinuous()) {
+            std::memcpy(buffer + headers[i].Offset, data.ptr<char>(0), headers[i].Size);
+        }
+        else {
+            for (int r = 0; r < data.rows; ++r)
+                std::memcpy(buffer + headers[i].Offset + r * rowsz, data.ptr<char>(r), rowsz);
+        }
+        position = headers[i].Offset + headers[i].Size;
+    }
+
+    return position;
+}
+
+size_t getPlanarSize(const std::vector<Plane>& planes)
+{
+    std::vector<PlaneHeader> headers;
+    uint64_t size = 0;
+    getHeaders(planes, headers, size);
+    return size;
+}
+
+std::vector<Plane> readPlanes(const std::filesystem::path& path, const std::vector<PlaneId>& ids)
+{
+    std::ifstream fs(path, std::fstream::binary);
+    std::vector<PlaneHeader> headers;
+    uint64_t headerSize = 0;
+    if (!readHeaders(fs, headers, headerSize)) {
+        // Frames of version 1 have no header, planar frames of an unknown version are not read
+        fs.close();
+        return splitFrame(isPlanar(path) ? cv::Mat{ } : readFrame(path), ids);
+    }
+
+    const uint64_t fileSize = getFileSize(fs);
+
+    std::vector<Plane> planes;
+    for (auto id : ids) {
+        auto& plane = planes.emplace_back();
+        plane.Id = id;
+
+        auto header = std::find_if(headers.begin(), headers.end(), [id](const auto& h) { return h.Id == (uint32_t)id; });
+        if (header == headers.end() || !isValid(*header, headerSize, fileSize))
+            continue;
+
+        // Only the requested planes are read, the others are skipped
+        plane.Scale = header->Scale;
+        plane.Data = FramePool::getInstance().acquire(header->Rows, header->Cols, header->Type);
+        fs.seekg(header->Offset);
+        fs.read((char*)plane.Data.data, header->Size);
+
+        if (!fs.good()) {
+            plane.Data = cv::Mat{ };
+            fs.clear();
+        }
+    }
+
+    return planes;
+}
+
+bool isPlanar(const std::filesystem::path& path)
+{
+    std::ifstream fs(path, std::fstream::binary);
+    uint32_t magic = 0;
+    fs.read((char*)&magic, sizeof(magic));
+    return fs.good() && magic == Magic;
+}
+}
@@ -0,0 +1,70 @@
+#pragma once
+#include <cstdint>
+#include <filesystem>
+#include <vector>
+
+#include <opencv2/core.hpp>
+
+namespace FrameIO {
+/// <summary>
+/// Write a frame to a .bin file.
+/// The header consists of four ints (rows, cols, type, channels) followed by the raw frame data.
+/// </summary>
+/// <returns>Number of bytes written, 0 if the file could not be written</returns>
+size_t writeFrame(const std::filesystem::path& path, const cv::Mat& frame);
+
+/// <summary>
+/// Read a frame previously written with writeFrame, planar frames are packed into the interleaved FP16 RGB-D layout
+/// </summary>
+/// <returns>The frame or an empty matrix if the file could not be read or its header does not match its data</returns>
+cv::Mat readFrame(const std::filesystem::path& path);
+
+///
+/// Planar frames
+///
+
+constexpr uint32_t Magic{ 0x44534546 };	// "FESD", larger than any row count of a frame written by writeFrame
+constexpr uint32_t Version{ 2 };
+constexpr size_t PlaneAlignment{ 64 };
+
+enum class PlaneId : uint32_t
+{
+	Depth = 0,	// CV_16UC1
+	Color = 1,	// CV_8UC3 in the channel order of the camera
+	Mask = 2	// CV_8UC1, pixels of the subject
+};
+
+struct Plane
+{
+	PlaneId Id{ PlaneId::Depth };
+	cv::Mat Data{ };
+	float Scale{ 1.0f };	// From a value of the plane to its physical unit, m per unit for depth and 1/255 for colour
+};
+
+/// <summary>
+/// Write the planes of a frame so they can be read separately.
+/// The file starts with a header of four uint32 (magic, version, number of planes, header size), followed by one entry per plane
+/// (uint32 id, int32 rows, int32 cols, int32 type, float scale, uint32 reserved, uint64 offset, uint64 size).
+/// The data of every plane starts at its offset, aligned to PlaneAlignment bytes.
+/// </summary>
+/// <returns>Number of bytes written, 0 if the file could not be written</returns>
+size_t writePlanes(const std::filesystem::path& path, const std::vector<Plane>& planes);
+/// <summary>
+/// Serialise the planes into memory in the layout of writePlanes
+/// </summary>
+/// <returns>Number of bytes written, 0 if the buffer is too small</returns>
+size_t writePlanes(char* buffer, size_t capacity, const std::vector<Plane>& planes);
+/// <summary>
+/// Size of the file writePlanes produces for these planes
+/// </summary>
+size_t getPlanarSize(const std::vector<Plane>& planes);
+
+/// <summary>
+/// Read only the requested planes of a frame, frames written by writeFrame are split into depth (mm) and colour
+/// </summary>
+/// <returns>The planes in the requested order, the data of planes which are not part of the frame or whose header does not match
+/// the type, size or position of the plane is empty</returns>
+std::vector<Plane> readPlanes(const std::filesystem::path& path, const std::vector<PlaneId>& ids);
+
+bool isPlanar(const std::filesystem::path& path);
+}
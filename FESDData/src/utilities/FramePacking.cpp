@@ -0,0 +1,69 @@
+#include "FramePacking.h"
+
+#include <cstring>
+
+#include <immintrin.h>
+
+#include "utilities/Profiler.h"
+
+// MSVC allows the intrinsics without enabling the instruction set for the whole file, GCC and Clang need the target per function
+#if defined(__GNUC__)
+#define FESD_TARGET_F16C __attribute__((target("sse4.1,f16c")))
+#else
+#define FESD_TARGET_F16C
+#endif
+
+namespace {
+void packRowScalar(const uint8_t* color, const uint16_t* depth, int pixels, float metersPerUnit, cv::float16_t* out)
+{
+    constexpr float ColorScale{ 1.0f / 255.0f };
+    for (int i = 0; i < pixels; i++) {
+        out[4 * i + 0] = cv::float16_t(color[3 * i + 0] * ColorScale);
+        out[4 * i + 1] = cv::float16_t(color[3 * i + 1] * ColorScale);
+        out[4 * i + 2] = cv::float16_t(color[3 * i + 2] * ColorScale);
+        out[4 * i + 3] = cv::float16_t(depth[i] * metersPerUnit);
+    }
+}
+
+FESD_TARGET_F16C
+void packRowF16C(const uint8_t* color, const uint16_t* depth, int pixels, float metersPerUnit, cv::float16_t* out)
+{
+    constexpr float ColorScale{ 1.0f / 255.0f };
+    const __m128 scale = _mm_setr_ps(ColorScale, ColorScale, ColorScale, metersPerUnit);
+
+    // Four colour bytes are loaded per pixel, the last pixel of the row would read past it
+    int i = 0;
+    for (; i + 1 < pixels; i++) {
+        int rgb;
+        memcpy(&rgb, color + 3 * i, sizeof(int));
+
+        __m128i pixel = _mm_cvtepu8_epi32(_mm_cvtsi32_si128(rgb));
+        pixel = _mm_insert_epi32(pixel, depth[i], 3);
+
+        const __m128 values = _mm_mul_ps(_mm_cvtepi32_ps(pixel), scale);
+        _mm_storel_epi64((__m128i*)(out + 4 * i), _mm_cvtps_ph(values, _MM_FROUND_TO_NEAREST_INT));
+    }
+
+    packRowScalar(color + 3 * i, depth + i, pixels - i, metersPerUnit, out + 4 * i);
+}
+}
+
+namespace FramePacking {
+bool hasF16C()
+{
+    static const bool supported = cv::checkHardwareSupport(CV_CPU_SSE4_1) && cv::checkHardwareSupport(CV_CPU_FP16);
+    return supported;
+}
+
+void packRGBD(const cv::Mat& color, const cv::Mat& depth, float metersPerUnit, cv::Mat& out)
+{
+    PROFILE_FUNCTION();
+    CV_Assert(color.type() == CV_8UC3 && depth.type() == CV_16UC1 && color.size() == depth.size());
+
+    out.create(color.size(), CV_16FC4);
+
+    const auto packRow = hasF16C() ? packRowF16C : packRowScalar;
+    for (int row = 0; row < color.rows; row++)
+        packRow(color.ptr<uint8_t>(row), depth.ptr<uint16_t>(row), color.cols, metersPerUnit, out.ptr<cv::float16_t>(row));
+}
+}
@@ -0,0 +1,16 @@
+#pragma once
+#include <opencv2/core.hpp>
+
+namespace FramePacking {
+/// <summary>
+/// Pack an 8-bit colour frame and a 16-bit depth frame into the RGB-D layout of the recordings in a single pass.
+/// Every pixel becomes four FP16 values, the colour channels in the order of the colour frame normalised to [0, 1] and the depth in m.
+/// Uses F16C if the CPU supports it.
+/// </summary>
+/// <param name="color">CV_8UC3</param>
+/// <param name="depth">CV_16UC1 of the same size</param>
+/// <param name="out">Reallocated to CV_16FC4 only if its size or type does not match, so a pooled frame can be passed</param>
+void packRGBD(const cv::Mat& color, const cv::Mat& depth, float metersPerUnit, cv::Mat& out);
+
+bool hasF16C();
+}
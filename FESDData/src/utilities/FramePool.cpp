@@ -0,0 +1,214 @@
+#include "FramePool.h"
+
+#include <algorithm>
+#include <new>
+
+#include <imgui.h>
+
+#include "utilities/Profiler.h"
+
+///
+/// Statistics
+///
+
+FramePool::Statistics::operator Json::Value() const
+{
+    Json::Value val;
+
+    val["Acquired"] = (Json::UInt64)Acquired;
+    val["Allocated"] = (Json::UInt64)Allocated;
+    val["Exhausted"] = (Json::UInt64)Exhausted;
+    val["Allocated Bytes"] = (Json::UInt64)AllocatedBytes;
+    val["High-Water Bytes"] = (Json::UInt64)HighWaterBytes;
+    val["High-Water Buffers"] = HighWaterBuffers;
+    val["Formats"] = Formats;
+
+    return val;
+}
+
+void FramePool::Statistics::showStatistics() const
+{
+    ImGui::Text("Frame Pool: %.1f MB in %d formats", (double)AllocatedBytes / (1024.0 * 1024.0), Formats);
+    ImGui::Text("In Use: %d (%.1f MB), high-water %d (%.1f MB)", BuffersInUse, (double)BytesInUse / (1024.0 * 1024.0),
+                HighWaterBuffers, (double)HighWaterBytes / (1024.0 * 1024.0));
+    ImGui::Text("Acquired: %llu, Allocated: %llu, Exhausted: %llu", (unsigned long long)Acquired, (unsigned long long)Allocated, (unsigned long long)Exhausted);
+}
+
+///
+/// Pool
+///
+
+FramePool::~FramePool()
+{
+    trim();
+}
+
+FramePool& FramePool::getInstance()
+{
+    static FramePool* pool = new FramePool();
+    return *pool;
+}
+
+cv::Mat FramePool::acquire(int rows, int cols, int type)
+{
+    cv::Mat mat = acquire();
+    mat.create(rows, cols, type);
+    return mat;
+}
+
+cv::Mat FramePool::acquire()
+{
+    cv::Mat mat;
+    mat.allocator = this;
+    return mat;
+}
+
+void FramePool::trim()
+{
+    std::lock_guard<std::mutex> lock(m_Mutex);
+    for (auto& format : m_Formats) {
+        for (auto data : format.Free)
+            freeBuffer(data);
+
+        format.Buffers -= (int)format.Free.size();
+        m_Statistics.AllocatedBytes -= format.Bytes * format.Free.size();
+        format.Free.clear();
+    }
+}
+
+FramePool::Statistics FramePool::getStatistics() const
+{
+    std::lock_guard<std::mutex> lock(m_Mutex);
+    return m_Statistics;
+}
+
+void FramePool::resetStatistics()
+{
+    std::lock_guard<std::mutex> lock(m_Mutex);
+    m_Statistics.Acquired = 0;
+    m_Statistics.Allocated = 0;
+    m_Statistics.Exhausted = 0;
+    m_Statistics.HighWaterBytes = m_Statistics.BytesInUse;
+    m_Statistics.HighWaterBuffers = m_Statistics.BuffersInUse;
+}
+
+bool FramePool::makeRoom(size_t bytes) const
+{
+    if (m_Statistics.AllocatedBytes + bytes <= m_Params.ByteBudget)
+        return true;
+
+    for (auto& format : m_Formats) {
+        while (!format.Free.empty() && m_Statistics.AllocatedBytes + bytes > m_Params.ByteBudget) {
+            freeBuffer(format.Free.back());
+            format.Free.pop_back();
+            format.Buffers--;
+            m_Statistics.AllocatedBytes -= format.Bytes;
+        }
+    }
+
+    return m_Statistics.AllocatedBytes + bytes <= m_Params.ByteBudget;
+}
+
+void FramePool::freeBuffer(cv::UMatData* data) const
+{
+    cv::fastFree(data->origdata);
+    data->origdata = data->data = nullptr;
+    delete data;
+}
+
+///
+/// cv::MatAllocator
+///
+
+cv::UMatData* FramePool::allocate(int dims, const int* sizes, int type, void* data, size_t* step, cv::AccessFlag flags, cv::UMatUsageFlags usageFlags) const
+{
+    // Only frames are pooled, matrices on user memory and of more dimensions are left to OpenCV
+    if (data != nullptr || dims != 2)
+        return cv::Mat::getStdAllocator()->allocate(dims, sizes, type, data, step, flags, usageFlags);
+
+    // Continuous layout, as the default allocator
+    const size_t elemSize = CV_ELEM_SIZE(type);
+    const size_t bytes = elemSize * sizes[0] * sizes[1];
+    if (step) {
+        step[1] = elemSize;
+        step[0] = elemSize * sizes[1];
+    }
+
+    PROFILE_FUNCTION();
+    std::lock_guard<std::mutex> lock(m_Mutex);
+    auto format = std::find_if(m_Formats.begin(), m_Formats.end(), [&](const Format& f) { return f.Rows == sizes[0] && f.Cols == sizes[1] && f.Type == CV_MAT_TYPE(type); });
+    if (format == m_Formats.end()) {
+        auto& added = m_Formats.emplace_back();
+        added.Rows = sizes[0];
+        added.Cols = sizes[1];
+        added.Type = CV_MAT_TYPE(type);
+        added.Bytes = bytes;
+        added.Free.reserve(m_Params.MaxBuffersPerFormat);
+        format = m_Formats.end() - 1;
+        m_Statistics.Formats = (int)m_Formats.size();
+    }
+
+    cv::UMatData* u = nullptr;
+    if (!format->Free.empty()) {
+        u = format->Free.back();
+        format->Free.pop_back();
+    }
+    else if (format->Buffers < m_Params.MaxBuffersPerFormat && makeRoom(bytes)) {
+        u = new cv::UMatData(this);
+        u->data = u->origdata = (uchar*)cv::fastMalloc(bytes);
+        u->size = bytes;
+        u->allocatorFlags_ = (int)(format - m_Formats.begin());
+
+        format->Buffers++;
+        m_Statistics.Allocated++;
+        m_Statistics.AllocatedBytes += bytes;
+    }
+    else {
+        m_Statistics.Exhausted++;
+        return cv::Mat::getStdAllocator()->allocate(dims, sizes, type, data, step, flags, usageFlags);
+    }
+
+    m_Statistics.Acquired++;
+    m_Statistics.BuffersInUse++;
+    m_Statistics.BytesInUse += bytes;
+    m_Statistics.HighWaterBuffers = std::max(m_Statistics.HighWaterBuffers, m_Statistics.BuffersInUse);
+    m_Statistics.HighWaterBytes = std::max(m_Statistics.HighWaterBytes, m_Statistics.BytesInUse);
+
+    return u;
+}
+
+bool FramePool::allocate(cv::UMatData* data, cv::AccessFlag accessFlags, cv::UMatUsageFlags usageFlags) const
+{
+    return data != nullptr;
+}
+
+void FramePool::deallocate(cv::UMatData* data) const
+{
+    if (!data)
+        return;
+
+    CV_Assert(data->urefcount == 0 && data->refcount == 0);
+
+    std::lock_guard<std::mutex> lock(m_Mutex);
+    auto& format = m_Formats[data->allocatorFlags_];
+    m_Statistics.BuffersInUse--;
+    m_Statistics.BytesInUse -= format.Bytes;
+
+    // The budget may have been lowered while the buffer was in use
+    if (m_Statistics.AllocatedBytes > m_Params.ByteBudget) {
+        freeBuffer(data);
+        format.Buffers--;
+        m_Statistics.AllocatedBytes -= format.Bytes;
+        return;
+    }
+
+    // Reset to a fresh buffer, the memory is kept
+    uchar* memory = data->origdata;
+    data->~UMatData();
+    new (data) cv::UMatData(this);
+    data->data = data->origdata = memory;
+    data->size = format.Bytes;
+    data->allocatorFlags_ = (int)(&format - m_Formats.data());
+
+    format.Free.push_back(data);
+}
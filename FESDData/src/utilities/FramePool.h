@@ -0,0 +1,102 @@
+#pragma once
+#include <cstdint>
+#include <mutex>
+#include <vector>
+
+#include <opencv2/core.hpp>
+#include <json/json.h>
+
+/// <summary>
+/// Bounded pool of frame buffers, one list of buffers per resolution and format. The pool is an OpenCV allocator, so a cv::Mat
+/// acquired from it is the reference counted handle: copies share the buffer and it returns to the pool once the last copy is released.
+/// OpenCV functions writing into such a matrix allocate from the pool as well. Once the budget or the buffers of a format are exhausted
+/// the frame is allocated on the heap as usual and counted, so the pool never fails an allocation.
+/// </summary>
+class FramePool : public cv::MatAllocator
+{
+public:
+	struct Parameters
+	{
+		size_t ByteBudget{ 512ull * 1024 * 1024 };	// Memory of all pooled buffers, in use or free (in bytes)
+		int MaxBuffersPerFormat{ 32 };
+	};
+
+	struct Statistics
+	{
+		uint64_t Acquired{ 0 };		// Allocations served by the pool
+		uint64_t Allocated{ 0 };	// Buffers allocated for the pool, only grows while the pool fills up
+		uint64_t Exhausted{ 0 };	// Allocations which fell back to the heap
+		size_t AllocatedBytes{ 0 };
+		size_t BytesInUse{ 0 };
+		size_t HighWaterBytes{ 0 };	// Largest BytesInUse so far
+		int BuffersInUse{ 0 };
+		int HighWaterBuffers{ 0 };	// Largest BuffersInUse so far
+		int Formats{ 0 };
+
+		explicit operator Json::Value() const;
+		void showStatistics() const;
+	};
+
+	FramePool() = default;
+	explicit FramePool(Parameters params) : m_Params(params) { }
+	~FramePool() override;
+
+	FramePool(const FramePool&) = delete;
+	FramePool& operator=(const FramePool&) = delete;
+
+	/// <summary>
+	/// Pool shared by capture, recording and playback. It is never destroyed, frames may be released during static destruction
+	/// </summary>
+	static FramePool& getInstance();
+
+	Parameters& getParameters() { return m_Params; }
+
+	/// <summary>
+	/// Frame of this size and type, its content is undefined
+	/// </summary>
+	cv::Mat acquire(int rows, int cols, int type);
+	/// <summary>
+	/// Empty matrix, e.g. for the output of OpenCV functions which size it themselves
+	/// </summary>
+	cv::Mat acquire();
+	/// <summary>
+	/// Free the buffers which are not in use
+	/// </summary>
+	void trim();
+
+	Statistics getStatistics() const;
+	/// <summary>
+	/// Reset the counters and the high-water marks to the buffers in use, e.g. at the start of a recording
+	/// </summary>
+	void resetStatistics();
+
+	///
+	/// cv::MatAllocator
+	///
+
+	cv::UMatData* allocate(int dims, const int* sizes, int type, void* data, size_t* step, cv::AccessFlag flags, cv::UMatUsageFlags usageFlags) const override;
+	bool allocate(cv::UMatData* data, cv::AccessFlag accessFlags, cv::UMatUsageFlags usageFlags) const override;
+	void deallocate(cv::UMatData* data) const override;
+private:
+	struct Format
+	{
+		int Rows{ 0 };
+		int Cols{ 0 };
+		int Type{ 0 };
+		size_t Bytes{ 0 };
+		int Buffers{ 0 };						// Allocated, in use or free
+		std::vector<cv::UMatData*> Free{ };		// Keeps its capacity, returning a buffer does not allocate
+	};
+
+	/// <summary>
+	/// Free buffers of other formats until a buffer of this size fits into the budget
+	/// </summary>
+	bool makeRoom(size_t bytes) const;
+	void freeBuffer(cv::UMatData* data) const;
+
+	Parameters m_Params{ };
+
+	mutable std::mutex m_Mutex{ };
+	mutable std::vector<Format> m_Formats{ };	// Only grows, the index of a format is stored with its buffers
+	mutable Statistics m_Statistics{ };
+};
@@ -0,0 +1,351 @@
+#include "FrameWriter.h"
+
+#include <algorithm>
+#include <cerrno>
+#include <chrono>
+#include <cmath>
+#include <exception>
+#include <format>
+
+#include <imgui.h>
+
+#ifdef _WIN32
+#ifndef NOMINMAX
+#define NOMINMAX
+#endif
+#ifndef WIN32_LEAN_AND_MEAN
+#define WIN32_LEAN_AND_MEAN
+#endif
+#include <Windows.h>
+#else
+#include <fcntl.h>
+#include <unistd.h>
+#endif
+
+#include "utilities/Profiler.h"
+
+namespace {
+size_t alignUp(size_t size)
+{
+    return (size + FrameWriter::Alignment - 1) / FrameWriter::Alignment * FrameWriter::Alignment;
+}
+
+/// <summary>
+/// Write one frame into a new file, data holds alignUp(size) bytes and the file is cut to size afterwards
+/// </summary>
+bool writeFile(const std::filesystem::path& path, const char* data, size_t size, bool direct)
+{
+    const size_t aligned = alignUp(size);
+#ifdef _WIN32
+    const DWORD flags = FILE_ATTRIBUTE_NORMAL | (direct ? FILE_FLAG_NO_BUFFERING : 0);
+    HANDLE file = CreateFileW(path.c_str(), GENERIC_WRITE, 0, nullptr, CREATE_ALWAYS, flags, nullptr);
+    if (file == INVALID_HANDLE_VALUE)
+        return false;
+
+    // Reserve the whole frame so it is written into one extent
+    FILE_ALLOCATION_INFO allocation{ };
+    allocation.AllocationSize.QuadPart = (LONGLONG)aligned;
+    SetFileInformationByHandle(file, FileAllocationInfo, &allocation, sizeof(allocation));
+
+    bool ok = true;
+    size_t offset = 0;
+    while (ok && offset < aligned) {
+        const DWORD chunk = (DWORD)std::min<size_t>(aligned - offset, 1ull << 30);
+        DWORD written = 0;
+        ok = WriteFile(file, data + offset, chunk, &written, nullptr) && written == chunk;
+        offset += written;
+    }
+
+    // The padding of the last sector is not part of the frame
+    FILE_END_OF_FILE_INFO end{ };
+    end.EndOfFile.QuadPart = (LONGLONG)size;
+    ok = ok && SetFileInformationByHandle(file, FileEndOfFileInfo, &end, sizeof(end));
+
+    return CloseHandle(file) && ok;
+#else
+    int flags = O_WRONLY | O_CREAT | O_TRUNC;
+#ifdef O_DIRECT
+    if (direct)
+        flags |= O_DIRECT;
+#endif
+    int fd = ::open(path.c_str(), flags, 0644);
+    if (fd < 0 && direct) {
+        // File systems without direct I/O (e.g. tmpfs) go through the page cache
+        fd = ::open(path.c_str(), O_WRONLY | O_CREAT | O_TRUNC, 0644);
+    }
+    if (fd < 0)
+        return false;
+
+#ifdef __linux__
+    // Reserve the whole frame so it is written into one extent
+    posix_fallocate(fd, 0, (off_t)aligned);
+#endif
+
+    bool ok = true;
+    size_t offset = 0;
+    while (ok && offset < aligned) {
+        const ssize_t written = ::write(fd, data + offset, aligned - offset);
+        if (written < 0 && errno == EINTR)
+            continue;
+
+        ok = written > 0;
+        offset += ok ? (size_t)written : 0;
+    }
+
+    // The padding of the last sector is not part of the frame
+    ok = ok && ::ftruncate(fd, (off_t)size) == 0;
+
+    return ::close(fd) == 0 && ok;
+#endif
+}
+}
+
+///
+/// Statistics
+///
+
+int FrameWriter::Statistics::getBucket(double latency)
+{
+    if (latency < 1.0)
+        return 0;
+
+    return std::min(LatencyBuckets - 1, 1 + (int)std::floor(std::log2(latency)));
+}
+
+FrameWriter::Statistics::operator Json::Value() const
+{
+    Json::Value val;
+
+    val["Frames"] = (Json::UInt64)Frames;
+    val["Bytes"] = (Json::UInt64)Bytes;
+    val["Failed"] = (Json::UInt64)Failed;
+    val["Stalls"] = (Json::UInt64)Stalls;
+    val["Mean Latency"] = getMeanLatency();
+    val["Max Latency"] = MaxLatency;
+
+    // Bucket i counts the writes which took less than 2^i ms, the last one all slower writes
+    Json::Value histogram{ Json::arrayValue };
+    for (auto count : Histogram)
+        histogram.append((Json::UInt64)count);
+    val["Latency Histogram"] = histogram;
+
+    return val;
+}
+
+void FrameWriter::Statistics::showStatistics() const
+{
+    ImGui::Text("Frames Written: %llu (%.1f MB)", (unsigned long long)Frames, (double)Bytes / (1024.0 * 1024.0));
+    ImGui::Text("Write Latency: mean %.2f ms, max %.2f ms", getMeanLatency(), MaxLatency);
+    ImGui::Text("Failed: %llu, Stalls: %llu", (unsigned long long)Failed, (unsigned long long)Stalls);
+
+    std::vector<float> histogram(Histogram.begin(), Histogram.end());
+    const float max = *std::max_element(histogram.begin(), histogram.end());
+    auto overlay = std::format("1 ms - {} ms", 1 << (LatencyBuckets - 2));
+    ImGui::PlotHistogram("Write Latency", histogram.data(), (int)histogram.size(), 0, overlay.c_str(), 0.0f, std::max(max, 1.0f), ImVec2(0, 60.0f));
+}
+
+///
+/// Writer
+///
+
+FrameWriter::~FrameWriter()
+{
+    stop();
+}
+
+void FrameWriter::start()
+{
+    stop();
+
+    {
+        std::lock_guard<std::mutex> lock(m_Mutex);
+        m_Statistics = Statistics{ };
+    }
+
+    m_Thread = std::jthread([this](std::stop_token stop) { run(stop); });
+}
+
+void FrameWriter::stop()
+{
+    PROFILE_FUNCTION();
+    if (!m_Thread.joinable())
+        return;
+
+    // The thread drains the queue before it returns
+    m_Thread.request_stop();
+    m_Thread.join();
+}
+
+int FrameWriter::reserve(size_t frameBytes, int frames)
+{
+    const size_t capacity = alignUp(frameBytes);
+
+    std::lock_guard<std::mutex> lock(m_Mutex);
+    int available = (int)std::count_if(m_FreeBuffers.begin(), m_FreeBuffers.end(), [capacity](const auto& buffer) { return buffer->Capacity >= capacity; });
+
+    while (available < frames && m_AllocatedBytes + capacity <= m_Params.BufferBudget) {
+        m_FreeBuffers.push_back(allocateBuffer(capacity));
+        m_AllocatedBytes += capacity;
+        available++;
+    }
+
+    return available;
+}
+
+std::unique_ptr<FrameWriter::Buffer> FrameWriter::allocateBuffer(size_t size)
+{
+    auto buffer = std::make_unique<Buffer>();
+    buffer->Capacity = alignUp(size);
+    buffer->Memory.resize(buffer->Capacity + Alignment);
+
+    const auto address = reinterpret_cast<uintptr_t>(buffer->Memory.data());
+    buffer->Data = buffer->Memory.data() + (alignUp(address) - address);
+
+    return buffer;
+}
+
+std::unique_ptr<FrameWriter::Buffer> FrameWriter::acquireBuffer(size_t size)
+{
+    const size_t capacity = alignUp(size);
+    bool stalled = false;
+
+    std::unique_lock<std::mutex> lock(m_Mutex);
+    while (true) {
+        auto best = m_FreeBuffers.end();
+        size_t freeBytes = 0;
+        for (auto it = m_FreeBuffers.begin(); it != m_FreeBuffers.end(); it++) {
+            freeBytes += (*it)->Capacity;
+            if ((*it)->Capacity >= capacity && (best == m_FreeBuffers.end() || (*it)->Capacity < (*best)->Capacity))
+                best = it;
+        }
+
+        if (best != m_FreeBuffers.end()) {
+            auto buffer = std::move(*best);
+            m_FreeBuffers.erase(best);
+            m_InFlight++;
+            m_Statistics.Stalls += stalled;
+            return buffer;
+        }
+
+        // Free buffers which are too small make room for a larger one, a frame larger than the budget is only written on its own
+        if (m_AllocatedBytes - freeBytes + capacity <= m_Params.BufferBudget || m_InFlight == 0) {
+            if (m_AllocatedBytes + capacity > m_Params.BufferBudget) {
+                for (const auto& buffer : m_FreeBuffers)
+                    m_AllocatedBytes -= buffer->Capacity;
+                m_FreeBuffers.clear();
+            }
+
+            m_AllocatedBytes += capacity;
+            m_InFlight++;
+            m_Statistics.Stalls += stalled;
+            break;
+        }
+
+        stalled = true;
+        m_BufferFreed.wait(lock);
+    }
+    lock.unlock();
+
+    return allocateBuffer(capacity);
+}
+
+bool FrameWriter::write(const std::filesystem::path& path, const std::vector<FrameIO::Plane>& planes)
+{
+    PROFILE_FUNCTION();
+    if (!m_Thread.joinable())
+        return false;
+
+    auto buffer = acquireBuffer(FrameIO::getPlanarSize(planes));
+    buffer->Size = FrameIO::writePlanes(buffer->Data, buffer->Capacity, planes);
+    buffer->Path = path;
+
+    {
+        std::lock_guard<std::mutex> lock(m_Mutex);
+        m_Queue.push_back(std::move(buffer));
+    }
+    m_QueueChanged.notify_one();
+
+    return true;
+}
+
+bool FrameWriter::write(const std::filesystem::path& path, std::function<std::vector<FrameIO::Plane>()> produce)
+{
+    if (!m_Thread.joinable())
+        return false;
+
+    auto buffer = std::make_unique<Buffer>();
+    buffer->Path = path;
+    buffer->Produce = std::move(produce);
+
+    {
+        std::lock_guard<std::mutex> lock(m_Mutex);
+        m_Queue.push_back(std::move(buffer));
+    }
+    m_QueueChanged.notify_one();
+
+    return true;
+}
+
+void FrameWriter::run(std::stop_token stop)
+{
+    while (true) {
+        std::unique_ptr<Buffer> buffer;
+        {
+            std::unique_lock<std::mutex> lock(m_Mutex);
+            if (!m_QueueChanged.wait(lock, stop, [this]() { return !m_Queue.empty(); }))
+                return;
+
+            buffer = std::move(m_Queue.front());
+            m_Queue.pop_front();
+        }
+
+        const auto start = std::chrono::steady_clock::now();
+        bool ok = false;
+        if (buffer->Produce) {
+            try {
+                buffer->Size = FrameIO::writePlanes(buffer->Path, buffer->Produce());
+                ok = buffer->Size > 0;
+            }
+            catch (const std::exception&) {
+                // E.g. a frame which could not be decoded, counted as failed
+            }
+        }
+        else {
+            ok = buffer->Size > 0 && writeFile(buffer->Path, buffer->Data, buffer->Size, m_Params.DirectIO);
+        }
+        const double latency = std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start).count();
+
+        {
+            std::lock_guard<std::mutex> lock(m_Mutex);
+            if (ok) {
+                m_Statistics.Frames++;
+                m_Statistics.Bytes += buffer->Size;
+                m_Statistics.TotalLatency += latency;
+                m_Statistics.MaxLatency = std::max(m_Statistics.MaxLatency, latency);
+                m_Statistics.Histogram[Statistics::getBucket(latency)]++;
+            }
+            else {
+                m_Statistics.Failed++;
+            }
+
+            // Produced frames were written from their own memory
+            if (!buffer->Produce) {
+                m_FreeBuffers.push_back(std::move(buffer));
+                m_InFlight--;
+            }
+        }
+        m_BufferFreed.notify_all();
+    }
+}
+
+FrameWriter::Statistics FrameWriter::getStatistics() const
+{
+    std::lock_guard<std::mutex> lock(m_Mutex);
+    return m_Statistics;
+}
+
+size_t FrameWriter::getAllocatedBytes() const
+{
+    std::lock_guard<std::mutex> lock(m_Mutex);
+    return m_AllocatedBytes;
+}
@@ -0,0 +1,119 @@
+#pragma once
+#include <array>
+#include <condition_variable>
+#include <cstdint>
+#include <deque>
+#include <filesystem>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+#include <json/json.h>
+
+#include "FrameIO.h"
+
+/// <summary>
+/// Writes planar frames from a dedicated I/O thread past the page cache, so the OS flushing dirty pages does not stall capture.
+/// write() serialises the frame into an aligned buffer on the calling thread and queues it, the I/O thread writes it with O_DIRECT
+/// (FILE_FLAG_NO_BUFFERING on Windows) into a file preallocated to its size. Buffers are reused for the next frames, their total
+/// size is bounded by the budget and write() waits for a free buffer once it is exhausted.
+/// </summary>
+class FrameWriter
+{
+public:
+	static constexpr size_t Alignment{ 4096 };	// Direct I/O needs addresses, sizes and offsets aligned to the sector size
+	static constexpr int LatencyBuckets{ 12 };	// < 1 ms, < 2 ms, < 4 ms, ..., >= 1024 ms
+
+	struct Parameters
+	{
+		bool DirectIO{ true };
+		size_t BufferBudget{ 512ull * 1024 * 1024 };	// Memory of the frames waiting to be written (in bytes)
+	};
+
+	struct Statistics
+	{
+		uint64_t Frames{ 0 };
+		uint64_t Bytes{ 0 };
+		uint64_t Failed{ 0 };
+		uint64_t Stalls{ 0 };		// Frames which waited for a buffer because the budget was exhausted
+		double TotalLatency{ 0.0 };	// Open, write and close of all frames (in ms)
+		double MaxLatency{ 0.0 };	// (in ms)
+		std::array<uint64_t, LatencyBuckets> Histogram{ };
+
+		static int getBucket(double latency);
+		double getMeanLatency() const { return Frames > 0 ? TotalLatency / Frames : 0.0; }
+
+		explicit operator Json::Value() const;
+		void showStatistics() const;
+	};
+
+	FrameWriter() = default;
+	explicit FrameWriter(Parameters params) : m_Params(params) { }
+	~FrameWriter();
+
+	FrameWriter(const FrameWriter&) = delete;
+	FrameWriter& operator=(const FrameWriter&) = delete;
+
+	Parameters& getParameters() { return m_Params; }
+
+	/// <summary>
+	/// Start the I/O thread and reset the statistics, the buffers of an earlier session are kept
+	/// </summary>
+	void start();
+	/// <summary>
+	/// Write all queued frames and stop the I/O thread
+	/// </summary>
+	void stop();
+	/// <summary>
+	/// Allocate buffers for frames of this size up front, so the first frames of a session do not allocate
+	/// </summary>
+	/// <returns>Number of buffers of this size available, bounded by the budget</returns>
+	int reserve(size_t frameBytes, int frames);
+
+	/// <summary>
+	/// Queue the planes of a frame, they are copied and can be reused right away
+	/// </summary>
+	/// <returns>False if the writer is not running</returns>
+	bool write(const std::filesystem::path& path, const std::vector<FrameIO::Plane>& planes);
+	/// <summary>
+	/// Queue a frame whose planes are produced on the I/O thread, e.g. decoded from a compressed copy.
+	/// It is written through the page cache and does not take a buffer of the budget.
+	/// </summary>
+	/// <returns>False if the writer is not running</returns>
+	bool write(const std::filesystem::path& path, std::function<std::vector<FrameIO::Plane>()> produce);
+
+	Statistics getStatistics() const;
+	size_t getAllocatedBytes() const;
+private:
+	struct Buffer
+	{
+		std::vector<char> Memory{ };
+		char* Data{ nullptr };		// Aligned start within Memory
+		size_t Capacity{ 0 };		// Multiple of the alignment
+		size_t Size{ 0 };			// Bytes of the frame
+		std::filesystem::path Path{ };
+		std::function<std::vector<FrameIO::Plane>()> Produce{ };	// Set for frames produced on the I/O thread, which have no memory
+	};
+
+	/// <summary>
+	/// Smallest free buffer of at least this size, allocated if the budget allows, waits for one otherwise
+	/// </summary>
+	std::unique_ptr<Buffer> acquireBuffer(size_t size);
+	std::unique_ptr<Buffer> allocateBuffer(size_t size);
+	void run(std::stop_token stop);
+
+	Parameters m_Params{ };
+
+	mutable std::mutex m_Mutex{ };
+	std::condition_variable_any m_QueueChanged{ };
+	std::condition_variable m_BufferFreed{ };
+	std::deque<std::unique_ptr<Buffer>> m_Queue{ };
+	std::vector<std::unique_ptr<Buffer>> m_FreeBuffers{ };
+	size_t m_AllocatedBytes{ 0 };
+	int m_InFlight{ 0 };			// Buffers taken by write() which were not written yet
+	Statistics m_Statistics{ };
+
+	std::jthread m_Thread{ };
+};
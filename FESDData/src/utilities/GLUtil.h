@@ -8,6 +8,7 @@
 #include <glm/glm.hpp>
 
 #include <GLCore/Renderer.h>
+#include <GLCore/UniformBuffer.h>
 #include <GLCore/VertexBuffer.h>
 #include <GLCore/VertexBufferLayout.h>
 
@@ -19,6 +20,7 @@ struct GLUtil
 	std::unique_ptr<Shader> m_Shader;
 	std::unique_ptr<VertexBuffer> m_VB;
 	std::unique_ptr<VertexBufferLayout> m_VBL;
+	std::unique_ptr<UniformBuffer> m_UniformBuffer;
 
 	static void setFlags() {
 		GLCall(glPointSize(1.5f));
@@ -0,0 +1,338 @@
+#include "Profiler.h"
+
+#include <algorithm>
+#include <ctime>
+#include <fstream>
+#include <map>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <string_view>
+#include <unordered_map>
+
+#include <imgui.h>
+#include <json/json.h>
+
+namespace Profiler {
+namespace {
+std::atomic<bool> s_Enabled{ true };
+
+std::mutex s_RegistryMutex;
+std::vector<std::unique_ptr<ThreadBuffer>> s_Buffers;
+std::map<uint32_t, std::string> s_ThreadNames;
+
+/// Releases the buffer of a thread when it finishes so the next thread can reuse it
+struct ThreadSlot
+{
+    ThreadBuffer* Buffer{ nullptr };
+
+    ~ThreadSlot()
+    {
+        if (Buffer != nullptr)
+            Buffer->m_InUse.store(false, std::memory_order_release);
+    }
+};
+
+thread_local ThreadSlot t_Slot;
+
+// Panel state
+bool s_Paused{ false };
+float s_WindowMs{ 50.0f };
+int64_t s_WindowEnd{ 0 };
+std::vector<Event> s_Snapshot;
+std::string s_LastTrace{ };
+
+std::string getThreadName(uint32_t threadId)
+{
+    std::lock_guard<std::mutex> lock(s_RegistryMutex);
+    auto name = s_ThreadNames.find(threadId);
+    if (name != s_ThreadNames.end())
+        return name->second;
+
+    return "Thread " + std::to_string(threadId);
+}
+
+ImU32 getZoneColor(const char* name)
+{
+    auto hash = std::hash<std::string_view>{}(name);
+    return ImColor::HSV((hash % 360) / 360.0f, 0.45f, 0.75f);
+}
+
+void showTimeline(int64_t windowStart, int64_t windowEnd)
+{
+    const float rowHeight = ImGui::GetTextLineHeightWithSpacing();
+    const double windowLength = (double)std::max<int64_t>(windowEnd - windowStart, 1);
+
+    std::map<uint32_t, std::vector<const Event*>> threads;
+    for (const auto& e : s_Snapshot)
+        threads[e.ThreadId].push_back(&e);
+
+    for (const auto& [threadId, events] : threads) {
+        uint32_t maxDepth = 0;
+        for (auto e : events)
+            maxDepth = std::max(maxDepth, e->Depth);
+
+        ImGui::TextUnformatted(getThreadName(threadId).c_str());
+
+        ImVec2 pos = ImGui::GetCursorScreenPos();
+        ImVec2 size{ std::max(ImGui::GetContentRegionAvail().x, 100.0f), rowHeight * (maxDepth + 1) };
+        ImGui::InvisibleButton(("##Timeline" + std::to_string(threadId)).c_str(), size);
+
+        auto drawList = ImGui::GetWindowDrawList();
+        drawList->AddRectFilled(pos, { pos.x + size.x, pos.y + size.y }, IM_COL32(30, 30, 30, 255));
+        drawList->PushClipRect(pos, { pos.x + size.x, pos.y + size.y }, true);
+
+        for (auto e : events) {
+            float x0 = pos.x + (float)((e->Start - windowStart) / windowLength) * size.x;
+            float x1 = pos.x + (float)((e->End - windowStart) / windowLength) * size.x;
+            x1 = std::max(x1, x0 + 1.0f);
+            float y0 = pos.y + e->Depth * rowHeight;
+            float y1 = y0 + rowHeight - 1.0f;
+
+            drawList->AddRectFilled({ x0, y0 }, { x1, y1 }, getZoneColor(e->Name));
+
+            if (ImGui::CalcTextSize(e->Name).x < x1 - x0 - 4.0f)
+                drawList->AddText({ x0 + 2.0f, y0 }, IM_COL32_BLACK, e->Name);
+
+            if (ImGui::IsItemHovered() && ImGui::IsMouseHoveringRect({ x0, y0 }, { x1, y1 })) {
+                ImGui::BeginTooltip();
+                ImGui::Text("%s: %.3f ms", e->Name, (e->End - e->Start) / 1e6);
+                ImGui::EndTooltip();
+            }
+        }
+
+        drawList->PopClipRect();
+    }
+}
+
+void showZoneTable()
+{
+    struct ZoneStats
+    {
+        int Calls{ 0 };
+        int64_t Total{ 0 };
+        int64_t Max{ 0 };
+    };
+
+    std::unordered_map<std::string_view, ZoneStats> zones;
+    for (const auto& e : s_Snapshot) {
+        auto& stats = zones[e.Name];
+        stats.Calls++;
+        stats.Total += e.End - e.Start;
+        stats.Max = std::max(stats.Max, e.End - e.Start);
+    }
+
+    std::vector<std::pair<std::string_view, ZoneStats>> sorted(zones.begin(), zones.end());
+    std::sort(sorted.begin(), sorted.end(), [](const auto& a, const auto& b) { return a.second.Total > b.second.Total; });
+
+    if (ImGui::BeginTable("Zones", 5, ImGuiTableFlags_Borders | ImGuiTableFlags_RowBg | ImGuiTableFlags_Resizable)) {
+        ImGui::TableSetupColumn("Zone");
+        ImGui::TableSetupColumn("Calls");
+        ImGui::TableSetupColumn("Total ms");
+        ImGui::TableSetupColumn("Avg ms");
+        ImGui::TableSetupColumn("Max ms");
+        ImGui::TableHeadersRow();
+
+        for (const auto& [name, stats] : sorted) {
+            ImGui::TableNextRow();
+            ImGui::TableNextColumn();
+            ImGui::TextUnformatted(name.data(), name.data() + name.size());
+            ImGui::TableNextColumn();
+            ImGui::Text("%d", stats.Calls);
+            ImGui::TableNextColumn();
+            ImGui::Text("%.3f", stats.Total / 1e6);
+            ImGui::TableNextColumn();
+            ImGui::Text("%.3f", stats.Total / 1e6 / stats.Calls);
+            ImGui::TableNextColumn();
+            ImGui::Text("%.3f", stats.Max / 1e6);
+        }
+
+        ImGui::EndTable();
+    }
+}
+}
+
+///
+/// Recording
+///
+
+ThreadBuffer& ThreadBuffer::local()
+{
+    if (t_Slot.Buffer != nullptr)
+        return *t_Slot.Buffer;
+
+    std::lock_guard<std::mutex> lock(s_RegistryMutex);
+
+    for (auto& buffer : s_Buffers) {
+        bool inUse = false;
+        if (buffer->m_InUse.compare_exchange_strong(inUse, true, std::memory_order_acquire)) {
+            buffer->m_Depth = 0;
+            s_ThreadNames.erase(buffer->getThreadId());
+            t_Slot.Buffer = buffer.get();
+            return *t_Slot.Buffer;
+        }
+    }
+
+    s_Buffers.push_back(std::make_unique<ThreadBuffer>((uint32_t)s_Buffers.size()));
+    s_Buffers.back()->m_InUse.store(true, std::memory_order_relaxed);
+    t_Slot.Buffer = s_Buffers.back().get();
+
+    return *t_Slot.Buffer;
+}
+
+void ThreadBuffer::snapshot(std::vector<Event>& events, int64_t since) const
+{
+    auto head = m_Head.load(std::memory_order_acquire);
+    auto first = head > Capacity ? head - Capacity : 0;
+
+    std::vector<Event> copy;
+    copy.reserve(head - first);
+    for (auto i = first; i < head; i++)
+        copy.push_back(m_Events[i % Capacity]);
+
+    // The owner kept writing while copying, entries before valid may have been overwritten. The slot of newHead itself
+    // may be written right now, before the head is published, so the oldest entry sharing its slot is dropped as well
+    auto newHead = m_Head.load(std::memory_order_acquire);
+    auto valid = newHead + 1 > Capacity ? newHead + 1 - Capacity : 0;
+
+    for (size_t i = 0; i < copy.size(); i++) {
+        if (first + i >= valid && copy[i].End >= since)
+            events.push_back(copy[i]);
+    }
+}
+
+void setEnabled(bool enabled)
+{
+    s_Enabled.store(enabled, std::memory_order_relaxed);
+}
+
+bool isEnabled()
+{
+    return s_Enabled.load(std::memory_order_relaxed);
+}
+
+void setThreadName(const char* name)
+{
+    auto threadId = ThreadBuffer::local().getThreadId();
+
+    std::lock_guard<std::mutex> lock(s_RegistryMutex);
+    s_ThreadNames[threadId] = name;
+}
+
+std::vector<Event> collect(int64_t since)
+{
+    std::vector<Event> events;
+
+    {
+        std::lock_guard<std::mutex> lock(s_RegistryMutex);
+        for (const auto& buffer : s_Buffers)
+            buffer->snapshot(events, since);
+    }
+
+    std::sort(events.begin(), events.end(), [](const Event& a, const Event& b) { return a.Start < b.Start; });
+
+    return events;
+}
+
+///
+/// Export
+///
+
+bool saveTrace(const std::filesystem::path& path)
+{
+    auto events = collect();
+    int64_t origin = events.empty() ? 0 : events.front().Start;
+
+    Json::Value traceEvents{ Json::arrayValue };
+
+    std::map<uint32_t, bool> threads;
+    for (const auto& e : events) {
+        Json::Value event;
+        event["name"] = e.Name;
+        event["cat"] = "FESD";
+        event["ph"] = "X";
+        event["ts"] = (e.Start - origin) / 1000.0;
+        event["dur"] = (e.End - e.Start) / 1000.0;
+        event["pid"] = 0;
+        event["tid"] = e.ThreadId;
+        traceEvents.append(event);
+
+        threads[e.ThreadId] = true;
+    }
+
+    for (const auto& [threadId, _] : threads) {
+        Json::Value meta;
+        meta["name"] = "thread_name";
+        meta["ph"] = "M";
+        meta["pid"] = 0;
+        meta["tid"] = threadId;
+        meta["args"]["name"] = getThreadName(threadId);
+        traceEvents.append(meta);
+    }
+
+    Json::Value root;
+    root["traceEvents"] = traceEvents;
+    root["displayTimeUnit"] = "ms";
+
+    std::ofstream traceJson(path, std::ios::out | std::ios::trunc);
+    if (!traceJson.is_open())
+        return false;
+
+    Json::StreamWriterBuilder builder;
+    builder["indentation"] = "";
+    traceJson << Json::writeString(builder, root);
+
+    return traceJson.good();
+}
+
+///
+/// ImGui
+///
+
+void showProfiler()
+{
+    ImGui::Begin("Profiler");
+
+#ifndef FESD_PROFILE
+    ImGui::Text("Built without FESD_PROFILE, no zones are recorded.");
+#endif
+
+    bool enabled = isEnabled();
+    if (ImGui::Checkbox("Record", &enabled))
+        setEnabled(enabled);
+
+    ImGui::SameLine();
+    ImGui::Checkbox("Pause", &s_Paused);
+
+    ImGui::SameLine();
+    if (ImGui::Button("Save Trace")) {
+        char time[32];
+        auto t = std::time(nullptr);
+        std::tm localTime{ };
+        localtime_s(&localTime, &t);
+        std::strftime(time, sizeof(time), "%Y%m%d_%H%M%S", &localTime);
+
+        std::filesystem::path path = (std::string)"Trace_" + time + ".json";
+        s_LastTrace = saveTrace(path) ? "Saved " + std::filesystem::absolute(path).string() : "Could not write " + path.string();
+    }
+
+    if (!s_LastTrace.empty())
+        ImGui::TextUnformatted(s_LastTrace.c_str());
+
+    ImGui::SliderFloat("Window (ms)", &s_WindowMs, 5.0f, 1000.0f, "%.0f", ImGuiSliderFlags_Logarithmic);
+
+    int64_t windowLength = (int64_t)(s_WindowMs * 1e6);
+    if (!s_Paused) {
+        s_WindowEnd = now();
+        s_Snapshot = collect(s_WindowEnd - windowLength);
+    }
+
+    if (ImGui::CollapsingHeader("Timeline", ImGuiTreeNodeFlags_DefaultOpen))
+        showTimeline(s_WindowEnd - windowLength, s_WindowEnd);
+
+    if (ImGui::CollapsingHeader("Zones", ImGuiTreeNodeFlags_DefaultOpen))
+        showZoneTable();
+
+    ImGui::End();
+}
+}
@@ -0,0 +1,129 @@
+#pragma once
+#include <array>
+#include <atomic>
+#include <chrono>
+#include <cstdint>
+#include <filesystem>
+#include <vector>
+
+/// Scoped timing zones
+/// Zones are recorded into a fixed size ring buffer per thread, the owning thread is the only writer so recording a zone
+/// never takes a lock. The ImGui panel and the trace export read a snapshot of all buffers.
+/// Zones are only compiled in if FESD_PROFILE is defined, otherwise PROFILE_SCOPE expands to nothing.
+namespace Profiler {
+struct Event
+{
+	const char* Name{ nullptr };
+	int64_t Start{ 0 };
+	int64_t End{ 0 };
+	uint32_t Depth{ 0 };
+	uint32_t ThreadId{ 0 };
+};
+
+inline int64_t now()
+{
+	return std::chrono::duration_cast<std::chrono::nanoseconds>(std::chrono::steady_clock::now().time_since_epoch()).count();
+}
+
+class ThreadBuffer
+{
+public:
+	static constexpr size_t Capacity{ 1 << 14 };
+
+	explicit ThreadBuffer(uint32_t threadId) : m_ThreadId(threadId) { }
+
+	/// <summary>
+	/// Buffer of the calling thread, a buffer of a finished thread is reused
+	/// </summary>
+	static ThreadBuffer& local();
+
+	/// Only called by the owning thread
+	inline void push(const char* name, int64_t start, int64_t end, uint32_t depth)
+	{
+		auto head = m_Head.load(std::memory_order_relaxed);
+		m_Events[head % Capacity] = { name, start, end, depth, m_ThreadId };
+		m_Head.store(head + 1, std::memory_order_release);
+	}
+
+	/// <summary>
+	/// Copy all events that ended after since, events overwritten while copying are dropped
+	/// </summary>
+	void snapshot(std::vector<Event>& events, int64_t since) const;
+
+	uint32_t getThreadId() const { return m_ThreadId; }
+
+	uint32_t m_Depth{ 0 };
+	std::atomic<bool> m_InUse{ false };
+private:
+	const uint32_t m_ThreadId;
+	std::atomic<uint64_t> m_Head{ 0 };
+	std::array<Event, Capacity> m_Events{ };
+};
+
+void setEnabled(bool enabled);
+bool isEnabled();
+
+/// <summary>
+/// Set the name of the calling thread shown in the panel and in the trace
+/// </summary>
+void setThreadName(const char* name);
+
+/// <summary>
+/// Collect the events of all threads that ended after since, sorted by start time
+/// </summary>
+std::vector<Event> collect(int64_t since = 0);
+
+/// <summary>
+/// Write all recorded events in the Chrome trace_event format (chrome://tracing, Perfetto)
+/// </summary>
+/// <returns>True if the trace could be written</returns>
+bool saveTrace(const std::filesystem::path& path);
+
+void showProfiler();
+
+class Zone
+{
+public:
+	explicit Zone(const char* name)
+	{
+		if (!isEnabled())
+			return;
+
+		mp_Buffer = &ThreadBuffer::local();
+		m_Name = name;
+		m_Depth = mp_Buffer->m_Depth++;
+		m_Start = now();
+	}
+
+	~Zone()
+	{
+		if (mp_Buffer == nullptr)
+			return;
+
+		mp_Buffer->push(m_Name, m_Start, now(), m_Depth);
+		mp_Buffer->m_Depth--;
+	}
+
+	Zone(const Zone&) = delete;
+	Zone& operator=(const Zone&) = delete;
+private:
+	ThreadBuffer* mp_Buffer{ nullptr };
+	const char* m_Name{ nullptr };
+	uint32_t m_Depth{ 0 };
+	int64_t m_Start{ 0 };
+};
+}
+
+#ifdef FESD_PROFILE
+#define PROFILE_CONCAT_INNER(a, b) a##b
+#define PROFILE_CONCAT(a, b) PROFILE_CONCAT_INNER(a, b)
+/// Name has to be a string literal, only the pointer is stored
+#define PROFILE_SCOPE(name) ::Profiler::Zone PROFILE_CONCAT(profileZone, __LINE__){ name }
+#define PROFILE_FUNCTION() PROFILE_SCOPE(__FUNCTION__)
+/// Name of the calling thread in the panel and the trace
+#define PROFILE_THREAD(name) ::Profiler::setThreadName(name)
+#else
+#define PROFILE_SCOPE(name)
+#define PROFILE_FUNCTION()
+#define PROFILE_THREAD(name)
+#endif
@@ -0,0 +1,48 @@
+#pragma once
+#include <vector>
+#include <string>
+#include <filesystem>
+#include <fstream>
+#include <algorithm>
+
+#include <json/json.h>
+
+/// <summary>
+/// Collect the session configs stored in the top level of the recording directory
+/// </summary>
+/// <param name="recordingDirectory">Directory containing one json file per session</param>
+/// <param name="errors">Parse errors of configs that could not be read</param>
+/// <returns>Session configs, newest first</returns>
+inline std::vector<Json::Value> findRecordings(const std::filesystem::path& recordingDirectory, std::vector<std::string>* errors = nullptr) {
+    std::vector<Json::Value> recordings;
+
+    for (const auto& entry : std::filesystem::directory_iterator(recordingDirectory))
+    {
+        if (entry.is_regular_file() &&
+            entry.path().extension() == ".json" &&
+            entry.path().filename().string().find("Skeleton")  == std::string::npos &&
+            entry.path().filename().string().find("Exercises") == std::string::npos &&
+            entry.path().filename().string().find("Errors")    == std::string::npos) {
+            std::ifstream configJson(entry.path());
+            Json::Value root;
+
+            Json::CharReaderBuilder builder;
+
+            builder["collectComments"] = true;
+
+            JSONCPP_STRING errs;
+
+            if (!parseFromStream(builder, configJson, &root, &errs)) {
+                if (errors != nullptr)
+                    errors->push_back(errs);
+            }
+            else {
+                recordings.push_back(root);
+            }
+        }
+    }
+
+    std::reverse(recordings.begin(), recordings.end());
+
+    return recordings;
+}
@@ -0,0 +1,91 @@
+#pragma once
+#include <array>
+#include <cmath>
+#include <utility>
+
+#include <glm/glm.hpp>
+#include <glm/gtc/matrix_transform.hpp>
+
+/// <summary>
+/// Gauss-Newton helpers for rigid alignment, the update is parametrised as (rotation vector, translation) applied from the left
+/// </summary>
+namespace RigidTransform {
+/// 6x6 normal equations with the right hand side in the last column
+using NormalEquations = std::array<std::array<double, 7>, 6>;
+
+/// <summary>
+/// Accumulate one scalar residual r with Jacobian J into the normal equations, only the upper triangle is filled
+/// </summary>
+inline void accumulate(NormalEquations& system, const double J[6], double r, double weight = 1.0)
+{
+    for (int row = 0; row < 6; row++) {
+        for (int col = row; col < 6; col++)
+            system[row][col] += weight * J[row] * J[col];
+        system[row][6] -= weight * J[row] * r;
+    }
+}
+
+/// <summary>
+/// Solve the normal equations with Gaussian elimination and partial pivoting
+/// </summary>
+/// <returns>False if the system is degenerate, e.g. a single plane constraining only three degrees of freedom</returns>
+inline bool solve(NormalEquations a, std::array<double, 6>& x)
+{
+    for (int row = 0; row < 6; row++)
+        for (int col = 0; col < row; col++)
+            a[row][col] = a[col][row];
+
+    for (int col = 0; col < 6; col++) {
+        int pivot = col;
+        for (int row = col + 1; row < 6; row++) {
+            if (std::abs(a[row][col]) > std::abs(a[pivot][col]))
+                pivot = row;
+        }
+
+        if (std::abs(a[pivot][col]) < 1e-9)
+            return false;
+
+        std::swap(a[col], a[pivot]);
+
+        for (int row = col + 1; row < 6; row++) {
+            double f = a[row][col] / a[col][col];
+            for (int k = col; k < 7; k++)
+                a[row][k] -= f * a[col][k];
+        }
+    }
+
+    for (int row = 5; row >= 0; row--) {
+        double sum = a[row][6];
+        for (int k = row + 1; k < 6; k++)
+            sum -= a[row][k] * x[k];
+        x[row] = sum / a[row][row];
+    }
+
+    return true;
+}
+
+/// <summary>
+/// Transformation of a solved update, rotate by the rotation vector and then translate
+/// </summary>
+inline glm::mat4 fromUpdate(const std::array<double, 6>& x)
+{
+    glm::vec3 omega{ x[0], x[1], x[2] };
+    glm::vec3 tau{ x[3], x[4], x[5] };
+
+    glm::mat4 delta = glm::translate(glm::mat4{ 1.0f }, tau);
+    float angle = glm::length(omega);
+    if (angle > 0.0f)
+        delta = glm::rotate(delta, angle, omega / angle);
+
+    return delta;
+}
+
+/// <summary>
+/// Rotation (rad) and translation (m) magnitude of an update, used as convergence criterion
+/// </summary>
+static std::pair<float, float> getUpdateSize(const std::array<double, 6>& x)
+{
+    return { (float)std::sqrt(x[0] * x[0] + x[1] * x[1] + x[2] * x[2]),
+             (float)std::sqrt(x[3] * x[3] + x[4] * x[4] + x[5] * x[5]) };
+}
+}
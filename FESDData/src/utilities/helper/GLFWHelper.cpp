@@ -5,6 +5,7 @@
 #include <GLCore/GLErrorManager.h>
 
 #include "utilities/Status.h"
+#include "utilities/Profiler.h"
 
 GLFWwindow *InitialiseGLFWWindow(STATUS &status)
 {
@@ -57,6 +58,7 @@ GLFWwindow *InitialiseGLFWWindow(STATUS &status)
 }
 
 GLuint matToTexture(const cv::Mat& mat, GLenum minFilter, GLenum magFilter, GLenum wrapFilter) {
+    PROFILE_FUNCTION();
     // Generate a number for our textureID's unique handle
     //GLuint textureID;
     //glGenTextures(1, 0);
@@ -36,6 +36,11 @@ public:
 		return proj * view;
 	}
 
+	inline glm::vec3 getPosition() const
+	{
+		return Position;
+	}
+
 	void processKeyboardInput(float deltaTime = 0);
 	void processMousePosUpdate(double xpos, double ypos);
 	void processScroll(double xoffset, double yoffset);
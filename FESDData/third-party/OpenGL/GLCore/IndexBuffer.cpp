@@ -3,7 +3,7 @@
 #include <GL/glew.h>
 
 IndexBuffer::IndexBuffer(unsigned int count)
-    : m_Count(count)
+    : m_Count(count), m_Capacity(count)
 {
     ASSERT(sizeof(unsigned int) == sizeof(GLuint));
     GLCall(glGenBuffers(1, &m_RendererID));
@@ -12,7 +12,7 @@ IndexBuffer::IndexBuffer(unsigned int count)
 }
 
 IndexBuffer::IndexBuffer(const unsigned int *data, unsigned int count)
-    : m_Count(count)
+    : m_Count(count), m_Capacity(count)
 {
     ASSERT(sizeof(unsigned int) == sizeof(GLuint));
     GLCall(glGenBuffers(1, &m_RendererID));
@@ -25,6 +25,17 @@ IndexBuffer::~IndexBuffer()
     GLCall(glDeleteBuffers(1, &m_RendererID));
 }
 
+void IndexBuffer::SetData(const unsigned int *data, unsigned int count)
+{
+    ASSERT(count <= m_Capacity);
+    m_Count = count;
+
+    GLCall(glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, m_RendererID));
+    // Orphan the old storage so the upload does not wait for draws still reading it
+    GLCall(glBufferData(GL_ELEMENT_ARRAY_BUFFER, m_Capacity * sizeof(unsigned int), nullptr, GL_DYNAMIC_DRAW));
+    GLCall(glBufferSubData(GL_ELEMENT_ARRAY_BUFFER, 0, count * sizeof(unsigned int), data));
+}
+
 void IndexBuffer::Bind() const
 {
     GLCall(glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, m_RendererID));
@@ -5,6 +5,7 @@ class IndexBuffer
 private:
 	unsigned int m_RendererID;
 	unsigned int m_Count;
+	unsigned int m_Capacity;
 public:
 	IndexBuffer() = default;
 	IndexBuffer(unsigned int count);
@@ -14,6 +15,9 @@ public:
 	void Bind() const;
 	void Unbind() const;
 
+	// Replace the indices of a dynamic buffer, count must not exceed the size it was created with
+	void SetData(const unsigned int *data, unsigned int count);
+
 	inline unsigned int GetCount() const
 	{
 		return m_Count;
@@ -167,6 +167,17 @@ void Shader::SetUniformMat4fv(const std::string& name, const std::vector<glm::ma
     GLCall(glUniformMatrix4fv(GetUniformLocation(name), elemCount, GL_FALSE, &matrices[0][0][0]));
 }
 
+void Shader::SetUniformBlockBinding(const std::string& name, unsigned int binding)
+{
+    unsigned int index = glGetUniformBlockIndex(m_RendererID, name.c_str());
+    if (index == GL_INVALID_INDEX) {
+        std::cout << "Warning: uniform block '" << name << "' doesn't exist!" << std::endl;
+        return;
+    }
+
+    GLCall(glUniformBlockBinding(m_RendererID, index, binding));
+}
+
 int Shader::GetUniformLocation(const std::string &name) const
 {
     if ( m_UniformLocationCache.find(name) != m_UniformLocationCache.end() )
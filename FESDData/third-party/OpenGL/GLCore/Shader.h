@@ -35,6 +35,7 @@ public:
 	void SetUniformMat3f(const std::string &name, const glm::mat3 &matrix);
 	void SetUniformMat4f(const std::string &name, const glm::mat4 &matrix);
 	void SetUniformMat4fv(const std::string& name, const std::vector<glm::mat4> &matrices, size_t elemCount);
+	void SetUniformBlockBinding(const std::string &name, unsigned int binding);
 private:
 	unsigned int CreateShader(const std::string &vertexShader, const std::string &fragmentShader);
 	ShaderProgramSource ParseShaderCombined(const std::string &filepath);
@@ -0,0 +1,40 @@
+#include "UniformBuffer.h"
+
+#include "GLErrorManager.h"
+
+#include <GL/glew.h>
+
+UniformBuffer::UniformBuffer(unsigned int size)
+    : m_Size(size)
+{
+    GLCall(glGenBuffers(1, &m_RendererID));
+    GLCall(glBindBuffer(GL_UNIFORM_BUFFER, m_RendererID));
+    GLCall(glBufferData(GL_UNIFORM_BUFFER, size, nullptr, GL_DYNAMIC_DRAW));
+}
+
+UniformBuffer::~UniformBuffer()
+{
+    GLCall(glDeleteBuffers(1, &m_RendererID));
+}
+
+void UniformBuffer::Bind() const
+{
+    GLCall(glBindBuffer(GL_UNIFORM_BUFFER, m_RendererID));
+}
+
+void UniformBuffer::Unbind() const
+{
+    GLCall(glBindBuffer(GL_UNIFORM_BUFFER, 0));
+}
+
+void UniformBuffer::BindBase(unsigned int binding) const
+{
+    GLCall(glBindBufferBase(GL_UNIFORM_BUFFER, binding, m_RendererID));
+}
+
+void UniformBuffer::SetData(const void *data, unsigned int size, unsigned int offset)
+{
+    ASSERT(offset + size <= m_Size);
+    GLCall(glBindBuffer(GL_UNIFORM_BUFFER, m_RendererID));
+    GLCall(glBufferSubData(GL_UNIFORM_BUFFER, offset, size, data));
+}
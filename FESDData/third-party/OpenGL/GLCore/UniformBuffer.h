@@ -0,0 +1,24 @@
+#pragma once
+
+class UniformBuffer
+{
+private:
+	unsigned int m_RendererID;
+	unsigned int m_Size;
+public:
+	UniformBuffer() = default;
+	UniformBuffer(unsigned int size);
+	~UniformBuffer();
+
+	void Bind() const;
+	void Unbind() const;
+
+	// Attach the buffer to a binding point, shaders read it through the uniform block bound to the same point
+	void BindBase(unsigned int binding) const;
+	void SetData(const void *data, unsigned int size, unsigned int offset = 0);
+
+	inline unsigned int GetSize() const
+	{
+		return m_Size;
+	};
+};
@@ -29,7 +29,13 @@ void VertexArray::AddBuffer(const VertexBuffer &vb, const VertexBufferLayout &la
     {
         const auto &element = elements[i];
         GLCall(glEnableVertexAttribArray(i));
-        GLCall(glVertexAttribPointer(i, element.count, element.type, element.normalised, layout.GetStride(), (const void*)offset));
+        // Integer attributes would be converted to float by glVertexAttribPointer
+        if ((element.type == GL_INT || element.type == GL_UNSIGNED_INT) && !element.normalised) {
+            GLCall(glVertexAttribIPointer(i, element.count, element.type, layout.GetStride(), (const void*)offset));
+        }
+        else {
+            GLCall(glVertexAttribPointer(i, element.count, element.type, element.normalised, layout.GetStride(), (const void*)offset));
+        }
         offset += element.count * VertexBufferElement::GetSizeOfType(element.type);
     }
 }
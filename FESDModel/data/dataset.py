@@ -12,7 +12,7 @@ from PIL import Image, ImageOps, ImageFilter
 from utils.mode import Mode
 from utils import gt2err, err2gt
 
-from .frame_loader import load_frame
+from .frame_loader import load_frame, get_sample_count
 from .augmentation_parameters import AugmentationParams 
 from .frame import Frame
 
@@ -35,7 +35,7 @@ class FESDDataset(data.Dataset):
       with open(file=os.path.join(recording_dir, file), mode='r') as file:
         data = json.load(file)
         
-        self.total_frames_per_session = data['Frames']
+        self.total_frames_per_session = get_sample_count(data)
 
         if test:
           if data['Session Parameters']['Exercise'] in test_exercises:
@@ -55,8 +55,8 @@ class FESDDataset(data.Dataset):
           else:
             pass
 
-        self.size += data['Frames']
-        self.frames_per_session = data['Frames']
+        self.size += get_sample_count(data)
+        self.frames_per_session = get_sample_count(data)
         self.recording_jsons.append(data)
     
     self.use_v2 = use_v2
@@ -1,6 +1,7 @@
 import numpy as np
 import cv2
 import json
+from bisect import bisect_left
 from pathlib import Path
 
 from utils.mode import Mode
@@ -120,7 +121,51 @@ def load_skeletons(skeletons_json, flip:bool=False, mode:Mode=Mode.FULL_BODY, us
   
   return joints_2d, joints_3d, errors, bounding_boxes_2d, bounding_boxes_3d
 
+# Planar frames, see FrameIO::writePlanes
+FRAME_MAGIC = 0x44534546
+FRAME_VERSION = 2
+PLANE_DEPTH, PLANE_COLOR, PLANE_MASK = 0, 1, 2
+PLANE_DTYPES = {0: np.uint8, 2: np.uint16, 7: np.float16}
+PLANE_HEADER = np.dtype([('id', '<u4'), ('rows', '<i4'), ('cols', '<i4'), ('type', '<i4'), ('scale', '<f4'), ('reserved', '<u4'), ('offset', '<u8'), ('size', '<u8')])
+
+def is_planar(path: Path) -> bool:
+  with open(path, "rb") as f:
+    return np.frombuffer(f.read(4), dtype=np.uint32)[0] == FRAME_MAGIC
+
+def read_planes(path: Path, planes: list[int]) -> dict:
+  """Read only the requested planes, scaled to their physical unit (depth in m, colour in [0, 1])"""
+  result = {}
+  with open(path, "rb") as f:
+    magic, version, count, _ = np.frombuffer(f.read(16), dtype=np.uint32)
+    if magic != FRAME_MAGIC:
+      # Interleaved FP16 frames already hold colour in [0, 1] and depth in m
+      frame = read_frame(path)
+      if PLANE_COLOR in planes:
+        result[PLANE_COLOR] = frame[:, :, :3].astype(np.float32)
+      if PLANE_DEPTH in planes:
+        result[PLANE_DEPTH] = frame[:, :, 3:].astype(np.float32)
+      return result
+    if version != FRAME_VERSION:
+      raise ValueError(f"Unknown frame version {version} in {path}")
+
+    headers = np.frombuffer(f.read(int(count) * PLANE_HEADER.itemsize), dtype=PLANE_HEADER)
+    for header in headers:
+      if header['id'] not in planes:
+        continue
+
+      channels = (int(header['type']) >> 3) + 1
+      f.seek(int(header['offset']))
+      data = np.frombuffer(f.read(int(header['size'])), dtype=PLANE_DTYPES[int(header['type']) & 7])
+      data = data.reshape(int(header['rows']), int(header['cols']), channels)
+      result[int(header['id'])] = data.astype(np.float32) * header['scale']
+
+  return result
+
 def read_frame(path: Path) -> cv2.Mat:
+  if is_planar(path):
+    planes = read_planes(path, [PLANE_COLOR, PLANE_DEPTH])
+    return np.concatenate([planes[PLANE_COLOR], planes[PLANE_DEPTH]], axis=2).astype(np.float16)
+
   with open(path, "rb") as f:
     # Read header
     rows = np.frombuffer(f.read(4), dtype=np.int32)[0]
@@ -134,14 +179,44 @@ def read_frame(path: Path) -> cv2.Mat:
 
   return mat
 
+def get_keyframe_index(camera: json, sample: int) -> int:
+  # The frames from before the start of the recording come first and are skipped
+  pre_roll = camera.get('PreRollFrames', 0)
+
+  # Recordings without a keyframe index store every 10th frame
+  keyframes = camera.get('Keyframes')
+  if keyframes:
+    start = bisect_left(keyframes, pre_roll)
+    if start + sample < len(keyframes):
+      return keyframes[start + sample]
+  return pre_roll + sample * 10
+
+def get_sample_count(session: json) -> int:
+  camera = session['Cameras'][0]
+  keyframes = camera.get('Keyframes')
+  if not keyframes:
+    return session['Frames']
+  return len(keyframes) - bisect_left(keyframes, camera.get('PreRollFrames', 0))
+
 def load_frame(recording_dir: Path, session: json, frame_id: int, params: AugmentationParams = AugmentationParams(), mode: Mode = Mode.FULL_BODY, use_v2:bool=False) -> Frame:
-  frame_mat = read_frame(recording_dir /  session['Cameras'][0]['FileName'] / f'frame_{frame_id * 10}.bin')
+  camera = session['Cameras'][0]
+  frame_index = get_keyframe_index(camera, frame_id)
+
+  frame_mat = read_frame(recording_dir / camera['FileName'] / f'frame_{frame_index}.bin')
   frame = np.asarray(frame_mat[:,:])
+
+  # Frames cropped to the subject while recording are pasted back into a frame of the full size
+  if camera.get('Cropped', False):
+    x, y, w, h = camera['Regions'][frame_index]
+    full = np.zeros((camera['Height'], camera['Width'], frame.shape[2]), dtype=frame.dtype)
+    full[y:y + h, x:x + w] = frame
+    frame = full
+
   rgb, depth = np.split(frame, [3], axis=2)
   rgb, depth = rgb.astype(np.float32), depth.astype(np.float32)
   
   with open(file=recording_dir /  session['Skeleton'], mode='r') as file:
-    skeleton_json = json.load(file)[frame_id * 10]
+    skeleton_json = json.load(file)[frame_index]
     pose_2d, pose_3d, errors, bounding_boxes_2d, bounding_boxes_3d = load_skeletons(skeleton_json, params.flip, mode, use_v2)
   im_size = int(np.floor(max(abs(bounding_boxes_2d[1][0] - bounding_boxes_2d[0][0]), 
                              abs(bounding_boxes_2d[1][1] - bounding_boxes_2d[0][1])))) + params.crop_pad